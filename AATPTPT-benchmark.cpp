@@ -0,0 +1,543 @@
+// headless benchmark: sweeps grid sizes, steps per frame, local sizes, devices and simulation modes, prints steps/s and cells/s as CSV or JSON
+// usage: AATPTPT-benchmark [--sizes 256x256,1600x900] [--steps 10,200] [--local 64,256] [--devices 0,all] [--device-type gpu|cpu|acc|all]
+//                          [--modes separate,fused,temporal,bit,sleeping,packed,padded,auto] [--backend opencl|native] [--simd best|scalar|avx2|avx512] [--random seeds|counter] [--frames 20] [--warmup 3] [--format csv|json]
+//                          [--verify FRAMES] (compares cells of modes and native instruction sets to separate kernels after FRAMES frames instead of benchmarking)
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define PLAY_AREA_HEADLESS
+#include "PlayArea.h"
+
+struct BenchmarkResult
+{
+    int width;
+    int height;
+    int stepsPerFrame;
+    int localThreads;
+    std::string backend;
+    std::string devices;
+    std::string deviceNames;
+    std::string mode;
+    int frames;
+    double seconds;
+    double stepsPerSecond;
+    double cellsPerSecond;
+    int matter;
+};
+
+static std::vector<std::string> split(const std::string& str, char separator)
+{
+    std::vector<std::string> result;
+    std::stringstream stream(str);
+    std::string item;
+    while (std::getline(stream, item, separator))
+    {
+        if (item != "")
+            result.push_back(item);
+    }
+    return result;
+}
+
+static std::vector<int> splitInts(const std::string& str)
+{
+    std::vector<int> result;
+    for (auto& item : split(str, ','))
+        result.push_back(std::stoi(item));
+    return result;
+}
+
+static int modeOf(const std::string& name)
+{
+    if (name == "separate")
+        return PlayArea::SIMULATION_MODE_SEPARATE_KERNELS;
+    if (name == "fused")
+        return PlayArea::SIMULATION_MODE_FUSED;
+    if (name == "temporal")
+        return PlayArea::SIMULATION_MODE_TEMPORAL_BLOCKING;
+    if (name == "bit")
+        return PlayArea::SIMULATION_MODE_BIT_PACKED;
+    if (name == "sleeping")
+        return PlayArea::SIMULATION_MODE_SLEEPING_TILES;
+    if (name == "packed")
+        return PlayArea::SIMULATION_MODE_PACKED_RECORDS;
+    if (name == "padded")
+        return PlayArea::SIMULATION_MODE_PADDED_GRID;
+    if (name == "auto")
+        return PlayArea::SIMULATION_MODE_AUTO;
+    throw std::invalid_argument(std::string("error: unknown simulation mode: ") + name);
+}
+
+static int deviceTypesOf(const std::string& name)
+{
+    if (name == "gpu")
+        return GPGPU::Computer::DEVICE_GPUS;
+    if (name == "cpu")
+        return GPGPU::Computer::DEVICE_CPUS;
+    if (name == "acc")
+        return GPGPU::Computer::DEVICE_ACCS;
+    if (name == "all")
+        return GPGPU::Computer::DEVICE_ALL;
+    throw std::invalid_argument(std::string("error: unknown device type: ") + name);
+}
+
+// top half of play area is filled with 50% sand so that every frame has moving particles
+static void fillSand(PlayArea& area, int width, int height)
+{
+    const int radius = std::max(height / 4, 1);
+    for (int x = radius; x < width + radius; x += 2 * radius)
+        area.AddBrushEvent(x, radius, radius, PlayArea::BRUSH_SHAPE_SQUARE, 1, 0.5f);
+}
+
+// same brushes for every verified configuration: sand of fillSand, then a circle of material 2 and an eraser in middle frame
+static std::vector<unsigned char> verificationCells(PlayArea& area, int width, int height, int frames)
+{
+    area.Reset();
+    fillSand(area, width, height);
+    for (int f = 0; f < frames; f++)
+    {
+        if (f == frames / 2)
+        {
+            area.AddBrushEvent(width / 2, height / 4, std::max(height / 8, 1), PlayArea::BRUSH_SHAPE_CIRCLE, 2);
+            area.AddBrushEvent(width / 4, height / 2, std::max(height / 8, 1), PlayArea::BRUSH_SHAPE_CIRCLE, 0);
+        }
+        area.Calc();
+    }
+
+    std::vector<unsigned char> cells;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            cells.push_back(area.GetCell(x, y));
+    return cells;
+}
+
+static int differentCells(const std::vector<unsigned char>& cells, const std::vector<unsigned char>& reference)
+{
+    int different = 0;
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i] != reference[i])
+            different++;
+    }
+    return different;
+}
+
+// compares reduce, scan, histogram and compaction of GPGPU::Primitives to host results, adds number of different values per primitive to results
+template<typename T>
+static void verifyPrimitives(GPGPU::Primitives& primitives, const std::vector<T>& data, const std::string& typeName, std::vector<std::pair<std::string, int>>& results)
+{
+    const size_t n = data.size();
+    const int numBins = 256;
+    T sum = T(0);
+    T min = std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::lowest();
+    std::vector<T> scan(n);
+    std::vector<unsigned int> bins(numBins, 0);
+    std::vector<unsigned int> indices;
+    for (size_t i = 0; i < n; i++)
+    {
+        scan[i] = sum;
+        sum = T(sum + data[i]);
+        min = std::min(min, data[i]);
+        max = std::max(max, data[i]);
+        if (data[i] >= 0 && data[i] < numBins)
+            bins[(int)data[i]]++;
+        if (data[i] != 0)
+            indices.push_back((unsigned int)i);
+    }
+
+    std::vector<T> deviceScan(n);
+    primitives.exclusiveScan(data.data(), deviceScan.data(), n);
+    const std::vector<unsigned int> deviceBins = primitives.histogram(data.data(), n, numBins);
+    const std::vector<unsigned int> deviceIndices = primitives.compact(data.data(), n);
+    int scanDifferences = 0;
+    for (size_t i = 0; i < n; i++)
+        scanDifferences += (deviceScan[i] != scan[i]);
+    int binDifferences = 0;
+    for (int bin = 0; bin < numBins; bin++)
+        binDifferences += (deviceBins[bin] != bins[bin]);
+    int indexDifferences = (int)std::max(deviceIndices.size(), indices.size()) - (int)std::min(deviceIndices.size(), indices.size());
+    for (size_t i = 0; i < std::min(deviceIndices.size(), indices.size()); i++)
+        indexDifferences += (deviceIndices[i] != indices[i]);
+
+    results.push_back(std::make_pair("primitives-sum-" + typeName, (int)(primitives.sum(data.data(), n) != sum)));
+    results.push_back(std::make_pair("primitives-min-" + typeName, (int)(primitives.min(data.data(), n) != min)));
+    results.push_back(std::make_pair("primitives-max-" + typeName, (int)(primitives.max(data.data(), n) != max)));
+    results.push_back(std::make_pair("primitives-scan-" + typeName, scanDifferences));
+    results.push_back(std::make_pair("primitives-histogram-" + typeName, binDifferences));
+    results.push_back(std::make_pair("primitives-compact-" + typeName, indexDifferences));
+}
+
+// true if OpenCL has a device of given types (construction throws when there is no platform)
+static bool hasOpenClDevice(int deviceTypes)
+{
+    try
+    {
+        GPGPU::Computer computer(deviceTypes, GPGPU::Computer::DEVICE_SELECTION_ALL, 1, true, 1);
+        return computer.getNumDevices() > 0;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return false;
+    }
+}
+
+// runs each configuration for frames from same seeds and brushes, compares its cells to OpenCL separate kernels
+// modes: OpenCL modes to compare (bit-packed and auto are skipped, their random choices differ), native backend is compared with every supported instruction set
+// primitives of devices are checked on cells of separate kernels (as unsigned char, int, unsigned int and float)
+// without OpenCL, native scalar separate kernels are the reference of other instruction sets and sleeping tiles
+// prints 1 CSV line per configuration, returns number of configurations that have different cells (or values)
+static int verify(const std::vector<std::string>& sizes, const std::vector<int>& stepsPerFrames, const std::vector<std::string>& devices, int deviceTypes, const std::vector<std::string>& modes, int randomNumbers, int frames, bool opencl)
+{
+    const char* instructionSetNames[] = { "scalar", "avx2", "avx512" };
+    int failures = 0;
+    std::cout << "width,height,steps_per_frame,devices,configuration,differences" << std::endl;
+    for (auto& size : sizes)
+    {
+        const std::vector<std::string> dimensions = split(size, 'x');
+        if (dimensions.size() != 2)
+            throw std::invalid_argument(std::string("error: size must be WIDTHxHEIGHT: ") + size);
+
+        for (int stepsPerFrame : stepsPerFrames)
+        {
+            // native backend alone has no devices to iterate
+            const size_t numDevices = opencl ? devices.size() : 1;
+            for (size_t d = 0; d < numDevices; d++)
+            {
+                const std::string deviceName = opencl ? devices[d] : std::string("native");
+                const bool allDevices = (devices[d] == "all");
+                int width = std::stoi(dimensions[0]);
+                int height = std::stoi(dimensions[1]);
+                std::vector<unsigned char> reference;
+                std::vector<std::pair<std::string, int>> results;
+                if (!opencl)
+                {
+                    PlayArea native(width, height, 1, GPGPU::Computer::DEVICE_SELECTION_ALL, stepsPerFrame, 1, 0, false, deviceTypes, PlayArea::BACKEND_NATIVE, randomNumbers);
+                    native.SetNativeInstructionSet(NativeSimd::INSTRUCTION_SET_SCALAR);
+                    native.SetSimulationMode(PlayArea::SIMULATION_MODE_SEPARATE_KERNELS);
+                    reference = verificationCells(native, width, height, frames);
+                }
+                else
+                {
+                    PlayArea area(width, height, allDevices ? 100 : 1, allDevices ? GPGPU::Computer::DEVICE_SELECTION_ALL : std::stoi(devices[d]), stepsPerFrame, 1, 0, false, deviceTypes, PlayArea::BACKEND_OPENCL, randomNumbers);
+                    area.SetSimulationMode(PlayArea::SIMULATION_MODE_SEPARATE_KERNELS);
+                    reference = verificationCells(area, width, height, frames);
+
+                    for (auto& modeName : modes)
+                    {
+                        const int mode = modeOf(modeName);
+                        if (mode == PlayArea::SIMULATION_MODE_SEPARATE_KERNELS || mode == PlayArea::SIMULATION_MODE_BIT_PACKED || mode == PlayArea::SIMULATION_MODE_AUTO)
+                            continue;
+                        std::cerr << "verify " << width << "x" << height << " steps=" << stepsPerFrame << " devices=" << devices[d] << " mode=" << modeName << std::endl;
+                        area.SetSimulationMode(mode);
+                        results.push_back(std::make_pair(modeName, differentCells(verificationCells(area, width, height, frames), reference)));
+                    }
+
+                    {
+                        std::cerr << "verify " << width << "x" << height << " steps=" << stepsPerFrame << " devices=" << devices[d] << " primitives" << std::endl;
+                        GPGPU::Computer computer(deviceTypes, allDevices ? GPGPU::Computer::DEVICE_SELECTION_ALL : std::stoi(devices[d]), 1, true, allDevices ? 100 : 1);
+                        GPGPU::Primitives primitives(computer);
+                        std::vector<int> signedCells;
+                        std::vector<unsigned int> hashedCells;
+                        std::vector<float> halfCells;
+                        for (unsigned char cell : reference)
+                        {
+                            signedCells.push_back((int)cell - 1);
+                            hashedCells.push_back(cell * 2654435761u);
+                            halfCells.push_back(cell * 0.5f);
+                        }
+                        verifyPrimitives(primitives, reference, "uchar", results);
+                        verifyPrimitives(primitives, signedCells, "int", results);
+                        verifyPrimitives(primitives, hashedCells, "uint", results);
+                        verifyPrimitives(primitives, halfCells, "float", results);
+                    }
+                }
+
+                // host threads do not depend on devices, so native backend is compared once per size and steps
+                if (d == 0)
+                {
+                    PlayArea native(width, height, 1, GPGPU::Computer::DEVICE_SELECTION_ALL, stepsPerFrame, 1, 0, false, deviceTypes, PlayArea::BACKEND_NATIVE, randomNumbers);
+                    for (int instructionSet = NativeSimd::INSTRUCTION_SET_SCALAR; instructionSet <= NativeSimd::DetectInstructionSet(); instructionSet++)
+                    {
+                        native.SetNativeInstructionSet(instructionSet);
+                        for (int mode : { PlayArea::SIMULATION_MODE_SEPARATE_KERNELS, PlayArea::SIMULATION_MODE_SLEEPING_TILES })
+                        {
+                            // native scalar separate kernels are the reference without OpenCL
+                            if (!opencl && instructionSet == NativeSimd::INSTRUCTION_SET_SCALAR && mode == PlayArea::SIMULATION_MODE_SEPARATE_KERNELS)
+                                continue;
+                            const std::string name = std::string("native-") + instructionSetNames[instructionSet] + (mode == PlayArea::SIMULATION_MODE_SLEEPING_TILES ? "-sleeping" : "");
+                            std::cerr << "verify " << width << "x" << height << " steps=" << stepsPerFrame << " " << name << std::endl;
+                            native.SetSimulationMode(mode);
+                            results.push_back(std::make_pair(name, differentCells(verificationCells(native, width, height, frames), reference)));
+                        }
+                    }
+                }
+
+                for (auto& result : results)
+                {
+                    std::cout << width << "," << height << "," << stepsPerFrame << "," << deviceName << "," << result.first << "," << result.second << std::endl;
+                    if (result.second > 0)
+                        failures++;
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static int intOf(const std::string& option, const std::string& value)
+{
+    try
+    {
+        return std::stoi(value);
+    }
+    catch (std::exception&)
+    {
+        throw std::invalid_argument(std::string("error: ") + option + " needs a number: " + value);
+    }
+}
+
+static int instructionSetOf(const std::string& name)
+{
+    if (name == "best")
+        return NativeSimd::DetectInstructionSet();
+    if (name == "scalar")
+        return NativeSimd::INSTRUCTION_SET_SCALAR;
+    if (name == "avx2")
+        return NativeSimd::INSTRUCTION_SET_AVX2;
+    if (name == "avx512")
+        return NativeSimd::INSTRUCTION_SET_AVX512;
+    throw std::invalid_argument(std::string("error: unknown instruction set: ") + name);
+}
+
+static int randomNumbersOf(const std::string& name)
+{
+    if (name == "seeds")
+        return PlayArea::RANDOM_SEEDS;
+    if (name == "counter")
+        return PlayArea::RANDOM_COUNTER;
+    throw std::invalid_argument(std::string("error: unknown random numbers: ") + name);
+}
+
+static std::string jsonString(const std::string& str)
+{
+    std::string result = "\"";
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+static void printResults(const std::vector<BenchmarkResult>& results, bool json)
+{
+    if (json)
+    {
+        std::cout << "[" << std::endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchmarkResult& r = results[i];
+            std::cout << "  {\"width\": " << r.width << ", \"height\": " << r.height << ", \"cells\": " << (size_t)r.width * r.height
+                << ", \"steps_per_frame\": " << r.stepsPerFrame << ", \"local_threads\": " << r.localThreads
+                << ", \"backend\": " << jsonString(r.backend) << ", \"devices\": " << jsonString(r.devices) << ", \"device_names\": " << jsonString(r.deviceNames)
+                << ", \"mode\": " << jsonString(r.mode) << ", \"frames\": " << r.frames << ", \"seconds\": " << r.seconds
+                << ", \"steps_per_second\": " << r.stepsPerSecond << ", \"cells_per_second\": " << r.cellsPerSecond
+                << ", \"matter\": " << r.matter << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        std::cout << "]" << std::endl;
+    }
+    else
+    {
+        std::cout << "width,height,cells,steps_per_frame,local_threads,backend,devices,device_names,mode,frames,seconds,steps_per_second,cells_per_second,matter" << std::endl;
+        for (auto& r : results)
+        {
+            std::cout << r.width << "," << r.height << "," << (size_t)r.width * r.height << "," << r.stepsPerFrame << "," << r.localThreads << ","
+                << r.backend << "," << r.devices << ",\"" << r.deviceNames << "\"," << r.mode << "," << r.frames << "," << r.seconds << ","
+                << r.stepsPerSecond << "," << r.cellsPerSecond << "," << r.matter << std::endl;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string sizes = "256x256,1024x576,1600x900";
+    std::string steps = "10,200";
+    std::string locals = "256";
+    std::string devices = "0";
+    std::string deviceType = "gpu";
+    std::string modes = "";
+    std::string backend = "opencl";
+    std::string simd = "best";
+    std::string random = "seeds";
+    std::string framesValue = "20";
+    std::string warmupValue = "3";
+    std::string format = "csv";
+    std::string verifyValue = "0";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        // next option is not a value (such as --verify --sizes 256x256)
+        if (i + 1 >= argc || std::string(argv[i + 1]).rfind("--", 0) == 0)
+        {
+            std::cerr << "missing value of " << arg << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--sizes")
+            sizes = value;
+        else if (arg == "--steps")
+            steps = value;
+        else if (arg == "--local")
+            locals = value;
+        else if (arg == "--devices")
+            devices = value;
+        else if (arg == "--device-type")
+            deviceType = value;
+        else if (arg == "--modes")
+            modes = value;
+        else if (arg == "--backend")
+            backend = value;
+        else if (arg == "--simd")
+            simd = value;
+        else if (arg == "--random")
+            random = value;
+        else if (arg == "--frames")
+            framesValue = value;
+        else if (arg == "--warmup")
+            warmupValue = value;
+        else if (arg == "--format")
+            format = value;
+        else if (arg == "--verify")
+            verifyValue = value;
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BenchmarkResult> results;
+    try
+    {
+        const int frames = intOf("--frames", framesValue);
+        const int warmup = intOf("--warmup", warmupValue);
+        const int verifyFrames = intOf("--verify", verifyValue);
+        const int deviceTypes = deviceTypesOf(deviceType);
+        const int randomNumbers = randomNumbersOf(random);
+        if (backend != "opencl" && backend != "native")
+            throw std::invalid_argument(std::string("error: unknown backend: ") + backend);
+
+        // verification compares all modes that compute same cells as separate kernels by default
+        if (modes == "")
+            modes = verifyFrames > 0 ? "fused,temporal,sleeping,packed,padded" : "separate,fused,temporal,bit";
+
+        if (verifyFrames > 0)
+        {
+            const bool opencl = (backend == "opencl") && hasOpenClDevice(deviceTypes);
+            if (!opencl)
+                std::cerr << "no OpenCL device, native scalar separate kernels are the reference" << std::endl;
+            const int failures = verify(split(sizes, ','), splitInts(steps), split(devices, ','), deviceTypes, split(modes, ','), randomNumbers, verifyFrames, opencl);
+            std::cerr << (failures > 0 ? std::to_string(failures) + " configurations differ from separate kernels" : std::string("all configurations match separate kernels")) << std::endl;
+            return failures > 0 ? 1 : 0;
+        }
+        // native backend has no devices and work-groups
+        const bool native = (backend == "native");
+        if (native)
+        {
+            devices = "native";
+            locals = split(locals, ',')[0];
+        }
+        const std::vector<int> localSizes = splitInts(locals);
+        for (auto& size : split(sizes, ','))
+        {
+            const std::vector<std::string> dimensions = split(size, 'x');
+            if (dimensions.size() != 2)
+                throw std::invalid_argument(std::string("error: size must be WIDTHxHEIGHT: ") + size);
+
+            for (int stepsPerFrame : splitInts(steps))
+            {
+                for (auto& device : split(devices, ','))
+                {
+                    // "all" = every device of given type as strips of rows, a number = single device by index
+                    const bool allDevices = (device == "all");
+                    int width = std::stoi(dimensions[0]);
+                    int height = std::stoi(dimensions[1]);
+                    PlayArea area(width, height, allDevices ? 100 : 1, (allDevices || native) ? GPGPU::Computer::DEVICE_SELECTION_ALL : std::stoi(device), stepsPerFrame, 1, 0, false, deviceTypes, native ? PlayArea::BACKEND_NATIVE : PlayArea::BACKEND_OPENCL, randomNumbers);
+                    if (native)
+                        area.SetNativeInstructionSet(instructionSetOf(simd));
+                    std::string deviceNames;
+                    for (auto& name : area.GetDeviceNames())
+                        deviceNames += (deviceNames == "" ? "" : ";") + name;
+
+                    for (auto& modeName : split(modes, ','))
+                    {
+                        const int mode = modeOf(modeName);
+                        if (native && mode == PlayArea::SIMULATION_MODE_BIT_PACKED)
+                        {
+                            std::cerr << "native backend does not have bit-packed engine, skipped" << std::endl;
+                            continue;
+                        }
+                        for (size_t l = 0; l < localSizes.size(); l++)
+                        {
+                            // fused, temporal, sleeping-tile, packed-record and padded-grid kernels have fixed work-group size
+                            const bool tiled = (mode == PlayArea::SIMULATION_MODE_FUSED || mode == PlayArea::SIMULATION_MODE_TEMPORAL_BLOCKING || mode == PlayArea::SIMULATION_MODE_SLEEPING_TILES || mode == PlayArea::SIMULATION_MODE_PACKED_RECORDS || mode == PlayArea::SIMULATION_MODE_PADDED_GRID);
+                            if (tiled && l > 0)
+                                continue;
+
+                            std::cerr << width << "x" << height << " steps=" << stepsPerFrame << " local=" << (tiled ? 256 : localSizes[l]) << " devices=" << device << " mode=" << modeName << std::endl;
+                            area.SetLocalThreads(localSizes[l]);
+                            area.Reset();
+                            area.SetSimulationMode(mode);
+                            fillSand(area, width, height);
+                            for (int f = 0; f < warmup; f++)
+                                area.Calc();
+
+                            size_t nanoseconds = 0;
+                            {
+                                GPGPU::Bench bench(&nanoseconds);
+                                for (int f = 0; f < frames; f++)
+                                    area.Calc();
+                            }
+
+                            int matter = 0;
+                            for (int y = 0; y < height; y++)
+                                for (int x = 0; x < width; x++)
+                                    matter += area.GetCell(x, y);
+
+                            BenchmarkResult result;
+                            result.width = width;
+                            result.height = height;
+                            result.stepsPerFrame = stepsPerFrame;
+                            result.localThreads = tiled ? 256 : localSizes[l];
+                            result.backend = backend;
+                            result.devices = device;
+                            result.deviceNames = deviceNames;
+                            result.mode = modeName;
+                            result.frames = frames;
+                            result.seconds = nanoseconds / 1000000000.0;
+                            result.stepsPerSecond = (double)frames * stepsPerFrame / std::max(result.seconds, 1e-9);
+                            result.cellsPerSecond = result.stepsPerSecond * width * height;
+                            result.matter = matter;
+                            results.push_back(result);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        printResults(results, format == "json");
+        return 1;
+    }
+
+    printResults(results, format == "json");
+    return 0;
+}
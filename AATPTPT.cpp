@@ -1,7 +1,12 @@
 
 #include <iostream>
+#ifdef _WIN32
 #include "vcpkg_installed/x86-windows/x86-windows/include/opencv2/opencv.hpp"
 #include "vcpkg_installed/x86-windows/x86-windows/include/opencv2/highgui.hpp"
+#else
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui.hpp>
+#endif
 
 #include "PlayArea.h"
 
@@ -50,7 +55,8 @@ int main()
     int h = 900;
     Mouse mouse;
 
-    // currently only 1 GPU supported
+    // 1 GPU (selected by indexGPU) computes whole play area
+    // to use multiple GPUs, set indexGPU = -1 (all devices) and maxGPUs to their number: each GPU then computes a strip of rows (neighboring strips exchange only their border rows)
     int maxGPUs = 1; 
 
     // change this if you have an iGPU and a dGPU. discrete GPUs are generally faster because of high bandwidth memory
@@ -61,12 +67,23 @@ int main()
     // rtx-4070 can do 20000 steps per second, this makes 100 updates per second (sand falls at 100 pixels per update speed)
     // iGPU of Ryzen 7000 series CPU can do 500 steps per second
     // Ryzen 7900 CPU cores can do 1200 steps per second
+    // (replaced by auto-tuning when autoTune = true)
     int stepsPerFrame = 200; 
 
+    // picks the largest steps per frame that computes in frameTimeBudget and fastest work-group size per device
+    // results are saved to gpgpu-tuning-profile.txt, so only first run on a device measures them
+    bool autoTune = true;
+    size_t frameTimeBudget = 10000000; // nanoseconds
+
     // doesn't work yet
     int quantumStrength = 1;
 
-    PlayArea area(w,h,maxGPUs, indexGPU,stepsPerFrame,quantumStrength);
+    // shows device time of each kernel and of copies per frame (adds some overhead per command)
+    bool profiling = false;
+
+    PlayArea area(w,h,maxGPUs, indexGPU,stepsPerFrame,quantumStrength,0,profiling);
+    if (autoTune)
+        area.AutoTune(frameTimeBudget);
     
 
     std::cout << "Hello World!\n";
@@ -89,6 +106,27 @@ int main()
             area.Reset();
         }
 
+        // cycles automatic mode, separate kernels, fused kernel per step, temporal blocking, bit-packed engine, sleeping tiles, packed records and padded grid (for A/B benchmarking)
+        if (key == 'f')
+        {
+            if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_AUTO)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_SEPARATE_KERNELS);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_SEPARATE_KERNELS)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_FUSED);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_FUSED)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_TEMPORAL_BLOCKING);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_TEMPORAL_BLOCKING)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_BIT_PACKED);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_BIT_PACKED)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_SLEEPING_TILES);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_SLEEPING_TILES)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_PACKED_RECORDS);
+            else if (area.GetSimulationMode() == PlayArea::SIMULATION_MODE_PACKED_RECORDS)
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_PADDED_GRID);
+            else
+                area.SetSimulationMode(PlayArea::SIMULATION_MODE_AUTO);
+        }
+
         area.Calc();
         area.Render();
         
@@ -0,0 +1,839 @@
+#pragma once
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<string>
+#include<cmath>
+#include<cstdlib>
+#include<algorithm>
+#include<stdexcept>
+#include<atomic>
+
+#include "NativeSimd.h"
+
+// falling-sand steps computed by host threads without OpenCL (initRandomSeed, guessParticleTarget, pickOneTargetGuess, moveSand pipeline)
+// rules, random numbers and float roundings are same as the OpenCL kernels of PlayArea, so both backends give identical results from same seeds (or same steps with counter-based random numbers)
+// each kernel is computed by a pool of threads, 1 band of rows per thread (a kernel finishes on all bands before next kernel starts)
+struct NativeBackend
+{
+    // host copies that PlayArea reads and writes (same layout as its HostParameters)
+    std::vector<unsigned char> areaIn;
+    std::vector<unsigned char> areaOut;
+    std::vector<unsigned int> randomSeedIn;
+    // header record {count, first} followed by a ring of brushCapacity records of brushRecordInts ints
+    std::vector<int> brushEvents;
+    // 3 bytes (BGR) per material, and frame of Colorize (3 bytes per cell)
+    std::vector<unsigned char> palette;
+    std::vector<unsigned char> frame;
+
+private:
+    int _width;
+    int _height;
+    int _brushCapacity;
+    int _brushRecordInts;
+    int _brushShapeCircle;
+    // NativeSimd::INSTRUCTION_SET_*
+    int _instructionSet;
+
+    // sleeping tiles (SetSleepingTiles): tiles of SLEEP_TILE_SIZE x SLEEP_TILE_SIZE cells
+    bool _sleepingTiles;
+    int _tilesX;
+    int _tilesY;
+    // per tile: a cell moved, could move or was changed (by brushes or input) on previous step, for current and next step
+    std::vector<unsigned char> _tileFlags[2];
+    int _tileParity;
+    // per tile: number of steps slept (its seeds are behind by that many random numbers)
+    std::vector<unsigned int> _tileSleep;
+    // tiles computed on current step (in order of index, so neighbor tiles of a row follow each other)
+    std::vector<int> _awakeTiles;
+
+    // current and next state (swapped after each step)
+    std::vector<unsigned char> _areaState[2];
+    int _currentState;
+    std::vector<unsigned char> _areaTargetSource;
+    std::vector<unsigned char> _areaTargetSource2;
+    // empty with counter-based random numbers
+    std::vector<unsigned int> _randomSeedState;
+    // seeds are generated from cell index and number of steps since InitRandomSeed
+    bool _counterRandom;
+    unsigned int _randomStep;
+
+    // thread pool: parts of a job (rows or tiles) are split into bands, thread i computes band i + 1, caller computes band 0
+    std::vector<std::thread> _threads;
+    int _numBands;
+    std::mutex _mutex;
+    std::condition_variable _jobStart;
+    std::condition_variable _jobDone;
+    std::function<void(int, int)> _job;
+    int _jobParts;
+    size_t _jobGeneration;
+    int _jobsPending;
+    bool _stop;
+
+    // same probabilities as PLAY_AREA_TEST_*_PROB macros of kernels
+    const static int TEST_UP_PROB = 1;
+    const static int TEST_RIGHT_PROB = 14;
+    const static int TEST_BOT_PROB = 15;
+    const static int TEST_LEFT_PROB = 14;
+
+    static unsigned int Rnd(unsigned int seed)
+    {
+        seed = (seed ^ 61) ^ (seed >> 16);
+        seed *= 9;
+        seed = seed ^ (seed >> 4);
+        seed *= 0x27d4eb2d;
+        seed = seed ^ (seed >> 15);
+        return seed;
+    }
+
+    // same as counterSeed of kernels: Philox2x32-10 of counters (cell, step) and key (phase: 0 = guess, 1 = pick)
+    static unsigned int CounterSeed(unsigned int cell, unsigned int step, unsigned int phase)
+    {
+        unsigned int key = phase;
+        for (int round = 0; round < 10; round++)
+        {
+            const unsigned long long product = (unsigned long long)cell * 0xD256D193u;
+            cell = (unsigned int)(product >> 32) ^ key ^ step;
+            step = (unsigned int)product;
+            key += 0x9E3779B9u;
+        }
+        return cell;
+    }
+
+    // float product like UIMAXFLOATINV of kernels (not promoted to double)
+    static float RandomFloat(unsigned int* seed)
+    {
+        unsigned int newSeed = Rnd(*seed);
+        *seed = newSeed;
+        return (float)newSeed * 2.32830644e-10f;
+    }
+
+    // same as guessParticleTargetOfCell of kernels
+    static unsigned char GuessParticleTargetOfCell(
+        const int matter, const int top, const int right, const int bot, const int left,
+        const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft,
+        unsigned int* seed
+    )
+    {
+        unsigned int randomSeed = *seed;
+        int totProb = 0;
+        int tot = 0;
+
+        if (matter == 1 && top == 0 && hasTop)
+            totProb += TEST_UP_PROB;
+        if (matter == 1 && right == 0 && hasRight)
+            totProb += TEST_RIGHT_PROB;
+        if (matter == 1 && bot == 0 && hasBot)
+            totProb += TEST_BOT_PROB;
+        if (matter == 1 && left == 0 && hasLeft)
+            totProb += TEST_LEFT_PROB;
+
+        const float scaled = RandomFloat(&randomSeed) * (float)totProb;
+        const int selected = (int)std::floor(scaled);
+
+        if (matter == 1 && top == 0 && hasTop)
+        {
+            tot += TEST_UP_PROB;
+            if (selected < tot)
+            {
+                *seed = randomSeed;
+                return 1;
+            }
+        }
+        if (matter == 1 && right == 0 && hasRight)
+        {
+            tot += TEST_RIGHT_PROB;
+            if (selected < tot)
+            {
+                *seed = randomSeed;
+                return 2;
+            }
+        }
+        if (matter == 1 && bot == 0 && hasBot)
+        {
+            tot += TEST_BOT_PROB;
+            if (selected < tot)
+            {
+                *seed = randomSeed;
+                return 4;
+            }
+        }
+        if (matter == 1 && left == 0 && hasLeft)
+        {
+            tot += TEST_LEFT_PROB;
+            if (selected < tot)
+            {
+                *seed = randomSeed;
+                return 8;
+            }
+        }
+        return 0;
+    }
+
+    // same as pickOneTargetGuessOfCell of kernels
+    static unsigned char PickOneTargetGuessOfCell(
+        const int top, const int right, const int bot, const int left,
+        const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft,
+        unsigned int* seed
+    )
+    {
+        int totProb = 0;
+        int tot = 0;
+
+        if (hasTop && top == 4)
+            totProb += TEST_BOT_PROB;
+        if (hasRight && right == 8)
+            totProb += TEST_LEFT_PROB;
+        if (hasBot && bot == 1)
+            totProb += TEST_UP_PROB;
+        if (hasLeft && left == 2)
+            totProb += TEST_RIGHT_PROB;
+
+        const float scaled = RandomFloat(seed) * (float)totProb;
+        const int selected = (int)std::floor(scaled);
+
+        if (hasTop)
+        {
+            if (top == 4)
+                tot += TEST_BOT_PROB;
+            if (selected < tot)
+                return 1;
+        }
+        if (hasRight)
+        {
+            if (right == 8)
+                tot += TEST_LEFT_PROB;
+            if (selected < tot)
+                return 2;
+        }
+        if (hasBot)
+        {
+            if (bot == 1)
+                tot += TEST_UP_PROB;
+            if (selected < tot)
+                return 4;
+        }
+        if (hasLeft)
+        {
+            if (left == 2)
+                tot += TEST_RIGHT_PROB;
+            if (selected < tot)
+                return 8;
+        }
+        return 0;
+    }
+
+    // same as moveSandOfCell of kernels (neighbors are targets for an empty center, sources otherwise)
+    static unsigned char MoveSandOfCell(
+        const int center, const int targetCenter, const int sourceCenter,
+        const int top, const int right, const int bot, const int left,
+        const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft
+    )
+    {
+        if (center == 0)
+        {
+            if (top == 4 && sourceCenter == 1 && hasTop)
+                return 1;
+            if (right == 8 && sourceCenter == 2 && hasRight)
+                return 1;
+            if (bot == 1 && sourceCenter == 4 && hasBot)
+                return 1;
+            if (left == 2 && sourceCenter == 8 && hasLeft)
+                return 1;
+        }
+        else
+        {
+            if (top == 4 && targetCenter == 1 && hasTop)
+                return 0;
+            if (right == 8 && targetCenter == 2 && hasRight)
+                return 0;
+            if (bot == 1 && targetCenter == 4 && hasBot)
+                return 0;
+            if (left == 2 && targetCenter == 8 && hasLeft)
+                return 0;
+        }
+        return center;
+    }
+
+    // same as brushCovers of kernels
+    bool BrushCovers(const int* brush, const int x, const int y)
+    {
+        const int dx = x - brush[0];
+        const int dy = y - brush[1];
+        const int radius = brush[2];
+        if (std::abs(dx) > radius || std::abs(dy) > radius)
+            return false;
+        if (brush[3] == _brushShapeCircle && dx * dx + dy * dy > radius * radius)
+            return false;
+        return (int)(Rnd((unsigned int)(x + y * _width) ^ Rnd((unsigned int)brush[6])) & 65535) < brush[5];
+    }
+
+    // scalar versions of kernels for cells xBegin <= x < xEnd of row y
+    // randomSeedState = nullptr: counter-based random numbers of current step
+    // missed: set if a cell could move but picked no target (random number rounded to 1.0f)
+    void GuessParticleTargetScalar(const unsigned char* areaState, unsigned int* randomSeedState, unsigned char* areaTargetSource, int y, int topY, int botY, int xBegin, int xEnd, bool* missed)
+    {
+        const int width = _width;
+        for (int x = xBegin; x < xEnd; x++)
+        {
+            const int id = x + y * width;
+            const int rightX = (x == width - 1 ? x : x + 1);
+            const int leftX = (x == 0 ? x : x - 1);
+            const int matter = areaState[id];
+            const int top = areaState[x + topY * width];
+            const int right = areaState[rightX + y * width];
+            const int bot = areaState[x + botY * width];
+            const int left = areaState[leftX + y * width];
+            unsigned int randomSeed = (randomSeedState ? randomSeedState[id] : CounterSeed(id, _randomStep, 0));
+            const unsigned char target = GuessParticleTargetOfCell(
+                matter, top, right, bot, left,
+                topY != y, rightX != x, botY != y, leftX != x,
+                &randomSeed
+            );
+            if (target != 0 && randomSeedState)
+                randomSeedState[id] = randomSeed;
+            else if (target == 0 && matter == 1 && ((top == 0 && topY != y) || (right == 0 && rightX != x) || (bot == 0 && botY != y) || (left == 0 && leftX != x)))
+                *missed = true;
+            areaTargetSource[id] = target;
+        }
+    }
+
+    void PickOneTargetGuessScalar(const unsigned char* areaTargetSource, unsigned char* areaTargetSource2, unsigned int* randomSeedState, int y, int topY, int botY, int xBegin, int xEnd)
+    {
+        const int width = _width;
+        for (int x = xBegin; x < xEnd; x++)
+        {
+            const int id = x + y * width;
+            const int rightX = (x == width - 1 ? x : x + 1);
+            const int leftX = (x == 0 ? x : x - 1);
+            unsigned int randomSeed = (randomSeedState ? randomSeedState[id] : CounterSeed(id, _randomStep, 1));
+            areaTargetSource2[id] = PickOneTargetGuessOfCell(
+                areaTargetSource[x + topY * width], areaTargetSource[rightX + y * width], areaTargetSource[x + botY * width], areaTargetSource[leftX + y * width],
+                topY != y, rightX != x, botY != y, leftX != x,
+                &randomSeed
+            );
+            if (randomSeedState)
+                randomSeedState[id] = randomSeed;
+        }
+    }
+
+    void MoveSandScalar(const unsigned char* areaTargetSource, const unsigned char* areaTargetSource2, const unsigned char* areaState, unsigned char* areaState2, int y, int topY, int botY, int xBegin, int xEnd)
+    {
+        const int width = _width;
+        for (int x = xBegin; x < xEnd; x++)
+        {
+            const int id = x + y * width;
+            const int rightX = (x == width - 1 ? x : x + 1);
+            const int leftX = (x == 0 ? x : x - 1);
+            const int center = areaState[id];
+            const unsigned char* neighbor = (center == 0 ? areaTargetSource : areaTargetSource2);
+            areaState2[id] = MoveSandOfCell(
+                center, areaTargetSource[id], areaTargetSource2[id],
+                neighbor[x + topY * width], neighbor[rightX + y * width], neighbor[x + botY * width], neighbor[leftX + y * width],
+                topY != y, rightX != x, botY != y, leftX != x
+            );
+        }
+    }
+
+    // kernels for cells xBegin <= x < xEnd of row y
+    // cells that have left and right neighbors are computed by SIMD functions of selected instruction set, others (and remainder) by scalar code
+    void GuessParticleTargetSpan(const unsigned char* areaState, unsigned int* randomSeedState, unsigned char* areaTargetSource, int y, int xBegin, int xEnd, bool* missed)
+    {
+        const int topY = (y == 0 ? y : y - 1);
+        const int botY = (y == _height - 1 ? y : y + 1);
+        const int simdBegin = std::max(xBegin, 1);
+        const int simdEnd = std::min(xEnd, _width - 1);
+        int x = simdBegin;
+#ifdef NATIVE_SIMD_X86
+        if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX512)
+            x = NativeSimd::GuessParticleTargetSpanAvx512(areaState, randomSeedState, _randomStep, areaTargetSource, _width, y, topY, botY, simdBegin, simdEnd, TEST_UP_PROB, TEST_RIGHT_PROB, TEST_BOT_PROB, TEST_LEFT_PROB, missed);
+        else if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX2)
+            x = NativeSimd::GuessParticleTargetSpanAvx2(areaState, randomSeedState, _randomStep, areaTargetSource, _width, y, topY, botY, simdBegin, simdEnd, TEST_UP_PROB, TEST_RIGHT_PROB, TEST_BOT_PROB, TEST_LEFT_PROB, missed);
+#endif
+        GuessParticleTargetScalar(areaState, randomSeedState, areaTargetSource, y, topY, botY, xBegin, std::min(simdBegin, xEnd), missed);
+        GuessParticleTargetScalar(areaState, randomSeedState, areaTargetSource, y, topY, botY, x, xEnd, missed);
+    }
+
+    void PickOneTargetGuessSpan(const unsigned char* areaTargetSource, unsigned char* areaTargetSource2, unsigned int* randomSeedState, int y, int xBegin, int xEnd)
+    {
+        const int topY = (y == 0 ? y : y - 1);
+        const int botY = (y == _height - 1 ? y : y + 1);
+        const int simdBegin = std::max(xBegin, 1);
+        const int simdEnd = std::min(xEnd, _width - 1);
+        int x = simdBegin;
+#ifdef NATIVE_SIMD_X86
+        if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX512)
+            x = NativeSimd::PickOneTargetGuessSpanAvx512(areaTargetSource, areaTargetSource2, randomSeedState, _randomStep, _width, y, topY, botY, simdBegin, simdEnd, TEST_UP_PROB, TEST_RIGHT_PROB, TEST_BOT_PROB, TEST_LEFT_PROB);
+        else if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX2)
+            x = NativeSimd::PickOneTargetGuessSpanAvx2(areaTargetSource, areaTargetSource2, randomSeedState, _randomStep, _width, y, topY, botY, simdBegin, simdEnd, TEST_UP_PROB, TEST_RIGHT_PROB, TEST_BOT_PROB, TEST_LEFT_PROB);
+#endif
+        PickOneTargetGuessScalar(areaTargetSource, areaTargetSource2, randomSeedState, y, topY, botY, xBegin, std::min(simdBegin, xEnd));
+        PickOneTargetGuessScalar(areaTargetSource, areaTargetSource2, randomSeedState, y, topY, botY, x, xEnd);
+    }
+
+    void MoveSandSpan(const unsigned char* areaTargetSource, const unsigned char* areaTargetSource2, const unsigned char* areaState, unsigned char* areaState2, int y, int xBegin, int xEnd)
+    {
+        const int topY = (y == 0 ? y : y - 1);
+        const int botY = (y == _height - 1 ? y : y + 1);
+        const int simdBegin = std::max(xBegin, 1);
+        const int simdEnd = std::min(xEnd, _width - 1);
+        int x = simdBegin;
+#ifdef NATIVE_SIMD_X86
+        if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX512)
+            x = NativeSimd::MoveSandSpanAvx512(areaTargetSource, areaTargetSource2, areaState, areaState2, _width, y, topY, botY, simdBegin, simdEnd);
+        else if (simdBegin < simdEnd && _instructionSet == NativeSimd::INSTRUCTION_SET_AVX2)
+            x = NativeSimd::MoveSandSpanAvx2(areaTargetSource, areaTargetSource2, areaState, areaState2, _width, y, topY, botY, simdBegin, simdEnd);
+#endif
+        MoveSandScalar(areaTargetSource, areaTargetSource2, areaState, areaState2, y, topY, botY, xBegin, std::min(simdBegin, xEnd));
+        MoveSandScalar(areaTargetSource, areaTargetSource2, areaState, areaState2, y, topY, botY, x, xEnd);
+    }
+
+    // cells of a tile: [xBegin, xEnd) x [yBegin, yEnd)
+    void TileCells(int tile, int* xBegin, int* xEnd, int* yBegin, int* yEnd)
+    {
+        *xBegin = (tile % _tilesX) * SLEEP_TILE_SIZE;
+        *yBegin = (tile / _tilesX) * SLEEP_TILE_SIZE;
+        *xEnd = std::min(*xBegin + SLEEP_TILE_SIZE, _width);
+        *yEnd = std::min(*yBegin + SLEEP_TILE_SIZE, _height);
+    }
+
+    // seeds of a woken tile advance once per slept step (as pickOneTargetGuess would have done)
+    // counter-based random numbers do not depend on previous steps
+    void CatchUpTile(int tile)
+    {
+        const unsigned int steps = _tileSleep[tile];
+        if (steps == 0 || _counterRandom)
+            return;
+
+        int xBegin, xEnd, yBegin, yEnd;
+        TileCells(tile, &xBegin, &xEnd, &yBegin, &yEnd);
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            for (int x = xBegin; x < xEnd; x++)
+            {
+                unsigned int seed = _randomSeedState[x + y * _width];
+                for (unsigned int k = 0; k < steps; k++)
+                    seed = Rnd(seed);
+                _randomSeedState[x + y * _width] = seed;
+            }
+        }
+        _tileSleep[tile] = 0;
+    }
+
+    // a computed tile has to be computed on next step if any of its cells guessed or picked a neighbor (moved or could move)
+    bool TileActive(int tile)
+    {
+        int xBegin, xEnd, yBegin, yEnd;
+        TileCells(tile, &xBegin, &xEnd, &yBegin, &yEnd);
+        unsigned char any = 0;
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            for (int x = xBegin; x < xEnd; x++)
+                any |= _areaTargetSource[x + y * _width] | _areaTargetSource2[x + y * _width];
+        }
+        return any != 0;
+    }
+
+    // calls run(tileBegin, tileEnd) for each run of neighboring tiles of a row in _awakeTiles[begin, end)
+    void ForEachTileRun(int begin, int end, const std::function<void(int, int)>& run)
+    {
+        int i = begin;
+        while (i < end)
+        {
+            const int tileBegin = _awakeTiles[i];
+            int tileEnd = tileBegin + 1;
+            i++;
+            while (i < end && _awakeTiles[i] == tileEnd && tileEnd % _tilesX != 0)
+            {
+                tileEnd++;
+                i++;
+            }
+            run(tileBegin, tileEnd);
+        }
+    }
+
+    // rows and columns of cells of a run of tiles
+    void TileRunCells(int tileBegin, int tileEnd, int* xBegin, int* xEnd, int* yBegin, int* yEnd)
+    {
+        int lastXBegin, lastYBegin, lastYEnd, firstXEnd;
+        TileCells(tileBegin, xBegin, &firstXEnd, yBegin, yEnd);
+        TileCells(tileEnd - 1, &lastXBegin, xEnd, &lastYBegin, &lastYEnd);
+    }
+
+    // steps only tiles that have a moving, movable or changed cell in their 3x3 neighborhood of tiles on previous step (or brushes and input)
+    // other tiles would not change: their targets and sources are 0, both state buffers have same values and only their seeds advance
+    // awake tiles are compacted into a list (in order of tiles) and the list is split evenly between threads
+    void StepSleepingTiles()
+    {
+        const unsigned char* areaState = _areaState[_currentState].data();
+        unsigned char* areaState2 = _areaState[1 - _currentState].data();
+        unsigned char* areaTargetSource = _areaTargetSource.data();
+        unsigned char* areaTargetSource2 = _areaTargetSource2.data();
+        unsigned int* randomSeedState = (_counterRandom ? nullptr : _randomSeedState.data());
+        const unsigned char* tileFlags = _tileFlags[_tileParity].data();
+        unsigned char* nextTileFlags = _tileFlags[1 - _tileParity].data();
+
+        _awakeTiles.clear();
+        for (int tileY = 0; tileY < _tilesY; tileY++)
+        {
+            for (int tileX = 0; tileX < _tilesX; tileX++)
+            {
+                bool awake = false;
+                for (int y = std::max(tileY - 1, 0); y <= std::min(tileY + 1, _tilesY - 1); y++)
+                {
+                    for (int x = std::max(tileX - 1, 0); x <= std::min(tileX + 1, _tilesX - 1); x++)
+                        awake = awake || tileFlags[x + y * _tilesX] != 0;
+                }
+                if (awake)
+                    _awakeTiles.push_back(tileX + tileY * _tilesX);
+                else
+                    _tileSleep[tileX + tileY * _tilesX]++;
+            }
+        }
+        std::fill(_tileFlags[1 - _tileParity].begin(), _tileFlags[1 - _tileParity].end(), 0);
+
+        const int numAwakeTiles = (int)_awakeTiles.size();
+        std::atomic<bool> missed(false);
+        if (numAwakeTiles > 0)
+        {
+            RunParts(numAwakeTiles, [&](int begin, int end) {
+                bool missedOfBand = false;
+                ForEachTileRun(begin, end, [&](int tileBegin, int tileEnd) {
+                    for (int tile = tileBegin; tile < tileEnd; tile++)
+                        CatchUpTile(tile);
+                    int xBegin, xEnd, yBegin, yEnd;
+                    TileRunCells(tileBegin, tileEnd, &xBegin, &xEnd, &yBegin, &yEnd);
+                    for (int y = yBegin; y < yEnd; y++)
+                        GuessParticleTargetSpan(areaState, randomSeedState, areaTargetSource, y, xBegin, xEnd, &missedOfBand);
+                });
+                if (missedOfBand)
+                    missed = true;
+            });
+
+            RunParts(numAwakeTiles, [&](int begin, int end) {
+                ForEachTileRun(begin, end, [&](int tileBegin, int tileEnd) {
+                    int xBegin, xEnd, yBegin, yEnd;
+                    TileRunCells(tileBegin, tileEnd, &xBegin, &xEnd, &yBegin, &yEnd);
+                    for (int y = yBegin; y < yEnd; y++)
+                        PickOneTargetGuessSpan(areaTargetSource, areaTargetSource2, randomSeedState, y, xBegin, xEnd);
+                });
+            });
+
+            RunParts(numAwakeTiles, [&](int begin, int end) {
+                ForEachTileRun(begin, end, [&](int tileBegin, int tileEnd) {
+                    int xBegin, xEnd, yBegin, yEnd;
+                    TileRunCells(tileBegin, tileEnd, &xBegin, &xEnd, &yBegin, &yEnd);
+                    for (int y = yBegin; y < yEnd; y++)
+                        MoveSandSpan(areaTargetSource, areaTargetSource2, areaState, areaState2, y, xBegin, xEnd);
+                    for (int tile = tileBegin; tile < tileEnd; tile++)
+                        nextTileFlags[tile] = TileActive(tile) ? 1 : 0;
+                });
+            });
+        }
+
+        // a cell that could move but did not pick a target (rare) is not visible in targets, so all tiles stay awake
+        if (missed)
+            std::fill(_tileFlags[1 - _tileParity].begin(), _tileFlags[1 - _tileParity].end(), 1);
+
+        _currentState = 1 - _currentState;
+        _tileParity = 1 - _tileParity;
+        _randomStep++;
+    }
+
+    // seeds of all sleeping tiles catch up (before steps that compute all cells)
+    void CatchUpAllTiles()
+    {
+        RunParts(_tilesX * _tilesY, [&](int begin, int end) {
+            for (int tile = begin; tile < end; tile++)
+                CatchUpTile(tile);
+        });
+    }
+
+    void WakeAllTiles()
+    {
+        std::fill(_tileFlags[_tileParity].begin(), _tileFlags[_tileParity].end(), 1);
+    }
+
+    // first part of a band when numParts parts are split evenly between bands
+    int BandBegin(int band, int numParts)
+    {
+        return (int)((size_t)numParts * band / _numBands);
+    }
+
+    // runs job(partBegin, partEnd) on all bands and waits
+    void RunParts(int numParts, const std::function<void(int, int)>& job)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _job = job;
+            _jobParts = numParts;
+            _jobsPending = (int)_threads.size();
+            _jobGeneration++;
+        }
+        _jobStart.notify_all();
+        job(BandBegin(0, numParts), BandBegin(1, numParts));
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobDone.wait(lock, [&]() { return _jobsPending == 0; });
+    }
+
+    // runs job(rowBegin, rowEnd) on all bands of rows and waits
+    void RunBands(const std::function<void(int, int)>& job)
+    {
+        RunParts(_height, job);
+    }
+
+    void WorkerLoop(int band)
+    {
+        size_t generation = 0;
+        while (true)
+        {
+            std::function<void(int, int)> job;
+            int numParts;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _jobStart.wait(lock, [&]() { return _stop || _jobGeneration != generation; });
+                if (_stop)
+                    return;
+                generation = _jobGeneration;
+                job = _job;
+                numParts = _jobParts;
+            }
+            job(BandBegin(band, numParts), BandBegin(band + 1, numParts));
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _jobsPending--;
+            }
+            _jobDone.notify_one();
+        }
+    }
+
+public:
+    // cells per side of a sleeping tile
+    const static int SLEEP_TILE_SIZE = 16;
+
+    // numThreads: 0 = all hardware threads
+    // counterRandom: random numbers are generated from cell index and step number instead of per-cell seeds (randomSeedIn is not used)
+    NativeBackend(int width, int height, int brushCapacity, int brushRecordInts, int brushShapeCircle, int numThreads = 0, bool counterRandom = false)
+    {
+        _width = width;
+        _height = height;
+        _brushCapacity = brushCapacity;
+        _brushRecordInts = brushRecordInts;
+        _brushShapeCircle = brushShapeCircle;
+        const size_t totalCells = (size_t)width * height;
+        areaIn = std::vector<unsigned char>(totalCells, 0);
+        areaOut = std::vector<unsigned char>(totalCells, 0);
+        randomSeedIn = std::vector<unsigned int>(totalCells, 0);
+        brushEvents = std::vector<int>(brushRecordInts * (1 + brushCapacity), 0);
+        palette = std::vector<unsigned char>(256 * 3, 0);
+        frame = std::vector<unsigned char>(totalCells * 3, 0);
+        _areaState[0] = std::vector<unsigned char>(totalCells, 0);
+        _areaState[1] = std::vector<unsigned char>(totalCells, 0);
+        _currentState = 0;
+        _areaTargetSource = std::vector<unsigned char>(totalCells, 0);
+        _areaTargetSource2 = std::vector<unsigned char>(totalCells, 0);
+        _counterRandom = counterRandom;
+        _randomStep = 0;
+        if (!counterRandom)
+            _randomSeedState = std::vector<unsigned int>(totalCells, 0);
+        _instructionSet = NativeSimd::DetectInstructionSet();
+
+        _sleepingTiles = false;
+        _tilesX = (width + SLEEP_TILE_SIZE - 1) / SLEEP_TILE_SIZE;
+        _tilesY = (height + SLEEP_TILE_SIZE - 1) / SLEEP_TILE_SIZE;
+        _tileFlags[0] = std::vector<unsigned char>((size_t)_tilesX * _tilesY, 1);
+        _tileFlags[1] = std::vector<unsigned char>((size_t)_tilesX * _tilesY, 1);
+        _tileParity = 0;
+        _tileSleep = std::vector<unsigned int>((size_t)_tilesX * _tilesY, 0);
+
+        if (numThreads <= 0)
+            numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+        numThreads = std::min(numThreads, std::max(height, 1));
+        _jobGeneration = 0;
+        _jobParts = 0;
+        _jobsPending = 0;
+        _stop = false;
+        _numBands = numThreads;
+        for (int i = 1; i < numThreads; i++)
+            _threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+
+    NativeBackend(const NativeBackend&) = delete;
+    NativeBackend& operator=(const NativeBackend&) = delete;
+
+    ~NativeBackend()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _jobStart.notify_all();
+        for (auto& thread : _threads)
+            thread.join();
+    }
+
+    int GetNumThreads()
+    {
+        return _numBands;
+    }
+
+    // best supported instruction set is selected by constructor, a lower one can be selected for comparison
+    void SetInstructionSet(int instructionSet)
+    {
+        if (instructionSet < NativeSimd::INSTRUCTION_SET_SCALAR || instructionSet > NativeSimd::DetectInstructionSet())
+            throw std::invalid_argument(std::string("error: instruction set is not supported by CPU: ") + NativeSimd::InstructionSetName(instructionSet));
+        _instructionSet = instructionSet;
+    }
+
+    int GetInstructionSet()
+    {
+        return _instructionSet;
+    }
+
+    // Step computes only awake tiles (same results as computing all cells)
+    void SetSleepingTiles(bool sleepingTiles)
+    {
+        if (sleepingTiles && !_sleepingTiles)
+            WakeAllTiles();
+        if (!sleepingTiles && _sleepingTiles)
+            CatchUpAllTiles();
+        _sleepingTiles = sleepingTiles;
+    }
+
+    bool GetSleepingTiles()
+    {
+        return _sleepingTiles;
+    }
+
+    // number of tiles computed by last Step with sleeping tiles
+    int GetNumAwakeTiles()
+    {
+        return (int)_awakeTiles.size();
+    }
+
+    // initRandomSeed (counter-based random numbers restart from step 0)
+    void InitRandomSeed()
+    {
+        if (!_counterRandom)
+            _randomSeedState = randomSeedIn;
+        _randomStep = 0;
+        std::fill(_tileSleep.begin(), _tileSleep.end(), 0);
+    }
+
+    bool GetCounterRandom()
+    {
+        return _counterRandom;
+    }
+
+    // areaBufInput
+    void AreaInput()
+    {
+        _areaState[_currentState] = areaIn;
+        WakeAllTiles();
+    }
+
+    // areaBufOutput
+    void AreaOutput()
+    {
+        areaOut = _areaState[_currentState];
+    }
+
+    // colorizeArea: colours areaOut with palette into frame, returns sum of materials
+    int Colorize()
+    {
+        std::atomic<int> total(0);
+        RunBands([&](int rowBegin, int rowEnd) {
+            int sum = 0;
+            for (size_t i = (size_t)rowBegin * _width; i < (size_t)rowEnd * _width; i++)
+            {
+                const int matter = areaOut[i];
+                frame[3 * i] = palette[3 * matter];
+                frame[3 * i + 1] = palette[3 * matter + 1];
+                frame[3 * i + 2] = palette[3 * matter + 2];
+                sum += matter;
+            }
+            total += sum;
+        });
+        return total;
+    }
+
+    // applyBrushEvents (pending brushes in order, later brushes overwrite earlier ones)
+    void ApplyBrushEvents()
+    {
+        const int count = brushEvents[0];
+        if (count == 0)
+            return;
+
+        unsigned char* areaState = _areaState[_currentState].data();
+        RunBands([&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++)
+            {
+                for (int x = 0; x < _width; x++)
+                {
+                    int matter = -1;
+                    for (int k = 0; k < count; k++)
+                    {
+                        const int* brush = brushEvents.data() + _brushRecordInts * (1 + (brushEvents[1] + k) % _brushCapacity);
+                        if (BrushCovers(brush, x, y))
+                            matter = brush[4];
+                    }
+                    if (matter >= 0)
+                        areaState[x + y * _width] = (unsigned char)matter;
+                }
+            }
+        });
+
+        // tiles under squares of brushes wake up
+        for (int k = 0; k < count; k++)
+        {
+            const int* brush = brushEvents.data() + _brushRecordInts * (1 + (brushEvents[1] + k) % _brushCapacity);
+            const int tileXBegin = std::max(brush[0] - brush[2], 0) / SLEEP_TILE_SIZE;
+            const int tileXEnd = std::min(brush[0] + brush[2], _width - 1) / SLEEP_TILE_SIZE;
+            const int tileYBegin = std::max(brush[1] - brush[2], 0) / SLEEP_TILE_SIZE;
+            const int tileYEnd = std::min(brush[1] + brush[2], _height - 1) / SLEEP_TILE_SIZE;
+            for (int tileY = tileYBegin; tileY <= tileYEnd; tileY++)
+            {
+                for (int tileX = tileXBegin; tileX <= tileXEnd; tileX++)
+                    _tileFlags[_tileParity][tileX + tileY * _tilesX] = 1;
+            }
+        }
+    }
+
+    // guessParticleTarget, pickOneTargetGuess and moveSand, then next state becomes current
+    void Step()
+    {
+        if (_sleepingTiles)
+        {
+            StepSleepingTiles();
+            return;
+        }
+
+        const unsigned char* areaState = _areaState[_currentState].data();
+        unsigned char* areaState2 = _areaState[1 - _currentState].data();
+        unsigned char* areaTargetSource = _areaTargetSource.data();
+        unsigned char* areaTargetSource2 = _areaTargetSource2.data();
+        unsigned int* randomSeedState = (_counterRandom ? nullptr : _randomSeedState.data());
+        const int width = _width;
+
+        RunBands([&](int rowBegin, int rowEnd) {
+            bool missed = false;
+            for (int y = rowBegin; y < rowEnd; y++)
+                GuessParticleTargetSpan(areaState, randomSeedState, areaTargetSource, y, 0, width, &missed);
+        });
+
+        RunBands([&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++)
+                PickOneTargetGuessSpan(areaTargetSource, areaTargetSource2, randomSeedState, y, 0, width);
+        });
+
+        RunBands([&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++)
+                MoveSandSpan(areaTargetSource, areaTargetSource2, areaState, areaState2, y, 0, width);
+        });
+
+        _currentState = 1 - _currentState;
+        _randomStep++;
+    }
+};
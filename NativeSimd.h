@@ -0,0 +1,461 @@
+#pragma once
+// vectorized rows of NativeBackend kernels (AVX2 and AVX-512), selected on runtime by the instruction sets of CPU
+// each function computes cells xBegin <= x < xEnd of a row from xBegin (1 <= xBegin, xEnd <= width - 1, so left and right neighbors always exist) and returns the first x it did not compute
+// random numbers use 32-bit lanes (8 cells per AVX2 instruction, 16 cells per AVX-512 instruction), moveSand uses 8-bit lanes (32 or 64 cells per instruction)
+// randomSeedState = nullptr: seeds are generated from cell index and randomStep (counter-based random numbers, nothing is stored)
+// results are same as scalar code: unsigned to float conversion rounds once (like OpenCL) and picks use masks in same order as branches of kernels
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NATIVE_SIMD_X86
+#include<immintrin.h>
+#if defined(_MSC_VER)
+#include<intrin.h>
+#endif
+#endif
+
+#if defined(NATIVE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define NATIVE_SIMD_AVX2 __attribute__((target("avx2")))
+#define NATIVE_SIMD_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define NATIVE_SIMD_AVX2
+#define NATIVE_SIMD_AVX512
+#endif
+
+namespace NativeSimd
+{
+    const static int INSTRUCTION_SET_SCALAR = 0;
+    const static int INSTRUCTION_SET_AVX2 = 1;
+    // AVX-512F and AVX-512BW
+    const static int INSTRUCTION_SET_AVX512 = 2;
+
+    // best instruction set that CPU and OS support
+    static int DetectInstructionSet()
+    {
+#if defined(NATIVE_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return INSTRUCTION_SET_SCALAR;
+        __cpuid(info, 1);
+        const bool osSavesRegisters = (info[2] & (1 << 27)) != 0;
+        if (!osSavesRegisters)
+            return INSTRUCTION_SET_SCALAR;
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        const bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+        const bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (xcr0 & 0xe6) == 0xe6;
+        if (avx512)
+            return INSTRUCTION_SET_AVX512;
+        if (avx2)
+            return INSTRUCTION_SET_AVX2;
+        return INSTRUCTION_SET_SCALAR;
+#elif defined(NATIVE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return INSTRUCTION_SET_AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return INSTRUCTION_SET_AVX2;
+        return INSTRUCTION_SET_SCALAR;
+#else
+        return INSTRUCTION_SET_SCALAR;
+#endif
+    }
+
+    static const char* InstructionSetName(int instructionSet)
+    {
+        if (instructionSet == INSTRUCTION_SET_AVX512)
+            return "avx512";
+        if (instructionSet == INSTRUCTION_SET_AVX2)
+            return "avx2";
+        return "scalar";
+    }
+
+#ifdef NATIVE_SIMD_X86
+    // ---------------- AVX2: 8 cells per 32-bit lane operation ----------------
+
+    NATIVE_SIMD_AVX2 static inline __m256i LoadBytesAvx2(const unsigned char* ptr)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)ptr));
+    }
+
+    // lanes have values 0-255
+    NATIVE_SIMD_AVX2 static inline void StoreBytesAvx2(unsigned char* ptr, __m256i value)
+    {
+        const __m256i lowBytes = _mm256_shuffle_epi8(value, _mm256_setr_epi8(
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+        _mm_storel_epi64((__m128i*)ptr, _mm_unpacklo_epi32(_mm256_castsi256_si128(lowBytes), _mm256_extracti128_si256(lowBytes, 1)));
+    }
+
+    NATIVE_SIMD_AVX2 static inline __m256i RndAvx2(__m256i seed)
+    {
+        seed = _mm256_xor_si256(_mm256_xor_si256(seed, _mm256_set1_epi32(61)), _mm256_srli_epi32(seed, 16));
+        seed = _mm256_mullo_epi32(seed, _mm256_set1_epi32(9));
+        seed = _mm256_xor_si256(seed, _mm256_srli_epi32(seed, 4));
+        seed = _mm256_mullo_epi32(seed, _mm256_set1_epi32(0x27d4eb2d));
+        seed = _mm256_xor_si256(seed, _mm256_srli_epi32(seed, 15));
+        return seed;
+    }
+
+    // Philox2x32-10 of counters (cell, step) and key (phase), same as CounterSeed of NativeBackend
+    NATIVE_SIMD_AVX2 static inline __m256i CounterSeedAvx2(int cell, unsigned int step, unsigned int phase)
+    {
+        __m256i counter0 = _mm256_add_epi32(_mm256_set1_epi32(cell), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256i counter1 = _mm256_set1_epi32((int)step);
+        const __m256i multiplier = _mm256_set1_epi32((int)0xD256D193u);
+        unsigned int key = phase;
+        for (int round = 0; round < 10; round++)
+        {
+            // high halves of 32x32-bit products: even lanes shifted down, odd lanes already in place
+            const __m256i productEven = _mm256_mul_epu32(counter0, multiplier);
+            const __m256i productOdd = _mm256_mul_epu32(_mm256_srli_epi64(counter0, 32), multiplier);
+            const __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(productEven, 32), productOdd, 0xAA);
+            const __m256i low = _mm256_mullo_epi32(counter0, multiplier);
+            counter0 = _mm256_xor_si256(_mm256_xor_si256(high, _mm256_set1_epi32((int)key)), counter1);
+            counter1 = low;
+            key += 0x9E3779B9u;
+        }
+        return counter0;
+    }
+
+    // floor(float(seed) * UIMAXFLOATINV * float(totProb))
+    // AVX2 converts only signed integers: both 16-bit halves convert exactly and their sum is rounded once
+    NATIVE_SIMD_AVX2 static inline __m256i SelectedAvx2(__m256i seed, __m256i totProb)
+    {
+        const __m256 high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(seed, 16)), _mm256_set1_ps(65536.0f));
+        const __m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(seed, _mm256_set1_epi32(0xffff)));
+        __m256 random = _mm256_mul_ps(_mm256_add_ps(high, low), _mm256_set1_ps(2.32830644e-10f));
+        random = _mm256_mul_ps(random, _mm256_cvtepi32_ps(totProb));
+        return _mm256_cvttps_epi32(_mm256_floor_ps(random));
+    }
+
+    // first direction (in order of codes) that can be picked and has selected < cumulative probability
+    // picked: direction code or 0, chosen: all bits set where a direction is picked
+    NATIVE_SIMD_AVX2 static inline void PickAvx2(const __m256i can[4], const __m256i tot[4], __m256i selected, __m256i& picked, __m256i& chosen)
+    {
+        picked = _mm256_setzero_si256();
+        chosen = _mm256_setzero_si256();
+        for (int d = 0; d < 4; d++)
+        {
+            const __m256i hit = _mm256_andnot_si256(chosen, _mm256_and_si256(can[d], _mm256_cmpgt_epi32(tot[d], selected)));
+            picked = _mm256_or_si256(picked, _mm256_and_si256(hit, _mm256_set1_epi32(1 << d)));
+            chosen = _mm256_or_si256(chosen, hit);
+        }
+    }
+
+    // guessParticleTarget
+    // missed: set if a cell could move but picked no target (random number rounded to 1.0f)
+    NATIVE_SIMD_AVX2 static int GuessParticleTargetSpanAvx2(const unsigned char* areaState, unsigned int* randomSeedState, unsigned int randomStep, unsigned char* areaTargetSource, int width, int y, int topY, int botY, int xBegin, int xEnd,
+        int probUp, int probRight, int probBot, int probLeft, bool* missed)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i hasTop = _mm256_set1_epi32(topY != y ? -1 : 0);
+        const __m256i hasBot = _mm256_set1_epi32(botY != y ? -1 : 0);
+        const __m256i prob[4] = { _mm256_set1_epi32(probUp), _mm256_set1_epi32(probRight), _mm256_set1_epi32(probBot), _mm256_set1_epi32(probLeft) };
+        __m256i missedLanes = zero;
+        int x = xBegin;
+        for (; x + 8 <= xEnd; x += 8)
+        {
+            const int id = x + y * width;
+            const __m256i sand = _mm256_cmpeq_epi32(LoadBytesAvx2(areaState + id), _mm256_set1_epi32(1));
+            __m256i can[4];
+            can[0] = _mm256_and_si256(_mm256_and_si256(sand, hasTop), _mm256_cmpeq_epi32(LoadBytesAvx2(areaState + x + topY * width), zero));
+            can[1] = _mm256_and_si256(sand, _mm256_cmpeq_epi32(LoadBytesAvx2(areaState + id + 1), zero));
+            can[2] = _mm256_and_si256(_mm256_and_si256(sand, hasBot), _mm256_cmpeq_epi32(LoadBytesAvx2(areaState + x + botY * width), zero));
+            can[3] = _mm256_and_si256(sand, _mm256_cmpeq_epi32(LoadBytesAvx2(areaState + id - 1), zero));
+
+            __m256i tot[4];
+            __m256i sum = zero;
+            for (int d = 0; d < 4; d++)
+            {
+                sum = _mm256_add_epi32(sum, _mm256_and_si256(can[d], prob[d]));
+                tot[d] = sum;
+            }
+
+            const __m256i seed = (randomSeedState ? _mm256_loadu_si256((const __m256i*)(randomSeedState + id)) : CounterSeedAvx2(id, randomStep, 0));
+            const __m256i newSeed = RndAvx2(seed);
+            __m256i picked, chosen;
+            PickAvx2(can, tot, SelectedAvx2(newSeed, sum), picked, chosen);
+
+            missedLanes = _mm256_or_si256(missedLanes, _mm256_andnot_si256(chosen, _mm256_cmpgt_epi32(sum, zero)));
+
+            // seed changes only if a target is picked
+            if (randomSeedState)
+                _mm256_storeu_si256((__m256i*)(randomSeedState + id), _mm256_blendv_epi8(seed, newSeed, chosen));
+            StoreBytesAvx2(areaTargetSource + id, picked);
+        }
+        if (!_mm256_testz_si256(missedLanes, missedLanes))
+            *missed = true;
+        return x;
+    }
+
+    // pickOneTargetGuess
+    NATIVE_SIMD_AVX2 static int PickOneTargetGuessSpanAvx2(const unsigned char* areaTargetSource, unsigned char* areaTargetSource2, unsigned int* randomSeedState, unsigned int randomStep, int width, int y, int topY, int botY, int xBegin, int xEnd,
+        int probUp, int probRight, int probBot, int probLeft)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i hasTop = _mm256_set1_epi32(topY != y ? -1 : 0);
+        const __m256i hasBot = _mm256_set1_epi32(botY != y ? -1 : 0);
+        const __m256i prob[4] = { _mm256_set1_epi32(probBot), _mm256_set1_epi32(probLeft), _mm256_set1_epi32(probUp), _mm256_set1_epi32(probRight) };
+        int x = xBegin;
+        for (; x + 8 <= xEnd; x += 8)
+        {
+            const int id = x + y * width;
+            // neighbors that send to this cell
+            __m256i can[4];
+            can[0] = _mm256_and_si256(hasTop, _mm256_cmpeq_epi32(LoadBytesAvx2(areaTargetSource + x + topY * width), _mm256_set1_epi32(4)));
+            can[1] = _mm256_cmpeq_epi32(LoadBytesAvx2(areaTargetSource + id + 1), _mm256_set1_epi32(8));
+            can[2] = _mm256_and_si256(hasBot, _mm256_cmpeq_epi32(LoadBytesAvx2(areaTargetSource + x + botY * width), _mm256_set1_epi32(1)));
+            can[3] = _mm256_cmpeq_epi32(LoadBytesAvx2(areaTargetSource + id - 1), _mm256_set1_epi32(2));
+
+            __m256i tot[4];
+            __m256i sum = zero;
+            for (int d = 0; d < 4; d++)
+            {
+                sum = _mm256_add_epi32(sum, _mm256_and_si256(can[d], prob[d]));
+                tot[d] = sum;
+            }
+
+            // seed always changes
+            const __m256i newSeed = RndAvx2(randomSeedState ? _mm256_loadu_si256((const __m256i*)(randomSeedState + id)) : CounterSeedAvx2(id, randomStep, 1));
+            __m256i picked, chosen;
+            PickAvx2(can, tot, SelectedAvx2(newSeed, sum), picked, chosen);
+
+            if (randomSeedState)
+                _mm256_storeu_si256((__m256i*)(randomSeedState + id), newSeed);
+            StoreBytesAvx2(areaTargetSource2 + id, picked);
+        }
+        return x;
+    }
+
+    // moveSand (32 cells per operation)
+    NATIVE_SIMD_AVX2 static int MoveSandSpanAvx2(const unsigned char* areaTargetSource, const unsigned char* areaTargetSource2, const unsigned char* areaState, unsigned char* areaState2, int width, int y, int topY, int botY, int xBegin, int xEnd)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi8(1);
+        const __m256i two = _mm256_set1_epi8(2);
+        const __m256i four = _mm256_set1_epi8(4);
+        const __m256i eight = _mm256_set1_epi8(8);
+        const __m256i hasTop = _mm256_set1_epi8(topY != y ? -1 : 0);
+        const __m256i hasBot = _mm256_set1_epi8(botY != y ? -1 : 0);
+        int x = xBegin;
+        for (; x + 32 <= xEnd; x += 32)
+        {
+            const int id = x + y * width;
+            const int topId = x + topY * width;
+            const int botId = x + botY * width;
+            const __m256i center = _mm256_loadu_si256((const __m256i*)(areaState + id));
+            const __m256i targetCenter = _mm256_loadu_si256((const __m256i*)(areaTargetSource + id));
+            const __m256i sourceCenter = _mm256_loadu_si256((const __m256i*)(areaTargetSource2 + id));
+            const __m256i empty = _mm256_cmpeq_epi8(center, zero);
+
+            // empty cell checks targets of neighbors, non-empty cell checks sources of neighbors
+            const __m256i top = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(areaTargetSource2 + topId)), _mm256_loadu_si256((const __m256i*)(areaTargetSource + topId)), empty);
+            const __m256i right = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(areaTargetSource2 + id + 1)), _mm256_loadu_si256((const __m256i*)(areaTargetSource + id + 1)), empty);
+            const __m256i bot = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(areaTargetSource2 + botId)), _mm256_loadu_si256((const __m256i*)(areaTargetSource + botId)), empty);
+            const __m256i left = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(areaTargetSource2 + id - 1)), _mm256_loadu_si256((const __m256i*)(areaTargetSource + id - 1)), empty);
+
+            const __m256i fromTop = _mm256_and_si256(hasTop, _mm256_cmpeq_epi8(top, four));
+            const __m256i fromRight = _mm256_cmpeq_epi8(right, eight);
+            const __m256i fromBot = _mm256_and_si256(hasBot, _mm256_cmpeq_epi8(bot, one));
+            const __m256i fromLeft = _mm256_cmpeq_epi8(left, two);
+
+            const __m256i received = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(fromTop, _mm256_cmpeq_epi8(sourceCenter, one)), _mm256_and_si256(fromRight, _mm256_cmpeq_epi8(sourceCenter, two))),
+                _mm256_or_si256(_mm256_and_si256(fromBot, _mm256_cmpeq_epi8(sourceCenter, four)), _mm256_and_si256(fromLeft, _mm256_cmpeq_epi8(sourceCenter, eight))));
+            const __m256i sent = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(fromTop, _mm256_cmpeq_epi8(targetCenter, one)), _mm256_and_si256(fromRight, _mm256_cmpeq_epi8(targetCenter, two))),
+                _mm256_or_si256(_mm256_and_si256(fromBot, _mm256_cmpeq_epi8(targetCenter, four)), _mm256_and_si256(fromLeft, _mm256_cmpeq_epi8(targetCenter, eight))));
+
+            const __m256i result = _mm256_blendv_epi8(_mm256_andnot_si256(sent, center), _mm256_and_si256(received, one), empty);
+            _mm256_storeu_si256((__m256i*)(areaState2 + id), result);
+        }
+        return x;
+    }
+
+    // ---------------- AVX-512: 16 cells per 32-bit lane operation ----------------
+
+    NATIVE_SIMD_AVX512 static inline __m512i LoadBytesAvx512(const unsigned char* ptr)
+    {
+        return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)ptr));
+    }
+
+    NATIVE_SIMD_AVX512 static inline void StoreBytesAvx512(unsigned char* ptr, __m512i value)
+    {
+        _mm_storeu_si128((__m128i*)ptr, _mm512_cvtepi32_epi8(value));
+    }
+
+    NATIVE_SIMD_AVX512 static inline __m512i RndAvx512(__m512i seed)
+    {
+        seed = _mm512_xor_si512(_mm512_xor_si512(seed, _mm512_set1_epi32(61)), _mm512_srli_epi32(seed, 16));
+        seed = _mm512_mullo_epi32(seed, _mm512_set1_epi32(9));
+        seed = _mm512_xor_si512(seed, _mm512_srli_epi32(seed, 4));
+        seed = _mm512_mullo_epi32(seed, _mm512_set1_epi32(0x27d4eb2d));
+        seed = _mm512_xor_si512(seed, _mm512_srli_epi32(seed, 15));
+        return seed;
+    }
+
+    NATIVE_SIMD_AVX512 static inline __m512i CounterSeedAvx512(int cell, unsigned int step, unsigned int phase)
+    {
+        __m512i counter0 = _mm512_add_epi32(_mm512_set1_epi32(cell), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        __m512i counter1 = _mm512_set1_epi32((int)step);
+        const __m512i multiplier = _mm512_set1_epi32((int)0xD256D193u);
+        unsigned int key = phase;
+        for (int round = 0; round < 10; round++)
+        {
+            const __m512i productEven = _mm512_mul_epu32(counter0, multiplier);
+            const __m512i productOdd = _mm512_mul_epu32(_mm512_srli_epi64(counter0, 32), multiplier);
+            const __m512i high = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(productEven, 32), productOdd);
+            const __m512i low = _mm512_mullo_epi32(counter0, multiplier);
+            counter0 = _mm512_xor_si512(_mm512_xor_si512(high, _mm512_set1_epi32((int)key)), counter1);
+            counter1 = low;
+            key += 0x9E3779B9u;
+        }
+        return counter0;
+    }
+
+    NATIVE_SIMD_AVX512 static inline __m512i SelectedAvx512(__m512i seed, __m512i totProb)
+    {
+        __m512 random = _mm512_mul_ps(_mm512_cvtepu32_ps(seed), _mm512_set1_ps(2.32830644e-10f));
+        random = _mm512_mul_ps(random, _mm512_cvtepi32_ps(totProb));
+        return _mm512_cvttps_epi32(_mm512_roundscale_ps(random, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+    }
+
+    NATIVE_SIMD_AVX512 static inline void PickAvx512(const __mmask16 can[4], const __m512i tot[4], __m512i selected, __m512i& picked, __mmask16& chosen)
+    {
+        picked = _mm512_setzero_si512();
+        chosen = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            const __mmask16 hit = (__mmask16)(can[d] & _mm512_cmplt_epi32_mask(selected, tot[d]) & ~chosen);
+            picked = _mm512_mask_mov_epi32(picked, hit, _mm512_set1_epi32(1 << d));
+            chosen = (__mmask16)(chosen | hit);
+        }
+    }
+
+    NATIVE_SIMD_AVX512 static int GuessParticleTargetSpanAvx512(const unsigned char* areaState, unsigned int* randomSeedState, unsigned int randomStep, unsigned char* areaTargetSource, int width, int y, int topY, int botY, int xBegin, int xEnd,
+        int probUp, int probRight, int probBot, int probLeft, bool* missed)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        const __mmask16 hasTop = (topY != y ? 0xffff : 0);
+        const __mmask16 hasBot = (botY != y ? 0xffff : 0);
+        const __m512i prob[4] = { _mm512_set1_epi32(probUp), _mm512_set1_epi32(probRight), _mm512_set1_epi32(probBot), _mm512_set1_epi32(probLeft) };
+        __mmask16 missedLanes = 0;
+        int x = xBegin;
+        for (; x + 16 <= xEnd; x += 16)
+        {
+            const int id = x + y * width;
+            const __mmask16 sand = _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaState + id), _mm512_set1_epi32(1));
+            __mmask16 can[4];
+            can[0] = (__mmask16)(sand & hasTop & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaState + x + topY * width), zero));
+            can[1] = (__mmask16)(sand & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaState + id + 1), zero));
+            can[2] = (__mmask16)(sand & hasBot & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaState + x + botY * width), zero));
+            can[3] = (__mmask16)(sand & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaState + id - 1), zero));
+
+            __m512i tot[4];
+            __m512i sum = zero;
+            for (int d = 0; d < 4; d++)
+            {
+                sum = _mm512_mask_add_epi32(sum, can[d], sum, prob[d]);
+                tot[d] = sum;
+            }
+
+            const __m512i seed = (randomSeedState ? _mm512_loadu_si512((const void*)(randomSeedState + id)) : CounterSeedAvx512(id, randomStep, 0));
+            const __m512i newSeed = RndAvx512(seed);
+            __m512i picked;
+            __mmask16 chosen;
+            PickAvx512(can, tot, SelectedAvx512(newSeed, sum), picked, chosen);
+
+            missedLanes = (__mmask16)(missedLanes | (_mm512_cmpgt_epi32_mask(sum, zero) & ~chosen));
+
+            if (randomSeedState)
+                _mm512_storeu_si512((void*)(randomSeedState + id), _mm512_mask_mov_epi32(seed, chosen, newSeed));
+            StoreBytesAvx512(areaTargetSource + id, picked);
+        }
+        if (missedLanes != 0)
+            *missed = true;
+        return x;
+    }
+
+    NATIVE_SIMD_AVX512 static int PickOneTargetGuessSpanAvx512(const unsigned char* areaTargetSource, unsigned char* areaTargetSource2, unsigned int* randomSeedState, unsigned int randomStep, int width, int y, int topY, int botY, int xBegin, int xEnd,
+        int probUp, int probRight, int probBot, int probLeft)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        const __mmask16 hasTop = (topY != y ? 0xffff : 0);
+        const __mmask16 hasBot = (botY != y ? 0xffff : 0);
+        const __m512i prob[4] = { _mm512_set1_epi32(probBot), _mm512_set1_epi32(probLeft), _mm512_set1_epi32(probUp), _mm512_set1_epi32(probRight) };
+        int x = xBegin;
+        for (; x + 16 <= xEnd; x += 16)
+        {
+            const int id = x + y * width;
+            __mmask16 can[4];
+            can[0] = (__mmask16)(hasTop & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaTargetSource + x + topY * width), _mm512_set1_epi32(4)));
+            can[1] = _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaTargetSource + id + 1), _mm512_set1_epi32(8));
+            can[2] = (__mmask16)(hasBot & _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaTargetSource + x + botY * width), _mm512_set1_epi32(1)));
+            can[3] = _mm512_cmpeq_epi32_mask(LoadBytesAvx512(areaTargetSource + id - 1), _mm512_set1_epi32(2));
+
+            __m512i tot[4];
+            __m512i sum = zero;
+            for (int d = 0; d < 4; d++)
+            {
+                sum = _mm512_mask_add_epi32(sum, can[d], sum, prob[d]);
+                tot[d] = sum;
+            }
+
+            const __m512i newSeed = RndAvx512(randomSeedState ? _mm512_loadu_si512((const void*)(randomSeedState + id)) : CounterSeedAvx512(id, randomStep, 1));
+            __m512i picked;
+            __mmask16 chosen;
+            PickAvx512(can, tot, SelectedAvx512(newSeed, sum), picked, chosen);
+
+            if (randomSeedState)
+                _mm512_storeu_si512((void*)(randomSeedState + id), newSeed);
+            StoreBytesAvx512(areaTargetSource2 + id, picked);
+        }
+        return x;
+    }
+
+    // moveSand (64 cells per operation)
+    NATIVE_SIMD_AVX512 static int MoveSandSpanAvx512(const unsigned char* areaTargetSource, const unsigned char* areaTargetSource2, const unsigned char* areaState, unsigned char* areaState2, int width, int y, int topY, int botY, int xBegin, int xEnd)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i one = _mm512_set1_epi8(1);
+        const __m512i two = _mm512_set1_epi8(2);
+        const __m512i four = _mm512_set1_epi8(4);
+        const __m512i eight = _mm512_set1_epi8(8);
+        const __mmask64 hasTop = (topY != y ? ~0ull : 0ull);
+        const __mmask64 hasBot = (botY != y ? ~0ull : 0ull);
+        int x = xBegin;
+        for (; x + 64 <= xEnd; x += 64)
+        {
+            const int id = x + y * width;
+            const int topId = x + topY * width;
+            const int botId = x + botY * width;
+            const __m512i center = _mm512_loadu_si512((const void*)(areaState + id));
+            const __m512i targetCenter = _mm512_loadu_si512((const void*)(areaTargetSource + id));
+            const __m512i sourceCenter = _mm512_loadu_si512((const void*)(areaTargetSource2 + id));
+            const __mmask64 empty = _mm512_cmpeq_epi8_mask(center, zero);
+
+            const __m512i top = _mm512_mask_blend_epi8(empty, _mm512_loadu_si512((const void*)(areaTargetSource2 + topId)), _mm512_loadu_si512((const void*)(areaTargetSource + topId)));
+            const __m512i right = _mm512_mask_blend_epi8(empty, _mm512_loadu_si512((const void*)(areaTargetSource2 + id + 1)), _mm512_loadu_si512((const void*)(areaTargetSource + id + 1)));
+            const __m512i bot = _mm512_mask_blend_epi8(empty, _mm512_loadu_si512((const void*)(areaTargetSource2 + botId)), _mm512_loadu_si512((const void*)(areaTargetSource + botId)));
+            const __m512i left = _mm512_mask_blend_epi8(empty, _mm512_loadu_si512((const void*)(areaTargetSource2 + id - 1)), _mm512_loadu_si512((const void*)(areaTargetSource + id - 1)));
+
+            const __mmask64 fromTop = hasTop & _mm512_cmpeq_epi8_mask(top, four);
+            const __mmask64 fromRight = _mm512_cmpeq_epi8_mask(right, eight);
+            const __mmask64 fromBot = hasBot & _mm512_cmpeq_epi8_mask(bot, one);
+            const __mmask64 fromLeft = _mm512_cmpeq_epi8_mask(left, two);
+
+            const __mmask64 received =
+                (fromTop & _mm512_cmpeq_epi8_mask(sourceCenter, one)) | (fromRight & _mm512_cmpeq_epi8_mask(sourceCenter, two)) |
+                (fromBot & _mm512_cmpeq_epi8_mask(sourceCenter, four)) | (fromLeft & _mm512_cmpeq_epi8_mask(sourceCenter, eight));
+            const __mmask64 sent =
+                (fromTop & _mm512_cmpeq_epi8_mask(targetCenter, one)) | (fromRight & _mm512_cmpeq_epi8_mask(targetCenter, two)) |
+                (fromBot & _mm512_cmpeq_epi8_mask(targetCenter, four)) | (fromLeft & _mm512_cmpeq_epi8_mask(targetCenter, eight));
+
+            // empty: 1 if received, non-empty: 0 if sent
+            const __m512i result = _mm512_mask_blend_epi8(empty, _mm512_maskz_mov_epi8(~sent, center), _mm512_maskz_mov_epi8(received, one));
+            _mm512_storeu_si512((void*)(areaState2 + id), result);
+        }
+        return x;
+    }
+#endif
+}
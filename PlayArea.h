@@ -1,8 +1,11 @@
 #pragma once
 #include "gpgpu/gpgpu.hpp"
+#include "NativeBackend.h"
 #include<memory>
 #include<string>
 #include<atomic>
+#include<map>
+#include<algorithm>
 
 struct PlayArea
 {
@@ -11,9 +14,10 @@ private:
     int _height;
     int _totalCells;
     std::shared_ptr<GPGPU::Computer> _computer;
+    // host threads compute the steps instead of OpenCL devices (BACKEND_NATIVE), _computer and its parameters are not created
+    std::shared_ptr<NativeBackend> _native;
     std::shared_ptr<GPGPU::HostParameter> _areaIn;
-    std::shared_ptr<GPGPU::HostParameter> _areaState;
-    std::shared_ptr<GPGPU::HostParameter> _areaState2;
+    std::shared_ptr<GPGPU::DoubleBuffer> _areaState;
     std::shared_ptr<GPGPU::HostParameter> _areaOut;
     std::shared_ptr<GPGPU::HostParameter> _areaTargetSource;
     std::shared_ptr<GPGPU::HostParameter> _areaTargetSource2;
@@ -22,29 +26,368 @@ private:
     std::shared_ptr<GPGPU::HostParameter> _areaPressureOut;
 
     std::shared_ptr<GPGPU::HostParameter> _randomSeedIn;
-    std::shared_ptr<GPGPU::HostParameter> _randomSeedState;
+    // 1 element with counter-based random numbers (not bound to any kernel)
+    std::shared_ptr<GPGPU::DoubleBuffer> _randomSeedState;
+
+    // counter-based random numbers (RANDOM_COUNTER): seeds are generated from cell index and step number, so there is no seed state per cell
+    bool _counterRandom;
+    // number of steps computed since Reset
+    unsigned int _randomStep;
+    // step number of first step of a frame, scalar argument of launches (a launch that starts on k-th step of frame gets it + k)
+    std::shared_ptr<GPGPU::HostParameter> _randomFrameStep;
+
+    // sleeping tiles (SIMULATION_MODE_SLEEPING_TILES): records of 16x16 tiles are on first row of each tile (1 element per tile column), so strips of rows own records of their tiles
+    // per tile: a cell moved, could move or was changed (by brushes or input) on previous step, for current and next step
+    std::shared_ptr<GPGPU::DoubleBuffer> _tileFlags;
+    // per tile: computed on current step
+    std::shared_ptr<GPGPU::HostParameter> _tileAwake;
+    // per tile: number of steps slept (its seeds are behind by that many random numbers)
+    std::shared_ptr<GPGPU::HostParameter> _tileSleep;
+    // seeds of sleeping tiles have to catch up before other modes compute them
+    bool _tileSeedsBehind;
+
+    // packed records (SIMULATION_MODE_PACKED_RECORDS): matter, target and source of a cell in 16 bits, ping-ponged by the 3 kernels of a step
+    std::shared_ptr<GPGPU::DoubleBuffer> _packedCells;
+    // local memory of a work-group: its records with a 1-cell ring
+    std::shared_ptr<GPGPU::HostParameter> _packedTile;
+
+    // padded grid (SIMULATION_MODE_PADDED_GRID): state, targets and sources with a border of wall cells, so kernels read neighbors without bound checks
+    // a row is _paddedPitch bytes (multiple of PADDED_ROW_ALIGNMENT) and first row starts after a border row, so all rows start on cache-line boundaries
+    // columns after last cell of a row are walls (right wall of the row and left wall of next row)
+    std::shared_ptr<GPGPU::DoubleBuffer> _paddedState;
+    std::shared_ptr<GPGPU::HostParameter> _paddedTargetSource;
+    std::shared_ptr<GPGPU::HostParameter> _paddedTargetSource2;
+    int _paddedPitch;
+
+    // bit-packed engine buffers (1 bit per cell)
+    std::shared_ptr<GPGPU::DoubleBuffer> _bitState;
+    std::shared_ptr<GPGPU::HostParameter> _bitRandomSeedState;
+    std::shared_ptr<GPGPU::HostParameter> _bitProposals;
+    std::shared_ptr<GPGPU::HostParameter> _bitAccepts;
+    // number of 32-cell words (padded to multiple of 256)
+    size_t _bitWords;
 
     std::shared_ptr<GPGPU::HostParameter> _parametersRandomInit;
-    std::shared_ptr<GPGPU::HostParameter> _parameterAreaInput;
-    std::shared_ptr<GPGPU::HostParameter> _parameterAreaOutput;
-    std::shared_ptr<GPGPU::HostParameter> _parameterAreaState;
-    std::shared_ptr<GPGPU::HostParameter> _parameterGuess1;
-    std::shared_ptr<GPGPU::HostParameter> _parameterGuess2;
-    std::shared_ptr<GPGPU::HostParameter> _parameterSandMove;
+    std::shared_ptr<GPGPU::HostParameter> _parametersBitRandomInit;
+    // per starting seed buffer and state buffer
+    std::shared_ptr<GPGPU::HostParameter> _parameterAreaInput[2][2];
+    std::shared_ptr<GPGPU::HostParameter> _parameterAreaOutput[2][2];
+    // output of last frame is copied to _areaOut only when host reads it (GetCell, RecheckOtherMaterials, mode or parameter changes)
+    bool _areaOutStale;
+    // parameters of last frame's output (its parity pair)
+    int _areaOutParity;
+    int _areaOutStateParity;
+
+    // brush edits waiting for next frame: a header record {count, first} followed by a ring of BRUSH_CAPACITY records
+    // record: x, y, radius, shape, material, probability (of 65536), serial
+    std::shared_ptr<GPGPU::HostParameter> _brushEvents;
+    // per state buffer
+    std::shared_ptr<GPGPU::HostParameter> _parameterBrush[2];
+    GPGPU::KernelId _brushKernel;
+    int _brushFirst;
+    int _brushCount;
+    unsigned int _brushSerial;
+    const static int BRUSH_CAPACITY = 256;
+    const static int BRUSH_RECORD_INTS = 8;
+
+    // display frame (ColorizeFrame): colorize kernels write 3 bytes (BGR) per cell from a palette of 256 materials and sum materials of 16x16 tiles
+    // frame is read back into host memory of _frameOut, that Render wraps with a cv::Mat without copying
+    std::shared_ptr<GPGPU::HostParameter> _palette;
+    std::shared_ptr<GPGPU::HostParameter> _frameOut;
+    // per tile (records on first row of each tile, like tileFlags): sum of materials of its cells
+    std::shared_ptr<GPGPU::HostParameter> _matterSums;
+    // per state buffer
+    std::shared_ptr<GPGPU::HostParameter> _parameterColorize[2];
+    GPGPU::KernelId _colorizeKernel;
+    const static int PALETTE_MATERIALS = 256;
+
+    // state stays on device between frames and brushes are stamped on device
+    // with multiple devices, each device computes a strip of rows and only halo rows of strips go through RAM
+    // _areaIn is uploaded to state on next frame (after reset or mode change)
+    bool _uploadArea;
 
 
     std::string _defineMacros;
+    std::string _defineBitMacros;
     size_t _frameTime;
     int _numComputePerFrame;
     int _quantumStrength;
+    int _simulationMode;
+    // picks simulation mode from materials on each frame
+    bool _autoSimulationMode;
+    // materials other than sand come only from brushes: a brush of such material sets _otherMaterials
+    // a brush of sand or empty may cover them, then output of frame is scanned once (only in auto mode) to clear it
+    bool _otherMaterials;
+    bool _otherMaterialsRecheck;
+
+    // device times of kernels and copies are shown on Render
+    bool _profiling;
+    // device time totals on last Render and number of frames computed after it
+    std::map<std::string, double> _profileTotals;
+    int _profileFrames;
+
+    // index of seed buffer that is current at start of next frame
+    int _seedParity;
+    // kernel list of a frame swaps seed buffers odd number of times
+    bool _seedParityChange;
+    // index of state buffer (byte, bit, packed or padded) that is current at start of next frame
+    int _stateParity;
+    bool _stateParityChange;
+
+    // kernel lists per starting seed buffer and state buffer, resolved once and replayed on each frame
+    GPGPU::LaunchPlan _launchPlan[2][2];
+    size_t _listGlobalThreads;
+    GPGPU::KernelId _areaInputKernel;
+    GPGPU::KernelId _areaOutputKernel;
+    size_t _areaInputOutputGlobalThreads;
+
+    // work-group size of kernels that run 1 thread per cell or per 32-cell word (fused/temporal/sleeping kernels always run 256 threads per tile, packed-record and padded-grid kernels 16x16)
+    int _localThreads;
+    // launch plans of per-cell and per-word kernels use fastest work-group size of each device (AutoTune)
+    bool _autoTune;
+
+    // number of simulation steps per launch in SIMULATION_MODE_TEMPORAL_BLOCKING
+    int _temporalBlockingSteps;
+    const static int TEMPORAL_BLOCKING_TILE_SIZE = 32;
+    const static int TEMPORAL_BLOCKING_MAX_STEPS = 16;
+    const static int SLEEP_TILE_SIZE = 16;
+    // packed-record kernels run 2D work-groups of PACKED_TILE_SIZE x PACKED_TILE_SIZE cells
+    const static int PACKED_TILE_SIZE = 16;
+    // padded-grid kernels run 2D work-groups of PADDED_GROUP_SIZE x PADDED_GROUP_SIZE cells
+    const static int PADDED_GROUP_SIZE = 16;
+    const static int PADDED_ROW_ALIGNMENT = 64;
+
+    // kernel code that computes numSteps simulation steps per launch in local memory, 1 work-group (256 threads) per tile of tileSize x tileSize cells
+    // tile is loaded with a (3 x numSteps)-cell halo once because each step needs 3 more cells of neighborhood:
+    //      new state of a cell needs picked sources of 1-cell ring, that need guessed targets of 2-cell ring, that need states of 3-cell ring
+    // halo cells are re-computed redundantly by each neighboring group, so only the new states and seeds of tile are written
+    // seeds are double-buffered because neighboring groups read halo seeds while a group writes its own
+    static std::string SimulationStepsKernelCode(std::string kernelName, int numSteps, int tileSize)
+    {
+        return std::string(R"(
+            #define TILE_SIZE )") + std::to_string(tileSize) + R"(
+            #define TILE_STEPS )" + std::to_string(numSteps) + R"(
+            #define TILE_HALO (3 * TILE_STEPS)
+            #define TILE_PITCH (TILE_SIZE + 2 * TILE_HALO)
+            #define TILE_CELLS (TILE_PITCH * TILE_PITCH)
+            #define TILE_THREADS 256
+            #define TILE_CELLS_PER_THREAD ((TILE_CELLS + TILE_THREADS - 1) / TILE_THREADS)
+            #define TILES_X ((PLAY_AREA_WIDTH + TILE_SIZE - 1) / TILE_SIZE)
+
+            kernel void )" + kernelName + R"((
+                const global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ areaState2,
+            #ifdef PLAY_AREA_COUNTER_RANDOM
+                const unsigned int randomStep
+            #else
+                const global unsigned int * __restrict__ randomSeedState,
+                global unsigned int * __restrict__ randomSeedState2
+            #endif
+            )
+            {
+                local unsigned char state[TILE_CELLS];
+                local unsigned char target[TILE_CELLS];
+                local unsigned char source[TILE_CELLS];
+            #ifndef PLAY_AREA_COUNTER_RANDOM
+                local unsigned int seed[TILE_CELLS];
+            #endif
+                unsigned char newState[TILE_CELLS_PER_THREAD];
+
+                const int localId = get_local_id(0);
+
+                // global id includes the offset given by load-balancer, group id does not
+                const int groupId = get_global_id(0) / TILE_THREADS;
+                const int tileX = (groupId % TILES_X) * TILE_SIZE - TILE_HALO;
+                const int tileY = (groupId / TILES_X) * TILE_SIZE - TILE_HALO;
+
+                // ring = distance to outer edge of local tile (0 = outermost halo cell, TILE_HALO = tile cell)
+                for(int i = localId; i < TILE_CELLS; i += TILE_THREADS)
+                {
+                    const int lx = i % TILE_PITCH;
+                    const int ly = i / TILE_PITCH;
+                    const int x = tileX + lx;
+                    const int y = tileY + ly;
+                    const int ring = min(min(lx, ly), min(TILE_PITCH - 1 - lx, TILE_PITCH - 1 - ly));
+                    const bool inside = (x >= 0 && x < PLAY_AREA_WIDTH && y >= 0 && y < PLAY_AREA_HEIGHT);
+                    state[i] = (inside ? areaState[x + y * PLAY_AREA_WIDTH] : 0);
+            #ifndef PLAY_AREA_COUNTER_RANDOM
+                    seed[i] = (inside && ring >= 1 ? randomSeedState[x + y * PLAY_AREA_WIDTH] : 0);
+            #endif
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                // valid region shrinks by 3 cells per step
+                for(int step = 0; step < TILE_STEPS; step++)
+                {
+                    const int ringGuess = 3 * step + 1;
+
+                    // guess targets
+                    for(int i = localId; i < TILE_CELLS; i += TILE_THREADS)
+                    {
+                        const int lx = i % TILE_PITCH;
+                        const int ly = i / TILE_PITCH;
+                        const int x = tileX + lx;
+                        const int y = tileY + ly;
+                        const int ring = min(min(lx, ly), min(TILE_PITCH - 1 - lx, TILE_PITCH - 1 - ly));
+                        const bool inside = (x >= 0 && x < PLAY_AREA_WIDTH && y >= 0 && y < PLAY_AREA_HEIGHT);
+                        if(inside && ring >= ringGuess)
+                        {
+                        #ifdef PLAY_AREA_COUNTER_RANDOM
+                            unsigned int randomSeed = counterSeed(x + y * PLAY_AREA_WIDTH, randomStep + step, 0);
+                        #else
+                            unsigned int randomSeed = seed[i];
+                        #endif
+                            target[i] = guessParticleTargetOfCell(
+                                state[i], state[i - TILE_PITCH], state[i + 1], state[i + TILE_PITCH], state[i - 1],
+                                y > 0, x < PLAY_AREA_WIDTH - 1, y < PLAY_AREA_HEIGHT - 1, x > 0,
+                                &randomSeed
+                            );
+                        #ifndef PLAY_AREA_COUNTER_RANDOM
+                            seed[i] = randomSeed;
+                        #endif
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+
+                    // pick sources
+                    for(int i = localId; i < TILE_CELLS; i += TILE_THREADS)
+                    {
+                        const int lx = i % TILE_PITCH;
+                        const int ly = i / TILE_PITCH;
+                        const int x = tileX + lx;
+                        const int y = tileY + ly;
+                        const int ring = min(min(lx, ly), min(TILE_PITCH - 1 - lx, TILE_PITCH - 1 - ly));
+                        const bool inside = (x >= 0 && x < PLAY_AREA_WIDTH && y >= 0 && y < PLAY_AREA_HEIGHT);
+                        if(inside && ring >= ringGuess + 1)
+                        {
+                        #ifdef PLAY_AREA_COUNTER_RANDOM
+                            unsigned int randomSeed = counterSeed(x + y * PLAY_AREA_WIDTH, randomStep + step, 1);
+                        #else
+                            unsigned int randomSeed = seed[i];
+                        #endif
+                            source[i] = pickOneTargetGuessOfCell(
+                                target[i - TILE_PITCH], target[i + 1], target[i + TILE_PITCH], target[i - 1],
+                                y > 0, x < PLAY_AREA_WIDTH - 1, y < PLAY_AREA_HEIGHT - 1, x > 0,
+                                &randomSeed
+                            );
+                        #ifndef PLAY_AREA_COUNTER_RANDOM
+                            seed[i] = randomSeed;
+                        #endif
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+
+                    // move matter (kept in registers until all cells have read the old state)
+                    for(int i = localId, c = 0; i < TILE_CELLS; i += TILE_THREADS, c++)
+                    {
+                        const int lx = i % TILE_PITCH;
+                        const int ly = i / TILE_PITCH;
+                        const int x = tileX + lx;
+                        const int y = tileY + ly;
+                        const int ring = min(min(lx, ly), min(TILE_PITCH - 1 - lx, TILE_PITCH - 1 - ly));
+                        newState[c] = state[i];
+                        if(ring >= ringGuess + 2)
+                        {
+                            newState[c] = moveSandOfCell(
+                                state[i], target[i], source[i],
+                                target[i - TILE_PITCH], target[i + 1], target[i + TILE_PITCH], target[i - 1],
+                                source[i - TILE_PITCH], source[i + 1], source[i + TILE_PITCH], source[i - 1],
+                                y > 0, x < PLAY_AREA_WIDTH - 1, y < PLAY_AREA_HEIGHT - 1, x > 0
+                            );
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+
+                    for(int i = localId, c = 0; i < TILE_CELLS; i += TILE_THREADS, c++)
+                    {
+                        state[i] = newState[c];
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+
+                // write new state + seed of tile
+                for(int i = localId; i < TILE_CELLS; i += TILE_THREADS)
+                {
+                    const int lx = i % TILE_PITCH;
+                    const int ly = i / TILE_PITCH;
+                    const int x = tileX + lx;
+                    const int y = tileY + ly;
+                    const int ring = min(min(lx, ly), min(TILE_PITCH - 1 - lx, TILE_PITCH - 1 - ly));
+                    const bool inside = (x >= 0 && x < PLAY_AREA_WIDTH && y >= 0 && y < PLAY_AREA_HEIGHT);
+                    if(inside && ring >= TILE_HALO)
+                    {
+                        areaState2[x + y * PLAY_AREA_WIDTH] = state[i];
+                    #ifndef PLAY_AREA_COUNTER_RANDOM
+                        randomSeedState2[x + y * PLAY_AREA_WIDTH] = seed[i];
+                    #endif
+                    }
+                }
+            }
+
+            // other tile sizes and steps can follow in same program
+            #undef TILE_SIZE
+            #undef TILE_STEPS
+            #undef TILE_HALO
+            #undef TILE_PITCH
+            #undef TILE_CELLS
+            #undef TILE_THREADS
+            #undef TILE_CELLS_PER_THREAD
+            #undef TILES_X
+        )";
+    }
 
-    std::vector<GPGPU::HostParameter> _listPrm;
-    std::vector<std::string> _listKernel;
+    // local memory bytes used by SimulationStepsKernelCode (state, target, source: 1 byte, seed: 4 bytes per cell unless random numbers are counter-based)
+    static size_t SimulationStepsLocalMemorySize(int numSteps, int tileSize, bool counterRandom)
+    {
+        const size_t pitch = tileSize + 2 * 3 * numSteps;
+        return pitch * pitch * (counterRandom ? 3 : 7);
+    }
 public:
+    // guessParticleTarget, pickOneTargetGuess, moveSand kernels per step
+    const static int SIMULATION_MODE_SEPARATE_KERNELS = 0;
+    // simulationStep kernel per step (same results as separate kernels)
+    const static int SIMULATION_MODE_FUSED = 1;
+    // simulationSteps kernel per several steps (same results as separate kernels)
+    const static int SIMULATION_MODE_TEMPORAL_BLOCKING = 2;
+    // 1 bit per cell, only for sand (statistically similar, not same results as other modes)
+    const static int SIMULATION_MODE_BIT_PACKED = 3;
+    // SIMULATION_MODE_BIT_PACKED when only sand exists in play area, SIMULATION_MODE_TEMPORAL_BLOCKING otherwise
+    const static int SIMULATION_MODE_AUTO = -1;
+    // separate kernels only on 16x16 tiles that have a moving, movable or changed cell in their 3x3 neighborhood of tiles on previous step (same results as separate kernels)
+    const static int SIMULATION_MODE_SLEEPING_TILES = 4;
+    // separate kernels on 16-bit records of matter, target and source per cell, 1 load per neighbor (same results as separate kernels)
+    const static int SIMULATION_MODE_PACKED_RECORDS = 5;
+    // paddedGuessParticleTarget, paddedPickOneTargetGuess, paddedMoveSand kernels per step on a grid with a border of wall cells (same results as separate kernels)
+    const static int SIMULATION_MODE_PADDED_GRID = 6;
+
+    // backends of constructor
+    // OpenCL devices (all simulation modes)
+    const static int BACKEND_OPENCL = 0;
+    // host threads, no OpenCL needed (separate-kernel rules for all modes except SIMULATION_MODE_BIT_PACKED, same results as OpenCL)
+    const static int BACKEND_NATIVE = 1;
+
+    // random numbers of constructor
+    // per-cell seeds (initialized by Reset, read and written by each step)
+    const static int RANDOM_SEEDS = 0;
+    // counter-based: seeds are generated from cell index, step number and phase (guess or pick) without any per-cell state (results differ from RANDOM_SEEDS, bit-packed engine still uses seeds)
+    const static int RANDOM_COUNTER = 1;
+
+    // brush shapes of AddBrushEvent
+    const static int BRUSH_SHAPE_SQUARE = 0;
+    const static int BRUSH_SHAPE_CIRCLE = 1;
+
     // width and height must be multiple of 16
-    PlayArea(int & width, int & height, int maximumGPUsToUse = 10, int indexGPU=0,  int numStepsPerFrame=10, int quantumStrength=1)
+    // temporalBlockingSteps: number of simulation steps per launch in SIMULATION_MODE_TEMPORAL_BLOCKING (0 = largest number that fits into local memory of devices, up to 16)
+    // profiling: devices measure their kernels and copies, Render shows device milliseconds per frame of each
+    // deviceTypes: GPGPU::Computer::DEVICE_GPUS, DEVICE_CPUS, DEVICE_ACCS or DEVICE_ALL (indexGPU and maximumGPUsToUse select from these)
+    // backend: BACKEND_OPENCL or BACKEND_NATIVE (device parameters and profiling are ignored by native backend)
+    // randomNumbers: RANDOM_SEEDS or RANDOM_COUNTER
+    // define PLAY_AREA_HEADLESS before including this file to compute without a window (Render and Stop do nothing, OpenCV is not needed)
+    PlayArea(int & width, int & height, int maximumGPUsToUse = 10, int indexGPU=0,  int numStepsPerFrame=10, int quantumStrength=1, int temporalBlockingSteps=0, bool profiling=false, int deviceTypes=GPGPU::Computer::DEVICE_GPUS, int backend=BACKEND_OPENCL, int randomNumbers=RANDOM_SEEDS)
     {
+#ifndef PLAY_AREA_HEADLESS
         cv::namedWindow("AATPTPT");
+#endif
         _numComputePerFrame = numStepsPerFrame;
         _width = width;
         _height = height;
@@ -56,49 +399,140 @@ public:
         width = _width;
         _totalCells = _width * _height;
         _quantumStrength = quantumStrength;
-        _computer = std::make_shared<GPGPU::Computer>(GPGPU::Computer::DEVICE_GPUS, indexGPU,1,false, maximumGPUsToUse); // allocate all devices for computations
+        _simulationMode = SIMULATION_MODE_SEPARATE_KERNELS;
+        _autoSimulationMode = true;
+        _otherMaterials = false;
+        _otherMaterialsRecheck = false;
+        _areaOutStale = false;
+        _areaOutParity = 0;
+        _areaOutStateParity = 0;
+        _seedParity = 0;
+        _seedParityChange = false;
+        _stateParity = 0;
+        _stateParityChange = false;
+        _brushFirst = 0;
+        _brushCount = 0;
+        _brushSerial = 0;
+        _uploadArea = true;
+        _tileSeedsBehind = false;
+        _counterRandom = (randomNumbers == RANDOM_COUNTER);
+        _randomStep = 0;
+        _profiling = profiling;
+        _profileFrames = 0;
+        _localThreads = 256;
+        _autoTune = false;
+        if (backend == BACKEND_NATIVE)
+        {
+            _profiling = false;
+            _temporalBlockingSteps = 1;
+            _bitWords = 0;
+            _native = std::make_shared<NativeBackend>(_width, _height, BRUSH_CAPACITY, BRUSH_RECORD_INTS, BRUSH_SHAPE_CIRCLE, 0, _counterRandom);
+            for (int material = 0; material < PALETTE_MATERIALS; material++)
+                SetMaterialColor(material, 0, (unsigned char)(material * 200), 0);
+            Reset();
+            PrepareGpuParameterList();
+            return;
+        }
+        _computer = std::make_shared<GPGPU::Computer>(deviceTypes, indexGPU,1,false, maximumGPUsToUse, true, profiling); // allocate all devices for computations, out-of-order queues (if supported) overlap independent commands
 
+        // all devices run same number of steps per launch, so the smallest local memory decides
+        std::vector<size_t> localMemorySizes = _computer->deviceLocalMemorySizes();
+        size_t localMemorySize = *std::min_element(localMemorySizes.begin(), localMemorySizes.end());
+        if (temporalBlockingSteps <= 0)
+        {
+            _temporalBlockingSteps = TEMPORAL_BLOCKING_MAX_STEPS;
+            while (_temporalBlockingSteps > 1 && SimulationStepsLocalMemorySize(_temporalBlockingSteps, TEMPORAL_BLOCKING_TILE_SIZE, _counterRandom) > localMemorySize)
+                _temporalBlockingSteps--;
+        }
+        else
+        {
+            _temporalBlockingSteps = temporalBlockingSteps;
+            if (SimulationStepsLocalMemorySize(_temporalBlockingSteps, TEMPORAL_BLOCKING_TILE_SIZE, _counterRandom) > localMemorySize)
+            {
+                throw std::invalid_argument(std::string("error: ") + std::to_string(temporalBlockingSteps) + std::string(" steps per launch do not fit into ") + std::to_string(localMemorySize) + std::string(" bytes of local memory"));
+            }
+        }
         // broadcast type input (duplicated on all gpus from ram)
         // load-balanced output                                                
         _areaIn = std::make_shared<GPGPU::HostParameter>(_computer->createArrayInput<unsigned char>("areaIn", _totalCells));
-        _areaState = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaState", _totalCells));
-        _areaState2 = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaState2", _totalCells));
+        // current/next state buffers are swapped by re-binding kernel arguments on each step
+        _areaState = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned char>("areaState", _totalCells));
         _areaOut = std::make_shared<GPGPU::HostParameter>(_computer->createArrayOutputAll<unsigned char>("areaOut", _totalCells));
         _areaTargetSource = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaTargetSource", _totalCells));
         _areaTargetSource2 = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaTargetSource2", _totalCells));
         
      
         _randomSeedIn = std::make_shared<GPGPU::HostParameter>(_computer->createArrayInput<unsigned int>("randomSeedIn", _totalCells));
-        _randomSeedState = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned int>("randomSeedState", _totalCells));
+        // fused step reads current seeds and writes next seeds (separate kernels update current seeds in-place)
+        _randomSeedState = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned int>("randomSeedState", _counterRandom ? 1 : _totalCells));
 
         _areaPressureIn = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaPressureIn", _totalCells));
         _areaPressureOut = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("areaPressureOut", _totalCells));
 
+        // only changed records are uploaded
+        _brushEvents = std::make_shared<GPGPU::HostParameter>(_computer->createArrayInput<int>("brushEvents", (BRUSH_CAPACITY + 1) * BRUSH_RECORD_INTS));
+
+        _palette = std::make_shared<GPGPU::HostParameter>(_computer->createArrayInput<unsigned char>("palette", PALETTE_MATERIALS * 3));
+        _frameOut = std::make_shared<GPGPU::HostParameter>(_computer->createArrayOutputAll<unsigned char>("frameOut", (size_t)_totalCells * 3));
 
+
+        const size_t tileRecords = (size_t)(_width / SLEEP_TILE_SIZE) * _height;
+        _tileFlags = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned char>("tileFlags", tileRecords));
+        _tileAwake = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("tileAwake", tileRecords));
+        _tileSleep = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned int>("tileSleep", tileRecords));
+        _matterSums = std::make_shared<GPGPU::HostParameter>(_computer->createArrayOutputAll<int>("matterSums", tileRecords));
+
+        _packedCells = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned short>("packedCells", _totalCells));
+        _packedTile = std::make_shared<GPGPU::HostParameter>(_computer->createLocalArray<unsigned short>("packedTile", (PACKED_TILE_SIZE + 2) * (PACKED_TILE_SIZE + 2)));
+
+        // at least 1 wall column per row, 1 border row above and below
+        _paddedPitch = ((_width + 1 + PADDED_ROW_ALIGNMENT - 1) / PADDED_ROW_ALIGNMENT) * PADDED_ROW_ALIGNMENT;
+        const size_t paddedCells = (size_t)_paddedPitch * (_height + 2);
+        _paddedState = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned char>("paddedState", paddedCells));
+        _paddedTargetSource = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("paddedTargetSource", paddedCells));
+        _paddedTargetSource2 = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned char>("paddedTargetSource2", paddedCells));
+
+        // seeds restart with no steps slept
         _parametersRandomInit = std::make_shared<GPGPU::HostParameter>(
-            _randomSeedIn->next(*_randomSeedState)
+            _randomSeedIn->next(_randomSeedState->current()).next(*_tileSleep)
         );
 
-        _parameterGuess1 = std::make_shared<GPGPU::HostParameter>(
-            _areaState->next(*_randomSeedState).next(*_areaTargetSource).next(*_areaPressureIn)
-        );
-        _parameterGuess2 = std::make_shared<GPGPU::HostParameter>(
-            _areaTargetSource->next(*_areaTargetSource2).next(*_randomSeedState)
+        // 32 cells per word in each row, padded to multiple of work-group size
+        _bitWords = ((_width + 31) / 32) * _height;
+        _bitWords = ((_bitWords + 255) / 256) * 256;
+        _bitState = std::make_shared<GPGPU::DoubleBuffer>(_computer->createArrayStateDoubleBuffer<unsigned int>("bitState", _bitWords));
+        _bitRandomSeedState = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned int>("bitRandomSeedState", _bitWords));
+        // 4 planes (1 per direction)
+        _bitProposals = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned int>("bitProposals", _bitWords * 4));
+        _bitAccepts = std::make_shared<GPGPU::HostParameter>(_computer->createArrayState<unsigned int>("bitAccepts", _bitWords * 4));
+
+        _parametersBitRandomInit = std::make_shared<GPGPU::HostParameter>(
+            _randomSeedIn->next(*_bitRandomSeedState)
         );
 
-        _parameterSandMove = std::make_shared<GPGPU::HostParameter>(
-            _areaTargetSource->next(*_areaTargetSource2).next(*_areaState).next(*_areaState2)
-        );
-      
-        _parameterAreaInput = std::make_shared<GPGPU::HostParameter>(
-            _areaIn->next(*_areaState)
-        );
-        _parameterAreaOutput = std::make_shared<GPGPU::HostParameter>(
-            _areaOut->next(*_areaState2)
-        );
-        _parameterAreaState = std::make_shared<GPGPU::HostParameter>(
-            _areaState->next(*_areaState2)
-        );
+        // each device computes a strip of rows (multiple of temporal blocking tile size), halo rows are set per simulation mode
+        _computer->setStrips(_height, TEMPORAL_BLOCKING_TILE_SIZE);
+        const size_t bitWordsPerRow = (_width + 31) / 32;
+        for (auto& name : { "areaState", "areaState2", "areaTargetSource", "areaTargetSource2", "areaPressureIn", "areaPressureOut", "areaOut", "packedCells", "packedCells2" })
+            _computer->setParameterStrips(name, _width, 0);
+        if (!_counterRandom)
+        {
+            for (auto& name : { "randomSeedState", "randomSeedState2" })
+                _computer->setParameterStrips(name, _width, 0);
+        }
+        for (auto& name : { "bitState", "bitState2", "bitRandomSeedState" })
+            _computer->setParameterStrips(name, bitWordsPerRow, 0);
+        _computer->setParameterStrips("bitProposals", bitWordsPerRow, 0, 4);
+        _computer->setParameterStrips("bitAccepts", bitWordsPerRow, 0, 4);
+        // flags of tiles above and below are 1 tile (16 rows) away
+        for (auto& name : { "tileFlags", "tileFlags2" })
+            _computer->setParameterStrips(name, _width / SLEEP_TILE_SIZE, SLEEP_TILE_SIZE);
+        for (auto& name : { "tileAwake", "tileSleep", "matterSums" })
+            _computer->setParameterStrips(name, _width / SLEEP_TILE_SIZE, 0);
+        _computer->setParameterStrips("frameOut", _width * 3, 0);
+        // first row of padded buffers is after the border row
+        for (auto& name : { "paddedState", "paddedState2", "paddedTargetSource", "paddedTargetSource2" })
+            _computer->setParameterStrips(name, _paddedPitch, 0, 1, _paddedPitch);
 
 
         _defineMacros = std::string("#define PLAY_AREA_WIDTH ") + std::to_string(_width) + R"(
@@ -107,7 +541,19 @@ public:
         )";
         _defineMacros += std::string("#define PLAY_AREA_TOTAL_CELLS ") + std::to_string(_totalCells) + R"(
         )";
+        _defineMacros += std::string("#define PLAY_AREA_PADDED_PITCH ") + std::to_string(_paddedPitch) + R"(
+        )";
+
+        _defineMacros += std::string("#define BRUSH_CAPACITY ") + std::to_string(BRUSH_CAPACITY) + R"(
+        )";
+        _defineMacros += std::string("#define BRUSH_RECORD_INTS ") + std::to_string(BRUSH_RECORD_INTS) + R"(
+        )";
+        _defineMacros += std::string("#define BRUSH_SHAPE_CIRCLE ") + std::to_string(BRUSH_SHAPE_CIRCLE) + R"(
+        )";
 
+        if (_counterRandom)
+            _defineMacros += std::string("#define PLAY_AREA_COUNTER_RANDOM 1") + R"(
+        )";
         _defineMacros += std::string("#define PLAY_AREA_QUANTUM_STRENGTH ") + std::to_string(_quantumStrength) + R"(
         )";
 
@@ -133,218 +579,176 @@ public:
 			    return seed;
 		    }
 
-            const float randomFloat(unsigned int * seed)
+            const bool brushCovers(const global int * brush, const int x, const int y)
             {
-                unsigned int newSeed = rnd(*seed);
-                *seed = newSeed;                
-                return newSeed * UIMAXFLOATINV;
+                const int dx = x - brush[0];
+                const int dy = y - brush[1];
+                const int radius = brush[2];
+                if(abs(dx) > radius || abs(dy) > radius)
+                    return false;
+                if(brush[3] == BRUSH_SHAPE_CIRCLE && dx * dx + dy * dy > radius * radius)
+                    return false;
+                return (rnd((x + y * PLAY_AREA_WIDTH) ^ rnd(brush[6])) & 65535) < brush[5];
             }
 
-        )";
-
-        _computer->compile(_defineMacros + R"(
-            kernel void initRandomSeed(
-                const global unsigned int * __restrict__ randomSeedIn,
-                global unsigned int * __restrict__ randomSeedState
-            )
+            const global int * brushRecord(const global int * brushEvents, const int k)
             {
-                const int id=get_global_id(0);  
-                const int N = get_global_size(0);
-                const int nLoop = 1 + ((PLAY_AREA_WIDTH * PLAY_AREA_HEIGHT)  / N);
-                for(int i=0;i<nLoop;i++)
-                {
-                    int idLoop = i * N + id%N;
-                    if(idLoop < PLAY_AREA_WIDTH * PLAY_AREA_HEIGHT)
-                        randomSeedState[idLoop]=randomSeedIn[idLoop];
-                }
+                return brushEvents + BRUSH_RECORD_INTS * (1 + (brushEvents[1] + k) % BRUSH_CAPACITY);
             }
-        )", "initRandomSeed");
 
-        _computer->compile(_defineMacros + R"(
-            kernel void areaBufInput(
-                const global unsigned char * __restrict__ areaIn,
-                global unsigned char * __restrict__ areaState
-            )
+            #define SLEEP_TILE_SIZE 16
+            #define SLEEP_TILES_X (PLAY_AREA_WIDTH / SLEEP_TILE_SIZE)
+            #define SLEEP_TILES_Y (PLAY_AREA_HEIGHT / SLEEP_TILE_SIZE)
+
+            // record of a tile is on first row of tile
+            const int tileRecord(const int tileX, const int tileY)
             {
-                const int id=get_global_id(0);  
-                areaState[id]=areaIn[id];
+                return tileX + tileY * SLEEP_TILE_SIZE * SLEEP_TILES_X;
             }
-        )", "areaBufInput");
 
-        _computer->compile(_defineMacros + R"(
-            kernel void areaBufOutput(
-                global unsigned char * __restrict__ areaOut,
-                const global unsigned char * __restrict__ areaState2
-            )
+            const int tileRecordOfCell(const int x, const int y)
             {
-                const int id=get_global_id(0);  
-                areaOut[id]=areaState2[id];
+                return tileRecord(x / SLEEP_TILE_SIZE, y / SLEEP_TILE_SIZE);
             }
-        )", "areaBufOutput");
 
-        _computer->compile(_defineMacros + R"(
-            kernel void areaBufState(
-                global unsigned char * __restrict__ areaState,
-                const global unsigned char * __restrict__ areaState2
-            )
+            // a tile is computed if a tile of its 3x3 neighborhood had a moving, movable or changed cell on previous step
+            const bool tileAwakeByFlags(const global unsigned char * tileFlags, const int tileX, const int tileY)
             {
-                const int id=get_global_id(0);  
-                areaState[id]=areaState2[id];
+                bool awake = false;
+                for(int y = max(tileY - 1, 0); y <= min(tileY + 1, SLEEP_TILES_Y - 1); y++)
+                    for(int x = max(tileX - 1, 0); x <= min(tileX + 1, SLEEP_TILES_X - 1); x++)
+                        awake = awake || tileFlags[tileRecord(x, y)] != 0;
+                return awake;
             }
-        )", "areaBufState");
-        
-        _computer->compile(_defineMacros + R"(
-            
 
-            // todo: weighted probabilities
-            // a side with empty cell will have more probability to be filled
-            kernel void guessParticleTarget(
-                const global unsigned char * __restrict__ areaState, 
-                global unsigned int * __restrict__ randomSeedState,
-                global unsigned char * __restrict__ areaTargetSource,
-                global unsigned char * __restrict__ areaPressureIn
-            ) 
-            { 
-                const int id=get_global_id(0); 
-                const int x = id % PLAY_AREA_WIDTH;
-                const int y = id / PLAY_AREA_WIDTH;
-                unsigned int randomSeed = randomSeedState[id];
-                
-                const int matter = areaState[id];
+            // Philox2x32-10 of counters (cell, step) and key (phase: 0 = guess, 1 = pick), used as seed of randomFloat
+            // without per-cell seeds, a random number depends only on where and when it is used
+            unsigned int counterSeed(const unsigned int cell, const unsigned int step, const unsigned int phase)
+            {
+                unsigned int counter0 = cell;
+                unsigned int counter1 = step;
+                unsigned int key = phase;
+                for(int round = 0; round < 10; round++)
+                {
+                    const unsigned int high = mul_hi(counter0, 0xD256D193u);
+                    const unsigned int low = counter0 * 0xD256D193u;
+                    counter0 = high ^ key ^ counter1;
+                    counter1 = low;
+                    key += 0x9E3779B9u;
+                }
+                return counter0;
+            }
 
-                const int topIdY = (y==0?y:y-1);
-                const int topIdX = x;
-                const int rightIdY = y;
-                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
-                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
-                const int botIdX = x;
-                const int leftIdY = y;
-                const int leftIdX = (x==0 ? x:x-1);
+            // seed of a per-cell kernel: seed buffer argument or step number argument
+            #ifdef PLAY_AREA_COUNTER_RANDOM
+                #define RANDOM_SEED_PARAMETER const unsigned int randomStep
+                #define LOAD_RANDOM_SEED(id, phase) counterSeed(id, randomStep, phase)
+                #define STORE_RANDOM_SEED(id, seed)
+            #else
+                #define RANDOM_SEED_PARAMETER global unsigned int * __restrict__ randomSeedState
+                #define LOAD_RANDOM_SEED(id, phase) randomSeedState[id]
+                #define STORE_RANDOM_SEED(id, seed) randomSeedState[id] = (seed)
+            #endif
 
-                const int top = areaState[topIdX + topIdY * PLAY_AREA_WIDTH];
-                const int right = areaState[rightIdX + rightIdY * PLAY_AREA_WIDTH];
-                const int bot = areaState[botIdX + botIdY * PLAY_AREA_WIDTH];
-                const int left = areaState[leftIdX + leftIdY * PLAY_AREA_WIDTH];
+            const float randomFloat(unsigned int * seed)
+            {
+                unsigned int newSeed = rnd(*seed);
+                *seed = newSeed;                
+                return newSeed * UIMAXFLOATINV;
+            }
 
-                // quantum-mechenical pressure solver
-                // a particle can go only 4 places
-                // having more particles on target pos lowers the probability for there
-                // then particle picks a pos to go, marks its id (does not move yet because parallel update will be done)
-                // todo: weighted probabilities
-           
-              
+            // per-cell rules of a simulation step
+            // used by both the separate kernels and the fused step kernel so that both produce identical results
+            // hasTop, hasRight, hasBot, hasLeft: neighbor is inside the play area (values of outside neighbors are ignored)
+
+            // quantum-mechenical pressure solver
+            // a particle can go only 4 places
+            // having more particles on target pos lowers the probability for there
+            // then particle picks a pos to go, marks its id (does not move yet because parallel update will be done)
+            // returns 1 = goes top, 2 = goes right, 4 = goes bottom, 8 = goes left, 0 = stays
+            // seed is updated only if a target is picked
+            unsigned char guessParticleTargetOfCell(
+                const int matter, const int top, const int right, const int bot, const int left,
+                const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft,
+                unsigned int * seed
+            )
+            {
+                unsigned int randomSeed = *seed;
                 int totProb = 0;
                 int tot = 0;
-                // check where can 1 matter go
 
-             
-                if(matter == 1 && top == 0 && topIdY != y)
+                // check where can 1 matter go
+                if(matter == 1 && top == 0 && hasTop)
                 {
                     totProb+=PLAY_AREA_TEST_UP_PROB;
                 }
-                if(matter == 1 && right == 0 && rightIdX != x)
+                if(matter == 1 && right == 0 && hasRight)
                 {
                     totProb+=PLAY_AREA_TEST_RIGHT_PROB;
                 }
-                if(matter == 1 && bot == 0 && botIdY != y)
+                if(matter == 1 && bot == 0 && hasBot)
                 {
                     totProb+=PLAY_AREA_TEST_BOT_PROB;
                 }
-                if(matter == 1 && left == 0 && leftIdX != x)
+                if(matter == 1 && left == 0 && hasLeft)
                 {
                     totProb+=PLAY_AREA_TEST_LEFT_PROB;
-                }                
-
-                
+                }
 
                 const int selected = floor(randomFloat(&randomSeed) * totProb);
 
-
-                // check where can 1 matter go               
-                if(matter == 1 && top == 0 && topIdY != y)
+                if(matter == 1 && top == 0 && hasTop)
                 {
                     tot+=PLAY_AREA_TEST_UP_PROB;
                     if(selected<tot)
                     {
-                        areaTargetSource[id]=1;
-                        randomSeedState[id]=randomSeed;
-                        return;
+                        *seed = randomSeed;
+                        return 1;
                     }
                 }
 
-                if(matter == 1 && right == 0 && rightIdX != x)
+                if(matter == 1 && right == 0 && hasRight)
                 {
                     tot+=PLAY_AREA_TEST_RIGHT_PROB;
                     if(selected<tot)
                     {
-                        areaTargetSource[id]=2;
-                        randomSeedState[id]=randomSeed;
-                        return;
+                        *seed = randomSeed;
+                        return 2;
                     }
                 }
 
-                if(matter == 1 && bot == 0 && botIdY != y)
+                if(matter == 1 && bot == 0 && hasBot)
                 {
                     tot+=PLAY_AREA_TEST_BOT_PROB;
                     if(selected<tot)
                     {
-                        areaTargetSource[id]=4;
-                        randomSeedState[id]=randomSeed;
-                        return;
+                        *seed = randomSeed;
+                        return 4;
                     }
                 }
 
-                if(matter == 1 && left == 0 && leftIdX != x)
+                if(matter == 1 && left == 0 && hasLeft)
                 {
                     tot+=PLAY_AREA_TEST_LEFT_PROB;
                     if(selected<tot)
                     {
-                        areaTargetSource[id]=8;
-                        randomSeedState[id]=randomSeed;
-                        return;
+                        *seed = randomSeed;
+                        return 8;
                     }
                 }
+                return 0;
+            }
 
-              
-
-                // 1 = goes top, 2 = goes right, 4 = goes bottom, 8 = goes left, 
-                         
-                areaTargetSource[id]=0;
-            })", "guessParticleTarget");
-
-
-        // picks 1 of multiple cells that want to send matter
-        _computer->compile(_defineMacros + R"(
-            kernel void pickOneTargetGuess(
-                const global unsigned char * __restrict__ areaTargetSource,
-                global unsigned char * __restrict__ areaTargetSource2,
-                global unsigned int * __restrict__ randomSeedState
+            // picks one of neighbors that send matter to this cell, by probability
+            // top, right, bot, left: targets guessed by neighbors
+            // returns 1 = takes from top, 2 = from right, 4 = from bottom, 8 = from left, 0 = takes nothing
+            // seed is always updated
+            unsigned char pickOneTargetGuessOfCell(
+                const int top, const int right, const int bot, const int left,
+                const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft,
+                unsigned int * seed
             )
             {
-                const int id=get_global_id(0);  
-                const int x = id%PLAY_AREA_WIDTH;
-                const int y = id/PLAY_AREA_WIDTH;
-                unsigned int randomSeed = randomSeedState[id];
-
-                const int topIdY = (y==0?y:y-1);
-                const int topIdX = x;
-                const int rightIdY = y;
-                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
-                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
-                const int botIdX = x;
-                const int leftIdY = y;
-                const int leftIdX = (x==0 ? x:x-1);
-                
-
-                const unsigned char tsCenter = areaTargetSource[id];
-
-                const int top = areaTargetSource[topIdX + topIdY * PLAY_AREA_WIDTH];
-                const int right = areaTargetSource[rightIdX + rightIdY * PLAY_AREA_WIDTH];
-                const int bot = areaTargetSource[botIdX + botIdY * PLAY_AREA_WIDTH];
-                const int left = areaTargetSource[leftIdX + leftIdY * PLAY_AREA_WIDTH];
-
-                // picks one of neighbors that send matter to this cell
-                // by probability
                 // gas: all neighbors
                 // liquid: left right bottom bottom-left bottom-right
                 // solid: bottom-left bottom bottom-right
@@ -352,318 +756,1887 @@ public:
                 int tot = 0;
 
                 // more probability for top to down because of gravity
-                if(topIdY != y)
+                if(hasTop)
                 {
                     if(top == 4)
                         totProb +=PLAY_AREA_TEST_BOT_PROB;
                 }
 
-                if(rightIdX != x)
+                if(hasRight)
                 {
                     if(right == 8)
                         totProb +=PLAY_AREA_TEST_LEFT_PROB;
                 }
 
-                if(botIdY != y)
+                if(hasBot)
                 {
                     if(bot == 1)
                         totProb +=PLAY_AREA_TEST_UP_PROB;
                 }
 
-                if(leftIdX != x)
+                if(hasLeft)
                 {
                     if(left == 2)
                         totProb +=PLAY_AREA_TEST_RIGHT_PROB;
                 }
 
-                const int selected = floor(randomFloat(&randomSeed) * totProb);
-                randomSeedState[id]=randomSeed;
+                const int selected = floor(randomFloat(seed) * totProb);
 
-                if(topIdY != y)
+                if(hasTop)
                 {
                     if(top == 4)
                         tot +=PLAY_AREA_TEST_BOT_PROB;
 
                     if(selected<tot)
-                    {
-                        areaTargetSource2[id]=1;
-                        randomSeedState[id]=randomSeed;
-                        return;
-                    }
+                        return 1;
                 }
 
-                if(rightIdX != x)
+                if(hasRight)
                 {
                     if(right == 8)
                         tot +=PLAY_AREA_TEST_LEFT_PROB;
 
                     if(selected<tot)
-                    {
-                        areaTargetSource2[id]=2;
-                        randomSeedState[id]=randomSeed;
-                        return;
-                    }
+                        return 2;
                 }
 
-                if(botIdY != y)
+                if(hasBot)
                 {
                     if(bot == 1)
                         tot +=PLAY_AREA_TEST_UP_PROB;
 
                     if(selected<tot)
-                    {
-                        areaTargetSource2[id]=4;
-                        randomSeedState[id]=randomSeed;
-                        return;
-                    }
+                        return 4;
                 }
 
-                if(leftIdX != x)
+                if(hasLeft)
                 {
                     if(left == 2)
                         tot +=PLAY_AREA_TEST_RIGHT_PROB;
 
                     if(selected<tot)
-                    {
-                        areaTargetSource2[id]=8;
-                        randomSeedState[id]=randomSeed;
-                        return;
-                    }
-                }             
-                areaTargetSource2[id]=0;
+                        return 8;
+                }
+                return 0;
             }
-        )", "pickOneTargetGuess");
-
-
-
 
-        // picks 1 of multiple cells that want to send matter
-        _computer->compile(_defineMacros + R"(
-            kernel void moveSand(
-                const global unsigned char * __restrict__ areaTargetSource,
-                const global unsigned char * __restrict__ areaTargetSource2,
-                const global unsigned char * __restrict__ areaState,
-                global unsigned char * __restrict__ areaState2
+            // returns new matter of cell after accepted movements
+            // target*: guessed targets (of neighbors and center), source*: picked sources (of neighbors and center)
+            unsigned char moveSandOfCell(
+                const int center, const int targetCenter, const int sourceCenter,
+                const int targetTop, const int targetRight, const int targetBot, const int targetLeft,
+                const int sourceTop, const int sourceRight, const int sourceBot, const int sourceLeft,
+                const bool hasTop, const bool hasRight, const bool hasBot, const bool hasLeft
             )
             {
-                const int id=get_global_id(0);  
-                const int x = id%PLAY_AREA_WIDTH;
-                const int y = id/PLAY_AREA_WIDTH;
-
-
-                const int topIdY = (y==0?y:y-1);
-                const int topIdX = x;
-                const int rightIdY = y;
-                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
-                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
-                const int botIdX = x;
-                const int leftIdY = y;
-                const int leftIdX = (x==0 ? x:x-1);
-                
-
-         
-                const int center = areaState[id];
                 // if empty, check the accepted movement data
                 if(center == 0)
-                {                    
-                    const int tsCenter = areaTargetSource2[id];
-
-                    const int top = areaTargetSource[topIdX + topIdY * PLAY_AREA_WIDTH];
-                    const int right = areaTargetSource[rightIdX + rightIdY * PLAY_AREA_WIDTH];
-                    const int bot = areaTargetSource[botIdX + botIdY * PLAY_AREA_WIDTH];
-                    const int left = areaTargetSource[leftIdX + leftIdY * PLAY_AREA_WIDTH];
-
+                {
                     // if top cell wants to send down 1 matter and current cell want to receive 1 matter, it is ok
-                    if(top == 4 && tsCenter == 1 && topIdY != y)
-                    {
-                        areaState2[id] = 1;
-                        return;
-                    }
+                    if(targetTop == 4 && sourceCenter == 1 && hasTop)
+                        return 1;
 
                     // if right cell sends to left, current cell receives from right
-                    if(right == 8 &&  tsCenter == 2 && rightIdX != x)
-                    {
-                        areaState2[id] = 1;
-                        return;
-                    }
+                    if(targetRight == 8 && sourceCenter == 2 && hasRight)
+                        return 1;
 
                     // if bottom cell sends up, current cell receives
-                    if(bot == 1 &&  tsCenter == 4 && botIdY != y)
-                    {
-                        areaState2[id] = 1;
-                        return;
-                    }
+                    if(targetBot == 1 && sourceCenter == 4 && hasBot)
+                        return 1;
 
-                    // if bottom cell sends up, current cell receives
-                    if(left == 2 &&  tsCenter == 8 && leftIdX != x)
-                    {
-                        areaState2[id] = 1;
-                        return;
-                    }
+                    // if left cell sends to right, current cell receives
+                    if(targetLeft == 2 && sourceCenter == 8 && hasLeft)
+                        return 1;
                 }
-                else    // if not empty, check if can send (areaTargetSourceIn2 is for knowing who takes)
+                else    // if not empty, check if can send (source is for knowing who takes)
                 {
-                    const int tsCenter = areaTargetSource[id];
-
-                    const int top = areaTargetSource2[topIdX + topIdY * PLAY_AREA_WIDTH];
-                    const int right = areaTargetSource2[rightIdX + rightIdY * PLAY_AREA_WIDTH];
-                    const int bot = areaTargetSource2[botIdX + botIdY * PLAY_AREA_WIDTH];
-                    const int left = areaTargetSource2[leftIdX + leftIdY * PLAY_AREA_WIDTH];
-
-                    // if top cell wants to receive
-                    if(top == 4 && tsCenter == 1 && topIdY != y)
-                    {
-                        areaState2[id] = 0;
-                        return;
-                    }
+                    // if top cell receives
+                    if(sourceTop == 4 && targetCenter == 1 && hasTop)
+                        return 0;
 
                     // if right cell receives
-                    if(right == 8 && tsCenter == 2 && rightIdX != x)
-                    {
-                        areaState2[id] = 0;
-                        return;
-                    }
+                    if(sourceRight == 8 && targetCenter == 2 && hasRight)
+                        return 0;
 
                     // if bottom cell receives
-                    if(bot == 1 && tsCenter == 4 && botIdY != y)
-                    {
-                        areaState2[id] = 0;
-                        return;
-                    }
+                    if(sourceBot == 1 && targetCenter == 4 && hasBot)
+                        return 0;
 
                     // if left cell receives
-                    if(left == 2 && tsCenter == 8 && leftIdX != x)
-                    {
-                        areaState2[id] = 0;
-                        return;
-                    }    
+                    if(sourceLeft == 2 && targetCenter == 8 && hasLeft)
+                        return 0;
                 }
-                areaState2[id]=center;
+                return center;
             }
-        )", "moveSand");
-        Reset();
-        PrepareGpuParameterList();
-
-    }
-    
-    void Reset()
-    {
-        
-        for (int i = 0; i < _width * _height; i++)
-        {
-            _areaIn->access<unsigned char>(i) = 0;
-            _randomSeedIn->access<unsigned int>(i) = i;
-        }
-        _computer->compute(*_parametersRandomInit, "initRandomSeed", 0, _totalCells, 256);
-    }
-
-    void Calc()
-    {
-        {
-            GPGPU::Bench bench(&_frameTime);
-            CalcFallingSand();            
-        }
-    } 
 
+        )";
 
-    void PrepareGpuParameterList()
-    {
-        for (int i = 0; i < _numComputePerFrame; i++)
-        {
-            _listPrm.push_back(*_parameterGuess1);
-            _listPrm.push_back(*_parameterGuess2);
-            _listPrm.push_back(*_parameterSandMove);
-            _listPrm.push_back(*_parameterAreaState);
-            _listKernel.push_back("guessParticleTarget");
-            _listKernel.push_back("pickOneTargetGuess");
-            _listKernel.push_back("moveSand");
-            _listKernel.push_back("areaBufState");
-        }
-    }
-    void CalcFallingSand()
-    {
-        _computer->compute(*_parameterAreaInput, "areaBufInput", 0, _totalCells, 256);
+        // all kernels are compiled as 1 program per device (macros and helper functions are compiled once)
+        std::string programCode;
+        std::vector<std::string> kernelNames;
+        programCode += R"(
+            kernel void initRandomSeed(
+                const global unsigned int * __restrict__ randomSeedIn,
+                global unsigned int * __restrict__ randomSeedState,
+                global unsigned int * __restrict__ tileSleep
+            )
+            {
+                const int id=get_global_id(0);  
+                if(id < PLAY_AREA_TOTAL_CELLS)
+                {
+                    randomSeedState[id]=randomSeedIn[id];
+                    const int x = id % PLAY_AREA_WIDTH;
+                    const int y = id / PLAY_AREA_WIDTH;
+                    if(x % SLEEP_TILE_SIZE == 0 && y % SLEEP_TILE_SIZE == 0)
+                        tileSleep[tileRecordOfCell(x, y)] = 0;
+                }
+            }
+        )";
+        kernelNames.push_back("initRandomSeed");
 
-         // runs many repeatations of a kernel sequence
-         _computer->computeMultiple(_listPrm, _listKernel, 0, _totalCells, 256);
+        programCode += R"(
+            // all tiles wake up
+            kernel void areaBufInput(
+                const global unsigned char * __restrict__ areaIn,
+                global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ tileFlags
+            )
+            {
+                const int id=get_global_id(0);  
+                areaState[id]=areaIn[id];
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                if(x % SLEEP_TILE_SIZE == 0 && y % SLEEP_TILE_SIZE == 0)
+                    tileFlags[tileRecordOfCell(x, y)] = 1;
+            }
+        )";
+        kernelNames.push_back("areaBufInput");
+
+        programCode += R"(
+            kernel void areaBufOutput(
+                global unsigned char * __restrict__ areaOut,
+                const global unsigned char * __restrict__ areaState
+            )
+            {
+                const int id=get_global_id(0);  
+                areaOut[id]=areaState[id];
+            }
+        )";
+        kernelNames.push_back("areaBufOutput");
+
+        // stamps pending brushes in order (later brushes overwrite earlier ones), tiles of stamped cells wake up
+        programCode += R"(
+            kernel void applyBrushEvents(
+                const global int * __restrict__ brushEvents,
+                global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ tileFlags
+            )
+            {
+                const int id=get_global_id(0);
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                const int count = brushEvents[0];
+                int matter = -1;
+                for(int k=0; k<count; k++)
+                {
+                    const global int * brush = brushRecord(brushEvents, k);
+                    if(brushCovers(brush, x, y))
+                        matter = brush[4];
+                }
+                if(matter >= 0)
+                {
+                    areaState[id] = matter;
+                    tileFlags[tileRecordOfCell(x, y)] = 1;
+                }
+            }
+        )";
+        kernelNames.push_back("applyBrushEvents");
+
+        programCode += R"(
+            // todo: weighted probabilities
+            // a side with empty cell will have more probability to be filled
+            kernel void guessParticleTarget(
+                const global unsigned char * __restrict__ areaState, 
+                RANDOM_SEED_PARAMETER,
+                global unsigned char * __restrict__ areaTargetSource,
+                global unsigned char * __restrict__ areaPressureIn
+            ) 
+            { 
+                const int id=get_global_id(0); 
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 0);
+
+                const int topIdY = (y==0?y:y-1);
+                const int topIdX = x;
+                const int rightIdY = y;
+                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
+                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
+                const int botIdX = x;
+                const int leftIdY = y;
+                const int leftIdX = (x==0 ? x:x-1);
+
+                const int top = areaState[topIdX + topIdY * PLAY_AREA_WIDTH];
+                const int right = areaState[rightIdX + rightIdY * PLAY_AREA_WIDTH];
+                const int bot = areaState[botIdX + botIdY * PLAY_AREA_WIDTH];
+                const int left = areaState[leftIdX + leftIdY * PLAY_AREA_WIDTH];
+
+                // 1 = goes top, 2 = goes right, 4 = goes bottom, 8 = goes left, 
+                const unsigned char target = guessParticleTargetOfCell(
+                    areaState[id], top, right, bot, left,
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x,
+                    &randomSeed
+                );
+                if(target != 0)
+                    STORE_RANDOM_SEED(id, randomSeed);
+                areaTargetSource[id]=target;
+            })";
+        kernelNames.push_back("guessParticleTarget");
+
+
+        // picks 1 of multiple cells that want to send matter
+        programCode += R"(
+            kernel void pickOneTargetGuess(
+                const global unsigned char * __restrict__ areaTargetSource,
+                global unsigned char * __restrict__ areaTargetSource2,
+                RANDOM_SEED_PARAMETER
+            )
+            {
+                const int id=get_global_id(0);  
+                const int x = id%PLAY_AREA_WIDTH;
+                const int y = id/PLAY_AREA_WIDTH;
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 1);
+
+                const int topIdY = (y==0?y:y-1);
+                const int topIdX = x;
+                const int rightIdY = y;
+                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
+                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
+                const int botIdX = x;
+                const int leftIdY = y;
+                const int leftIdX = (x==0 ? x:x-1);
+
+                const int top = areaTargetSource[topIdX + topIdY * PLAY_AREA_WIDTH];
+                const int right = areaTargetSource[rightIdX + rightIdY * PLAY_AREA_WIDTH];
+                const int bot = areaTargetSource[botIdX + botIdY * PLAY_AREA_WIDTH];
+                const int left = areaTargetSource[leftIdX + leftIdY * PLAY_AREA_WIDTH];
+
+                areaTargetSource2[id] = pickOneTargetGuessOfCell(
+                    top, right, bot, left,
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x,
+                    &randomSeed
+                );
+                STORE_RANDOM_SEED(id, randomSeed);
+            }
+        )";
+        kernelNames.push_back("pickOneTargetGuess");
+
+
+
+
+        // moves matter only if both sides accepted the movement
+        programCode += R"(
+            kernel void moveSand(
+                const global unsigned char * __restrict__ areaTargetSource,
+                const global unsigned char * __restrict__ areaTargetSource2,
+                const global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ areaState2
+            )
+            {
+                const int id=get_global_id(0);  
+                const int x = id%PLAY_AREA_WIDTH;
+                const int y = id/PLAY_AREA_WIDTH;
+
+
+                const int topIdY = (y==0?y:y-1);
+                const int topIdX = x;
+                const int rightIdY = y;
+                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);
+                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);
+                const int botIdX = x;
+                const int leftIdY = y;
+                const int leftIdX = (x==0 ? x:x-1);
+
+                const int topId = topIdX + topIdY * PLAY_AREA_WIDTH;
+                const int rightId = rightIdX + rightIdY * PLAY_AREA_WIDTH;
+                const int botId = botIdX + botIdY * PLAY_AREA_WIDTH;
+                const int leftId = leftIdX + leftIdY * PLAY_AREA_WIDTH;
+
+                // empty cell checks targets of neighbors, non-empty cell checks sources of neighbors (only 1 of them is read)
+                const int center = areaState[id];
+                const global unsigned char * neighbor = (center == 0 ? areaTargetSource : areaTargetSource2);
+                const int top = neighbor[topId];
+                const int right = neighbor[rightId];
+                const int bot = neighbor[botId];
+                const int left = neighbor[leftId];
+
+                areaState2[id] = moveSandOfCell(
+                    center, areaTargetSource[id], areaTargetSource2[id],
+                    top, right, bot, left,
+                    top, right, bot, left,
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x
+                );
+            }
+        )";
+        kernelNames.push_back("moveSand");
+
+        // packed records: matter, guessed target and picked source of a cell are in 1 word, so each neighbor is 1 load in each kernel
+        // bits 0-7: matter, bits 8-11: target, bits 12-15: source
+        // guess reads packedCells and writes packedCells2, pick reads packedCells2 and writes packedCells, move reads packedCells and writes packedCells2
+        programCode += R"(
+            #define PACKED_MATTER(cell) ((cell) & 255)
+            #define PACKED_TARGET(cell) (((cell) >> 8) & 15)
+            #define PACKED_SOURCE(cell) ((cell) >> 12)
+
+            kernel void packedAreaBufInput(
+                const global unsigned char * __restrict__ areaIn,
+                global unsigned short * __restrict__ packedCells
+            )
+            {
+                const int id=get_global_id(0);
+                packedCells[id]=areaIn[id];
+            }
+
+            kernel void packedAreaBufOutput(
+                global unsigned char * __restrict__ areaOut,
+                const global unsigned short * __restrict__ packedCells
+            )
+            {
+                const int id=get_global_id(0);
+                areaOut[id]=PACKED_MATTER(packedCells[id]);
+            }
+
+            kernel void packedApplyBrushEvents(
+                const global int * __restrict__ brushEvents,
+                global unsigned short * __restrict__ packedCells
+            )
+            {
+                const int id=get_global_id(0);
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                const int count = brushEvents[0];
+                int matter = -1;
+                for(int k=0; k<count; k++)
+                {
+                    const global int * brush = brushRecord(brushEvents, k);
+                    if(brushCovers(brush, x, y))
+                        matter = brush[4];
+                }
+                if(matter >= 0)
+                    packedCells[id] = matter;
+            }
+
+            // 2D launch: work-group stages its records with a 1-cell ring (clamped to play area) in a tile of local memory (tile argument)
+            // neighbors are read from the tile, so each record is loaded from global memory once per work-group instead of up to 5 times
+            #define PACKED_TILE_CELL(cells)                                                     \
+                const int x = get_global_id(0);                                                 \
+                const int y = get_global_id(1);                                                 \
+                const int id = x + y * PLAY_AREA_WIDTH;                                         \
+                const int pitch = get_local_size(0) + 2;                                        \
+                const int t = get_local_id(0) + 1 + (get_local_id(1) + 1) * pitch;              \
+                loadPackedTile(cells, tile, pitch);                                             \
+                const bool hasTop = (y > 0);                                                    \
+                const bool hasRight = (x < PLAY_AREA_WIDTH - 1);                                \
+                const bool hasBot = (y < PLAY_AREA_HEIGHT - 1);                                 \
+                const bool hasLeft = (x > 0);
+
+            void loadPackedTile(const global unsigned short * __restrict__ cells, __local unsigned short * tile, const int pitch)
+            {
+                const int originX = get_global_id(0) - get_local_id(0) - 1;
+                const int originY = get_global_id(1) - get_local_id(1) - 1;
+                const int rows = get_local_size(1) + 2;
+                for(int j = get_local_id(1); j < rows; j += get_local_size(1))
+                {
+                    const int y = clamp(originY + j, 0, PLAY_AREA_HEIGHT - 1);
+                    for(int i = get_local_id(0); i < pitch; i += get_local_size(0))
+                        tile[i + j * pitch] = cells[clamp(originX + i, 0, PLAY_AREA_WIDTH - 1) + y * PLAY_AREA_WIDTH];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+            kernel void packedGuessParticleTarget(
+                const global unsigned short * __restrict__ packedCells,
+                RANDOM_SEED_PARAMETER,
+                global unsigned short * __restrict__ packedCells2,
+                __local unsigned short * tile
+            )
+            {
+                PACKED_TILE_CELL(packedCells)
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 0);
+                const int matter = PACKED_MATTER(tile[t]);
+                const unsigned char target = guessParticleTargetOfCell(
+                    matter, PACKED_MATTER(tile[t - pitch]), PACKED_MATTER(tile[t + 1]), PACKED_MATTER(tile[t + pitch]), PACKED_MATTER(tile[t - 1]),
+                    hasTop, hasRight, hasBot, hasLeft,
+                    &randomSeed
+                );
+                if(target != 0)
+                    STORE_RANDOM_SEED(id, randomSeed);
+                packedCells2[id] = matter | (target << 8);
+            }
+
+            kernel void packedPickOneTargetGuess(
+                const global unsigned short * __restrict__ packedCells2,
+                RANDOM_SEED_PARAMETER,
+                global unsigned short * __restrict__ packedCells,
+                __local unsigned short * tile
+            )
+            {
+                PACKED_TILE_CELL(packedCells2)
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 1);
+                const unsigned char source = pickOneTargetGuessOfCell(
+                    PACKED_TARGET(tile[t - pitch]), PACKED_TARGET(tile[t + 1]), PACKED_TARGET(tile[t + pitch]), PACKED_TARGET(tile[t - 1]),
+                    hasTop, hasRight, hasBot, hasLeft,
+                    &randomSeed
+                );
+                STORE_RANDOM_SEED(id, randomSeed);
+                packedCells[id] = tile[t] | (source << 12);
+            }
+
+            kernel void packedMoveSand(
+                const global unsigned short * __restrict__ packedCells,
+                global unsigned short * __restrict__ packedCells2,
+                __local unsigned short * tile
+            )
+            {
+                PACKED_TILE_CELL(packedCells)
+                const unsigned short center = tile[t];
+                const unsigned short top = tile[t - pitch];
+                const unsigned short right = tile[t + 1];
+                const unsigned short bot = tile[t + pitch];
+                const unsigned short left = tile[t - 1];
+                packedCells2[id] = moveSandOfCell(
+                    PACKED_MATTER(center), PACKED_TARGET(center), PACKED_SOURCE(center),
+                    PACKED_TARGET(top), PACKED_TARGET(right), PACKED_TARGET(bot), PACKED_TARGET(left),
+                    PACKED_SOURCE(top), PACKED_SOURCE(right), PACKED_SOURCE(bot), PACKED_SOURCE(left),
+                    hasTop, hasRight, hasBot, hasLeft
+                );
+            }
+        )";
+        kernelNames.push_back("packedAreaBufInput");
+        kernelNames.push_back("packedAreaBufOutput");
+        kernelNames.push_back("packedApplyBrushEvents");
+        kernelNames.push_back("packedGuessParticleTarget");
+        kernelNames.push_back("packedPickOneTargetGuess");
+        kernelNames.push_back("packedMoveSand");
+
+        // padded grid: cells outside of play area are walls (state PADDED_WALL, target and source 0) that are written by input and never change
+        // a wall is never empty and never guesses or picks, so neighbors are read without bound checks and results are same as separate kernels
+        programCode += R"(
+            #define PADDED_WALL 255
+            // x = -1 and x = PLAY_AREA_WIDTH are walls of padding columns, y = -1 and y = PLAY_AREA_HEIGHT are border rows
+            #define PADDED_INDEX(x, y) ((x) + ((y) + 1) * PLAY_AREA_PADDED_PITCH)
+
+            void setPaddedWall(
+                global unsigned char * __restrict__ paddedState,
+                global unsigned char * __restrict__ paddedState2,
+                global unsigned char * __restrict__ paddedTargetSource,
+                global unsigned char * __restrict__ paddedTargetSource2,
+                const int p
+            )
+            {
+                paddedState[p] = PADDED_WALL;
+                paddedState2[p] = PADDED_WALL;
+                paddedTargetSource[p] = 0;
+                paddedTargetSource2[p] = 0;
+            }
+
+            // a cell also writes walls of border rows above or below it, last cell of a row writes padding columns of the row
+            kernel void paddedAreaBufInput(
+                const global unsigned char * __restrict__ areaIn,
+                global unsigned char * __restrict__ paddedState,
+                global unsigned char * __restrict__ paddedState2,
+                global unsigned char * __restrict__ paddedTargetSource,
+                global unsigned char * __restrict__ paddedTargetSource2
+            )
+            {
+                const int id=get_global_id(0);
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                paddedState[PADDED_INDEX(x, y)]=areaIn[id];
+                for(int i = x; i < (x == PLAY_AREA_WIDTH - 1 ? PLAY_AREA_PADDED_PITCH : x + 1); i++)
+                {
+                    if(i > x)
+                        setPaddedWall(paddedState, paddedState2, paddedTargetSource, paddedTargetSource2, PADDED_INDEX(i, y));
+                    if(y == 0)
+                        setPaddedWall(paddedState, paddedState2, paddedTargetSource, paddedTargetSource2, PADDED_INDEX(i, -1));
+                    if(y == PLAY_AREA_HEIGHT - 1)
+                        setPaddedWall(paddedState, paddedState2, paddedTargetSource, paddedTargetSource2, PADDED_INDEX(i, PLAY_AREA_HEIGHT));
+                }
+            }
+
+            kernel void paddedAreaBufOutput(
+                global unsigned char * __restrict__ areaOut,
+                const global unsigned char * __restrict__ paddedState
+            )
+            {
+                const int id=get_global_id(0);
+                areaOut[id]=paddedState[PADDED_INDEX(id % PLAY_AREA_WIDTH, id / PLAY_AREA_WIDTH)];
+            }
+
+            kernel void paddedApplyBrushEvents(
+                const global int * __restrict__ brushEvents,
+                global unsigned char * __restrict__ paddedState
+            )
+            {
+                const int id=get_global_id(0);
+                const int x = id % PLAY_AREA_WIDTH;
+                const int y = id / PLAY_AREA_WIDTH;
+                const int count = brushEvents[0];
+                int matter = -1;
+                for(int k=0; k<count; k++)
+                {
+                    const global int * brush = brushRecord(brushEvents, k);
+                    if(brushCovers(brush, x, y))
+                        matter = brush[4];
+                }
+                if(matter >= 0)
+                    paddedState[PADDED_INDEX(x, y)] = matter;
+            }
+
+            // 2D launch: 1 work-item per cell, id indexes seeds (unpadded) and p indexes padded buffers
+            #define PADDED_CELL                                                                 \
+                const int x = get_global_id(0);                                                 \
+                const int y = get_global_id(1);                                                 \
+                const int id = x + y * PLAY_AREA_WIDTH;                                         \
+                const int p = PADDED_INDEX(x, y);
+
+            kernel void paddedGuessParticleTarget(
+                const global unsigned char * __restrict__ paddedState,
+                RANDOM_SEED_PARAMETER,
+                global unsigned char * __restrict__ paddedTargetSource
+            )
+            {
+                PADDED_CELL
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 0);
+                const unsigned char target = guessParticleTargetOfCell(
+                    paddedState[p], paddedState[p - PLAY_AREA_PADDED_PITCH], paddedState[p + 1], paddedState[p + PLAY_AREA_PADDED_PITCH], paddedState[p - 1],
+                    true, true, true, true,
+                    &randomSeed
+                );
+                if(target != 0)
+                    STORE_RANDOM_SEED(id, randomSeed);
+                paddedTargetSource[p] = target;
+            }
+
+            kernel void paddedPickOneTargetGuess(
+                const global unsigned char * __restrict__ paddedTargetSource,
+                global unsigned char * __restrict__ paddedTargetSource2,
+                RANDOM_SEED_PARAMETER
+            )
+            {
+                PADDED_CELL
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 1);
+                paddedTargetSource2[p] = pickOneTargetGuessOfCell(
+                    paddedTargetSource[p - PLAY_AREA_PADDED_PITCH], paddedTargetSource[p + 1], paddedTargetSource[p + PLAY_AREA_PADDED_PITCH], paddedTargetSource[p - 1],
+                    true, true, true, true,
+                    &randomSeed
+                );
+                STORE_RANDOM_SEED(id, randomSeed);
+            }
+
+            kernel void paddedMoveSand(
+                const global unsigned char * __restrict__ paddedTargetSource,
+                const global unsigned char * __restrict__ paddedTargetSource2,
+                const global unsigned char * __restrict__ paddedState,
+                global unsigned char * __restrict__ paddedState2
+            )
+            {
+                PADDED_CELL
+                // empty cell checks targets of neighbors, non-empty cell checks sources of neighbors (only 1 of them is read)
+                const int center = paddedState[p];
+                const global unsigned char * neighbor = (center == 0 ? paddedTargetSource : paddedTargetSource2);
+                const int top = neighbor[p - PLAY_AREA_PADDED_PITCH];
+                const int right = neighbor[p + 1];
+                const int bot = neighbor[p + PLAY_AREA_PADDED_PITCH];
+                const int left = neighbor[p - 1];
+                paddedState2[p] = moveSandOfCell(
+                    center, paddedTargetSource[p], paddedTargetSource2[p],
+                    top, right, bot, left,
+                    top, right, bot, left,
+                    true, true, true, true
+                );
+            }
+        )";
+        kernelNames.push_back("paddedAreaBufInput");
+        kernelNames.push_back("paddedAreaBufOutput");
+        kernelNames.push_back("paddedApplyBrushEvents");
+        kernelNames.push_back("paddedGuessParticleTarget");
+        kernelNames.push_back("paddedPickOneTargetGuess");
+        kernelNames.push_back("paddedMoveSand");
+
+        // sleeping tiles: same kernels on 1 work-group (256 threads) per 16x16 tile, work-groups of sleeping tiles return at once
+        // a sleeping tile would not change: its targets and sources stay 0, both state buffers have same values and only its seeds advance (caught up on wake)
+        // tileFlags: flags of previous step (read by guess, cleared by pick for next-next step), tileFlags2: flags of this step
+        programCode += R"(
+            #define SLEEPING_TILE_CELL                                                              \
+                const int tile = get_global_id(0) / 256;                                            \
+                const int tileX = tile % SLEEP_TILES_X;                                             \
+                const int tileY = tile / SLEEP_TILES_X;                                             \
+                const int x = tileX * SLEEP_TILE_SIZE + (get_global_id(0) % 256) % SLEEP_TILE_SIZE;  \
+                const int y = tileY * SLEEP_TILE_SIZE + (get_global_id(0) % 256) / SLEEP_TILE_SIZE;  \
+                const int id = x + y * PLAY_AREA_WIDTH;                                             \
+                const int record = tileRecord(tileX, tileY);                                        \
+                const bool leader = (get_global_id(0) % 256 == 0);                                  \
+                const int topIdY = (y==0?y:y-1);                                                    \
+                const int rightIdX = (x==PLAY_AREA_WIDTH - 1 ? x:x+1);                              \
+                const int botIdY = (y==PLAY_AREA_HEIGHT-1?y:y+1);                                   \
+                const int leftIdX = (x==0 ? x:x-1);                                                 \
+                const int topId = x + topIdY * PLAY_AREA_WIDTH;                                     \
+                const int rightId = rightIdX + y * PLAY_AREA_WIDTH;                                 \
+                const int botId = x + botIdY * PLAY_AREA_WIDTH;                                     \
+                const int leftId = leftIdX + y * PLAY_AREA_WIDTH;
+
+            kernel void sleepingGuessParticleTarget(
+                const global unsigned char * __restrict__ areaState, 
+                RANDOM_SEED_PARAMETER,
+                global unsigned char * __restrict__ areaTargetSource,
+                const global unsigned char * __restrict__ tileFlags,
+                global unsigned char * __restrict__ tileFlags2,
+                global unsigned char * __restrict__ tileAwake,
+                global unsigned int * __restrict__ tileSleep
+            )
+            {
+                SLEEPING_TILE_CELL
+                if(tileY >= SLEEP_TILES_Y)
+                    return;
+
+                if(!tileAwakeByFlags(tileFlags, tileX, tileY))
+                {
+                    if(leader)
+                    {
+                        tileAwake[record] = 0;
+                        tileSleep[record]++;
+                    }
+                    return;
+                }
+
+                // pickOneTargetGuess would have advanced seeds once per slept step (counter-based seeds do not depend on previous steps)
+                const unsigned int slept = tileSleep[record];
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 0);
+            #ifndef PLAY_AREA_COUNTER_RANDOM
+                for(unsigned int k = 0; k < slept; k++)
+                    randomSeed = rnd(randomSeed);
+            #endif
+                barrier(CLK_GLOBAL_MEM_FENCE);
+                if(leader)
+                {
+                    tileAwake[record] = 1;
+                    tileSleep[record] = 0;
+                }
+
+                const int matter = areaState[id];
+                const int top = areaState[topId];
+                const int right = areaState[rightId];
+                const int bot = areaState[botId];
+                const int left = areaState[leftId];
+                const unsigned char target = guessParticleTargetOfCell(
+                    matter, top, right, bot, left,
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x,
+                    &randomSeed
+                );
+                if(target != 0 || slept > 0)
+                    STORE_RANDOM_SEED(id, randomSeed);
+                areaTargetSource[id]=target;
+
+                // a cell that moves or could move keeps its tile and neighbor tiles awake on next step
+                if(matter == 1 && ((top == 0 && topIdY != y) || (right == 0 && rightIdX != x) || (bot == 0 && botIdY != y) || (left == 0 && leftIdX != x)))
+                    tileFlags2[record] = 1;
+            }
+
+            kernel void sleepingPickOneTargetGuess(
+                const global unsigned char * __restrict__ areaTargetSource,
+                global unsigned char * __restrict__ areaTargetSource2,
+                RANDOM_SEED_PARAMETER,
+                global unsigned char * __restrict__ tileFlags,
+                const global unsigned char * __restrict__ tileAwake
+            )
+            {
+                SLEEPING_TILE_CELL
+                if(tileY >= SLEEP_TILES_Y || tileAwake[record] == 0)
+                    return;
+
+                // flags of previous step are not read anymore, they become flags of next step
+                if(leader)
+                    tileFlags[record] = 0;
+
+                unsigned int randomSeed = LOAD_RANDOM_SEED(id, 1);
+                areaTargetSource2[id] = pickOneTargetGuessOfCell(
+                    areaTargetSource[topId], areaTargetSource[rightId], areaTargetSource[botId], areaTargetSource[leftId],
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x,
+                    &randomSeed
+                );
+                STORE_RANDOM_SEED(id, randomSeed);
+            }
+
+            kernel void sleepingMoveSand(
+                const global unsigned char * __restrict__ areaTargetSource,
+                const global unsigned char * __restrict__ areaTargetSource2,
+                const global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ areaState2,
+                global unsigned char * __restrict__ tileFlags2,
+                const global unsigned char * __restrict__ tileAwake
+            )
+            {
+                SLEEPING_TILE_CELL
+                if(tileY >= SLEEP_TILES_Y || tileAwake[record] == 0)
+                    return;
+
+                const int center = areaState[id];
+                const global unsigned char * neighbor = (center == 0 ? areaTargetSource : areaTargetSource2);
+                const int top = neighbor[topId];
+                const int right = neighbor[rightId];
+                const int bot = neighbor[botId];
+                const int left = neighbor[leftId];
+
+                const unsigned char result = moveSandOfCell(
+                    center, areaTargetSource[id], areaTargetSource2[id],
+                    top, right, bot, left,
+                    top, right, bot, left,
+                    topIdY != y, rightIdX != x, botIdY != y, leftIdX != x
+                );
+                areaState2[id] = result;
+                if(result != center)
+                    tileFlags2[record] = 1;
+            }
+
+            // seeds of sleeping tiles catch up before other modes compute them
+            kernel void catchUpRandomSeeds(
+                global unsigned int * __restrict__ randomSeedState,
+                global unsigned int * __restrict__ tileSleep
+            )
+            {
+                SLEEPING_TILE_CELL
+                if(tileY >= SLEEP_TILES_Y)
+                    return;
+
+                const unsigned int slept = tileSleep[record];
+                unsigned int randomSeed = randomSeedState[id];
+                for(unsigned int k = 0; k < slept; k++)
+                    randomSeed = rnd(randomSeed);
+                randomSeedState[id] = randomSeed;
+                barrier(CLK_GLOBAL_MEM_FENCE);
+                if(leader)
+                    tileSleep[record] = 0;
+            }
+        )";
+        kernelNames.push_back("sleepingGuessParticleTarget");
+        kernelNames.push_back("sleepingPickOneTargetGuess");
+        kernelNames.push_back("sleepingMoveSand");
+        kernelNames.push_back("catchUpRandomSeeds");
+
+
+        // fused simulation step: guessParticleTarget + pickOneTargetGuess + moveSand in 1 launch (16x16 tile per work-group)
+        programCode += SimulationStepsKernelCode("simulationStep", 1, 16);
+        kernelNames.push_back("simulationStep");
+
+        // temporal blocking: several steps per launch, remaining steps of frame (if any) are computed 1 step per launch by another kernel of same tile size
+        // (so that any steps per frame given later by SetNumStepsPerFrame is computed without compiling again)
+        programCode += SimulationStepsKernelCode("simulationSteps", _temporalBlockingSteps, TEMPORAL_BLOCKING_TILE_SIZE);
+        kernelNames.push_back("simulationSteps");
+        programCode += SimulationStepsKernelCode("simulationStepsRemainder", 1, TEMPORAL_BLOCKING_TILE_SIZE);
+        kernelNames.push_back("simulationStepsRemainder");
+
+        // bit-packed engine for a world with only 1 material (sand): 1 bit per cell, 1 work-item per 32-cell word of a row
+        // neighbor tests, guesses, picks and moves are done for 32 cells at once with bitwise operations
+        // random choices use 32 random bits per word instead of per-cell probabilities:
+        //      bottom, right, left have nearly equal weights (15, 14, 14) so they are picked with approximately equal probability
+        //      up has 1/32 probability when another direction is available (weight 1 of ~30-44)
+        // so its results are statistically similar to (but not same as) the byte-per-cell engine
+        _defineBitMacros = R"(
+            #define BIT_WORDS_PER_ROW ((PLAY_AREA_WIDTH + 31) / 32)
+            #define BIT_WORDS (BIT_WORDS_PER_ROW * PLAY_AREA_HEIGHT)
+
+            // proposal/accept planes (same order as direction codes 1, 2, 4, 8)
+            #define BIT_PLANE_UP 0
+            #define BIT_PLANE_RIGHT 1
+            #define BIT_PLANE_BOT 2
+            #define BIT_PLANE_LEFT 3
+
+            // bit i of word = cell (wordX * 32 + i) of row
+            // cells of last word of row may be partially inside play area
+            const unsigned int bitValidMask(const int wordX)
+            {
+                const int used = PLAY_AREA_WIDTH - wordX * 32;
+                return (used >= 32 ? 0xFFFFFFFF : ((1u << used) - 1));
+            }
+
+            // value of left neighbor cell (x-1) placed on bit of cell x
+            const unsigned int bitFromLeft(const global unsigned int * plane, const int word, const int wordX)
+            {
+                return (plane[word] << 1) | (wordX > 0 ? (plane[word - 1] >> 31) : 0);
+            }
+
+            // value of right neighbor cell (x+1) placed on bit of cell x
+            const unsigned int bitFromRight(const global unsigned int * plane, const int word, const int wordX)
+            {
+                return (plane[word] >> 1) | (wordX < BIT_WORDS_PER_ROW - 1 ? (plane[word + 1] << 31) : 0);
+            }
+
+            const unsigned int bitFromTop(const global unsigned int * plane, const int word, const int y)
+            {
+                return (y > 0 ? plane[word - BIT_WORDS_PER_ROW] : 0);
+            }
+
+            const unsigned int bitFromBot(const global unsigned int * plane, const int word, const int y)
+            {
+                return (y < PLAY_AREA_HEIGHT - 1 ? plane[word + BIT_WORDS_PER_ROW] : 0);
+            }
+
+            const unsigned int randomBits(unsigned int * seed)
+            {
+                *seed = rnd(*seed);
+                return *seed;
+            }
+
+            // picks 1 of 4 candidate masks per bit (up to 1 bit set per position in outputs)
+            // main = weight 15, sideA/sideB = weight 14, rare = weight 1 (only 1/32 probability if others exist)
+            void bitWeightedPick(
+                const unsigned int main, const unsigned int sideA, const unsigned int sideB, const unsigned int rare,
+                unsigned int * pickMain, unsigned int * pickSideA, unsigned int * pickSideB, unsigned int * pickRare,
+                unsigned int * seed
+            )
+            {
+                const unsigned int r1 = randomBits(seed);
+                const unsigned int r2 = randomBits(seed);
+                const unsigned int r3 = randomBits(seed);
+                const unsigned int r4 = randomBits(seed);
+                const unsigned int rareAnyway = randomBits(seed) & randomBits(seed) & randomBits(seed) & randomBits(seed) & randomBits(seed);
+
+                const unsigned int side = sideA | sideB;
+                const unsigned int bothSides = sideA & sideB;
+                const unsigned int others = main | side;
+
+                // main vs sides: 1/2 against 1 side, 3/8 against 2 sides
+                const unsigned int preferMain = (bothSides & r2 & (r3 | r4)) | (~bothSides & r2);
+                const unsigned int takeRare = rare & (~others | rareAnyway);
+                const unsigned int takeMain = main & ~takeRare & (~side | preferMain);
+                const unsigned int takeSideA = sideA & ~takeRare & ~takeMain & (~sideB | r1);
+                const unsigned int takeSideB = sideB & ~takeRare & ~takeMain & (~sideA | ~r1);
+
+                *pickMain = takeMain;
+                *pickSideA = takeSideA;
+                *pickSideB = takeSideB;
+                *pickRare = takeRare;
+            }
+        )";
+
+        programCode += _defineBitMacros;
+        programCode += R"(
+            kernel void bitInitRandomSeed(
+                const global unsigned int * __restrict__ randomSeedIn,
+                global unsigned int * __restrict__ bitRandomSeedState
+            )
+            {
+                const int id=get_global_id(0);
+                bitRandomSeedState[id] = randomSeedIn[id % PLAY_AREA_TOTAL_CELLS];
+            }
+        )";
+        kernelNames.push_back("bitInitRandomSeed");
+
+        programCode += R"(
+            kernel void bitAreaBufInput(
+                const global unsigned char * __restrict__ areaIn,
+                global unsigned int * __restrict__ bitState
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int x0 = (word % BIT_WORDS_PER_ROW) * 32;
+                const int y = word / BIT_WORDS_PER_ROW;
+                unsigned int bits = 0;
+                for(int i=0; i<32 && x0 + i < PLAY_AREA_WIDTH; i++)
+                {
+                    if(areaIn[x0 + i + y * PLAY_AREA_WIDTH] == 1)
+                        bits |= (1u << i);
+                }
+                bitState[word] = bits;
+            }
+        )";
+        kernelNames.push_back("bitAreaBufInput");
+
+        programCode += R"(
+            kernel void bitAreaBufOutput(
+                global unsigned char * __restrict__ areaOut,
+                const global unsigned int * __restrict__ bitState
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int x0 = (word % BIT_WORDS_PER_ROW) * 32;
+                const int y = word / BIT_WORDS_PER_ROW;
+                const unsigned int bits = bitState[word];
+                for(int i=0; i<32 && x0 + i < PLAY_AREA_WIDTH; i++)
+                {
+                    areaOut[x0 + i + y * PLAY_AREA_WIDTH] = (bits >> i) & 1;
+                }
+            }
+        )";
+        kernelNames.push_back("bitAreaBufOutput");
+
+        // only sand (1) sets a bit like bitAreaBufInput
+        programCode += R"(
+            kernel void bitApplyBrushEvents(
+                const global int * __restrict__ brushEvents,
+                global unsigned int * __restrict__ bitState
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int x0 = (word % BIT_WORDS_PER_ROW) * 32;
+                const int y = word / BIT_WORDS_PER_ROW;
+                const int count = brushEvents[0];
+                unsigned int bits = bitState[word];
+                for(int k=0; k<count; k++)
+                {
+                    const global int * brush = brushRecord(brushEvents, k);
+                    if(abs(y - brush[1]) > brush[2])
+                        continue;
+                    for(int i=0; i<32 && x0 + i < PLAY_AREA_WIDTH; i++)
+                    {
+                        if(brushCovers(brush, x0 + i, y))
+                            bits = (brush[4] == 1 ? (bits | (1u << i)) : (bits & ~(1u << i)));
+                    }
+                }
+                bitState[word] = bits;
+            }
+        )";
+        kernelNames.push_back("bitApplyBrushEvents");
+
+        // each particle picks 1 empty neighbor to go
+        programCode += R"(
+            kernel void bitGuessParticleTarget(
+                const global unsigned int * __restrict__ bitState,
+                global unsigned int * __restrict__ bitRandomSeedState,
+                global unsigned int * __restrict__ bitProposals
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int wordX = word % BIT_WORDS_PER_ROW;
+                const int y = word / BIT_WORDS_PER_ROW;
+                const unsigned int valid = bitValidMask(wordX);
+                const unsigned int hasLeft = ((valid << 1) | (wordX > 0 ? 1 : 0)) & valid;
+                const unsigned int hasRight = ((valid >> 1) | (wordX < BIT_WORDS_PER_ROW - 1 ? 0x80000000 : 0)) & valid;
+                const unsigned int hasTop = (y > 0 ? valid : 0);
+                const unsigned int hasBot = (y < PLAY_AREA_HEIGHT - 1 ? valid : 0);
+
+                const unsigned int matter = bitState[word];
+                const unsigned int canGoUp = matter & ~bitFromTop(bitState, word, y) & hasTop;
+                const unsigned int canGoRight = matter & ~bitFromRight(bitState, word, wordX) & hasRight;
+                const unsigned int canGoBot = matter & ~bitFromBot(bitState, word, y) & hasBot;
+                const unsigned int canGoLeft = matter & ~bitFromLeft(bitState, word, wordX) & hasLeft;
+
+                unsigned int seed = bitRandomSeedState[word];
+                unsigned int goUp, goRight, goBot, goLeft;
+                bitWeightedPick(canGoBot, canGoRight, canGoLeft, canGoUp, &goBot, &goRight, &goLeft, &goUp, &seed);
+                bitRandomSeedState[word] = seed;
+
+                bitProposals[word + BIT_PLANE_UP * BIT_WORDS] = goUp;
+                bitProposals[word + BIT_PLANE_RIGHT * BIT_WORDS] = goRight;
+                bitProposals[word + BIT_PLANE_BOT * BIT_WORDS] = goBot;
+                bitProposals[word + BIT_PLANE_LEFT * BIT_WORDS] = goLeft;
+            }
+        )";
+        kernelNames.push_back("bitGuessParticleTarget");
+
+        // each empty cell picks 1 of neighbors that send matter to it
+        programCode += R"(
+            kernel void bitPickOneTargetGuess(
+                const global unsigned int * __restrict__ bitProposals,
+                global unsigned int * __restrict__ bitRandomSeedState,
+                global unsigned int * __restrict__ bitAccepts
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int wordX = word % BIT_WORDS_PER_ROW;
+                const int y = word / BIT_WORDS_PER_ROW;
+
+                const unsigned int fromTop = bitFromTop(bitProposals + BIT_PLANE_BOT * BIT_WORDS, word, y);
+                const unsigned int fromRight = bitFromRight(bitProposals + BIT_PLANE_LEFT * BIT_WORDS, word, wordX);
+                const unsigned int fromBot = bitFromBot(bitProposals + BIT_PLANE_UP * BIT_WORDS, word, y);
+                const unsigned int fromLeft = bitFromLeft(bitProposals + BIT_PLANE_RIGHT * BIT_WORDS, word, wordX);
+
+                unsigned int seed = bitRandomSeedState[word];
+                unsigned int takeTop, takeRight, takeBot, takeLeft;
+                bitWeightedPick(fromTop, fromRight, fromLeft, fromBot, &takeTop, &takeRight, &takeLeft, &takeBot, &seed);
+                bitRandomSeedState[word] = seed;
+
+                bitAccepts[word + BIT_PLANE_UP * BIT_WORDS] = takeTop;
+                bitAccepts[word + BIT_PLANE_RIGHT * BIT_WORDS] = takeRight;
+                bitAccepts[word + BIT_PLANE_BOT * BIT_WORDS] = takeBot;
+                bitAccepts[word + BIT_PLANE_LEFT * BIT_WORDS] = takeLeft;
+            }
+        )";
+        kernelNames.push_back("bitPickOneTargetGuess");
+
+        // moves matter only if both sides accepted the movement
+        programCode += R"(
+            kernel void bitMoveSand(
+                const global unsigned int * __restrict__ bitProposals,
+                const global unsigned int * __restrict__ bitAccepts,
+                const global unsigned int * __restrict__ bitState,
+                global unsigned int * __restrict__ bitState2
+            )
+            {
+                const int word=get_global_id(0);
+                if(word >= BIT_WORDS)
+                    return;
+                const int wordX = word % BIT_WORDS_PER_ROW;
+                const int y = word / BIT_WORDS_PER_ROW;
+
+                // neighbor that accepted this cell's particle
+                const unsigned int sentUp = bitProposals[word + BIT_PLANE_UP * BIT_WORDS] & bitFromTop(bitAccepts + BIT_PLANE_BOT * BIT_WORDS, word, y);
+                const unsigned int sentRight = bitProposals[word + BIT_PLANE_RIGHT * BIT_WORDS] & bitFromRight(bitAccepts + BIT_PLANE_LEFT * BIT_WORDS, word, wordX);
+                const unsigned int sentBot = bitProposals[word + BIT_PLANE_BOT * BIT_WORDS] & bitFromBot(bitAccepts + BIT_PLANE_UP * BIT_WORDS, word, y);
+                const unsigned int sentLeft = bitProposals[word + BIT_PLANE_LEFT * BIT_WORDS] & bitFromLeft(bitAccepts + BIT_PLANE_RIGHT * BIT_WORDS, word, wordX);
+
+                const unsigned int received =
+                    bitAccepts[word + BIT_PLANE_UP * BIT_WORDS] | bitAccepts[word + BIT_PLANE_RIGHT * BIT_WORDS] |
+                    bitAccepts[word + BIT_PLANE_BOT * BIT_WORDS] | bitAccepts[word + BIT_PLANE_LEFT * BIT_WORDS];
+
+                bitState2[word] = (bitState[word] & ~(sentUp | sentRight | sentBot | sentLeft)) | received;
+            }
+        )";
+        kernelNames.push_back("bitMoveSand");
+
+        // display frame: 2D launch of 16x16 work-groups (1 per sleeping tile), 1 kernel per state representation
+        // a cell is coloured with 3 bytes (BGR) of its material in palette, materials of a tile are summed in local memory and written to record of tile
+        programCode += R"(
+            void colorizeCell(
+                const global unsigned char * __restrict__ palette,
+                global unsigned char * __restrict__ frameOut,
+                global int * __restrict__ matterSums,
+                __local int * sums,
+                const int x, const int y, const int matter
+            )
+            {
+                const int id = x + y * PLAY_AREA_WIDTH;
+                frameOut[3 * id] = palette[3 * matter];
+                frameOut[3 * id + 1] = palette[3 * matter + 1];
+                frameOut[3 * id + 2] = palette[3 * matter + 2];
+
+                const int l = get_local_id(0) + get_local_id(1) * SLEEP_TILE_SIZE;
+                sums[l] = matter;
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for(int half = SLEEP_TILE_SIZE * SLEEP_TILE_SIZE / 2; half > 0; half /= 2)
+                {
+                    if(l < half)
+                        sums[l] += sums[l + half];
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+                if(l == 0)
+                    matterSums[tileRecordOfCell(x, y)] = sums[0];
+            }
+
+            #define COLORIZE_CELL(matterOfCell)                                                 \
+                const int x = get_global_id(0);                                                 \
+                const int y = get_global_id(1);                                                 \
+                local int sums[SLEEP_TILE_SIZE * SLEEP_TILE_SIZE];                              \
+                colorizeCell(palette, frameOut, matterSums, sums, x, y, matterOfCell);
+
+            kernel void colorizeArea(
+                const global unsigned char * __restrict__ palette,
+                const global unsigned char * __restrict__ areaState,
+                global unsigned char * __restrict__ frameOut,
+                global int * __restrict__ matterSums
+            )
+            {
+                COLORIZE_CELL(areaState[x + y * PLAY_AREA_WIDTH])
+            }
+
+            kernel void bitColorizeArea(
+                const global unsigned char * __restrict__ palette,
+                const global unsigned int * __restrict__ bitState,
+                global unsigned char * __restrict__ frameOut,
+                global int * __restrict__ matterSums
+            )
+            {
+                COLORIZE_CELL((bitState[x / 32 + y * BIT_WORDS_PER_ROW] >> (x % 32)) & 1)
+            }
+
+            kernel void packedColorizeArea(
+                const global unsigned char * __restrict__ palette,
+                const global unsigned short * __restrict__ packedCells,
+                global unsigned char * __restrict__ frameOut,
+                global int * __restrict__ matterSums
+            )
+            {
+                COLORIZE_CELL(PACKED_MATTER(packedCells[x + y * PLAY_AREA_WIDTH]))
+            }
+
+            kernel void paddedColorizeArea(
+                const global unsigned char * __restrict__ palette,
+                const global unsigned char * __restrict__ paddedState,
+                global unsigned char * __restrict__ frameOut,
+                global int * __restrict__ matterSums
+            )
+            {
+                COLORIZE_CELL(paddedState[PADDED_INDEX(x, y)])
+            }
+        )";
+        kernelNames.push_back("colorizeArea");
+        kernelNames.push_back("bitColorizeArea");
+        kernelNames.push_back("packedColorizeArea");
+        kernelNames.push_back("paddedColorizeArea");
+        _computer->compile(_defineMacros + programCode, kernelNames);
+
+        // threads per row of grid for strips: 1 thread per cell, 1 thread per 32-cell word or 256 threads per tile
+        for (auto& name : { "initRandomSeed", "areaBufInput", "areaBufOutput", "applyBrushEvents", "guessParticleTarget", "pickOneTargetGuess", "moveSand", "simulationStep",
+            "sleepingGuessParticleTarget", "sleepingPickOneTargetGuess", "sleepingMoveSand", "catchUpRandomSeeds",
+            "packedAreaBufInput", "packedAreaBufOutput", "packedApplyBrushEvents", "packedGuessParticleTarget", "packedPickOneTargetGuess", "packedMoveSand",
+            "paddedAreaBufInput", "paddedAreaBufOutput", "paddedApplyBrushEvents", "paddedGuessParticleTarget", "paddedPickOneTargetGuess", "paddedMoveSand",
+            "colorizeArea", "bitColorizeArea", "packedColorizeArea", "paddedColorizeArea" })
+            _computer->setKernelStrips(name, _width);
+        for (auto& name : { "bitInitRandomSeed", "bitAreaBufInput", "bitAreaBufOutput", "bitApplyBrushEvents", "bitGuessParticleTarget", "bitPickOneTargetGuess", "bitMoveSand" })
+            _computer->setKernelStrips(name, bitWordsPerRow);
+        const size_t tilesX = (_width + TEMPORAL_BLOCKING_TILE_SIZE - 1) / TEMPORAL_BLOCKING_TILE_SIZE;
+        _computer->setKernelStrips("simulationSteps", tilesX * 256 / TEMPORAL_BLOCKING_TILE_SIZE);
+        _computer->setKernelStrips("simulationStepsRemainder", tilesX * 256 / TEMPORAL_BLOCKING_TILE_SIZE);
+
+        for (int material = 0; material < PALETTE_MATERIALS; material++)
+            SetMaterialColor(material, 0, (unsigned char)(material * 200), 0);
+
+        Reset();
+        PrepareGpuParameterList();
+
+    }
+    
+    void Reset()
+    {
         
+        for (int i = 0; i < _width * _height; i++)
+        {
+            AreaInCell(i) = 0;
+            AreaOutCell(i) = 0;
+            RandomSeedInCell(i) = i;
+        }
+        _brushCount = 0;
+        _otherMaterials = false;
+        _otherMaterialsRecheck = false;
+        _areaOutStale = false;
+        // brush probabilities repeat after reset
+        _brushSerial = 0;
+        _uploadArea = true;
+        // seeds restart from first buffer (or step 0)
+        _seedParity = 0;
+        _tileSeedsBehind = false;
+        _randomStep = 0;
+        if (_native)
+        {
+            _native->InitRandomSeed();
+            return;
+        }
+        if (!_counterRandom)
+            _computer->compute(*_parametersRandomInit, "initRandomSeed", 0, _totalCells, _localThreads);
+        _computer->compute(*_parametersBitRandomInit, "bitInitRandomSeed", 0, _bitWords, _localThreads);
+    }
+
+    void Calc()
+    {
+        {
+            GPGPU::Bench bench(&_frameTime);
+            CalcFallingSand();            
+        }
+        _profileFrames++;
+    } 
+
 
-        _computer->compute(*_parameterAreaOutput, "areaBufOutput", 0, _totalCells, 256);
-        _areaIn->copyDataFromPtr(_areaOut->accessPtr<unsigned char>(0));
+    // SIMULATION_MODE_SEPARATE_KERNELS, SIMULATION_MODE_FUSED, SIMULATION_MODE_TEMPORAL_BLOCKING, SIMULATION_MODE_BIT_PACKED, SIMULATION_MODE_SLEEPING_TILES, SIMULATION_MODE_PACKED_RECORDS, SIMULATION_MODE_PADDED_GRID or SIMULATION_MODE_AUTO
+    void SetSimulationMode(int simulationMode)
+    {
+        if (_native)
+        {
+            if (simulationMode == SIMULATION_MODE_BIT_PACKED)
+            {
+                throw std::invalid_argument("error: native backend does not have bit-packed engine");
+            }
+            // every other mode gives same results as separate kernels
+            _autoSimulationMode = false;
+            _simulationMode = (simulationMode == SIMULATION_MODE_AUTO ? SIMULATION_MODE_SEPARATE_KERNELS : simulationMode);
+            _native->SetSleepingTiles(_simulationMode == SIMULATION_MODE_SLEEPING_TILES);
+            PrepareGpuParameterList();
+            return;
+        }
+        _autoSimulationMode = (simulationMode == SIMULATION_MODE_AUTO);
+        if (_autoSimulationMode)
+            simulationMode = PickSimulationMode();
+        _simulationMode = simulationMode;
+        PrepareGpuParameterList();
+    }
+
+    // returns SIMULATION_MODE_AUTO if mode is picked automatically
+    int GetSimulationMode()
+    {
+        return _autoSimulationMode ? SIMULATION_MODE_AUTO : _simulationMode;
     }
 
+    // bit-packed engine can only represent sand
+    // materials are tracked from brushes (added or applied), so state is not scanned on each frame
+    int PickSimulationMode()
+    {
+        return _otherMaterials ? SIMULATION_MODE_TEMPORAL_BLOCKING : SIMULATION_MODE_BIT_PACKED;
+    }
 
+    // scans output of a frame after brushes of sand or empty were applied (all applied brushes are in output of frame)
+    void RecheckOtherMaterials()
+    {
+        ReadAreaOutput();
+        _otherMaterialsRecheck = false;
+        _otherMaterials = false;
+        for (int i = 0; i < _totalCells && !_otherMaterials; i++)
+            _otherMaterials = (AreaOutValue(i) > 1);
+    }
 
-    void AddSandToCursorPosition(int x, int y)
+    int GetTemporalBlockingSteps()
+    {
+        return _temporalBlockingSteps;
+    }
+
+    // work-group size of per-cell and per-word kernels (separate kernels and bit-packed modes, input/output and brushes)
+    // must divide 256 because grid has a multiple of 256 cells and words
+    void SetLocalThreads(int localThreads)
+    {
+        if (localThreads <= 0 || 256 % localThreads != 0)
+        {
+            throw std::invalid_argument(std::string("error: local threads must divide 256: ") + std::to_string(localThreads));
+        }
+        _localThreads = localThreads;
+        PrepareGpuParameterList();
+    }
+
+    int GetLocalThreads()
+    {
+        return _localThreads;
+    }
+
+    // nanoseconds of last Calc
+    size_t GetFrameTime()
+    {
+        return _frameTime;
+    }
+
+    int GetNumStepsPerFrame()
+    {
+        return _numComputePerFrame;
+    }
+
+    // steps that are not a multiple of steps per launch in SIMULATION_MODE_TEMPORAL_BLOCKING are computed by 1-step launches
+    void SetNumStepsPerFrame(int numStepsPerFrame)
+    {
+        _numComputePerFrame = numStepsPerFrame;
+        PrepareGpuParameterList();
+    }
+
+    // picks largest steps per frame (a multiple of steps per launch) that computes in maxFrameNanoseconds and fastest work-group size of each device
+    // winners are saved to tuning profile of devices, so later runs on same devices and play area size only load them
+    // simulation advances while candidates are measured
+    void AutoTune(size_t maxFrameNanoseconds)
+    {
+        _autoTune = true;
+        std::vector<size_t> candidates;
+        for (size_t steps = _temporalBlockingSteps; steps <= 8192; steps *= 2)
+            candidates.push_back(steps);
+
+        // host threads are measured on each run (no devices to keep a profile of)
+        if (_native)
+        {
+            size_t best = candidates[0];
+            for (auto& candidate : candidates)
+            {
+                SetNumStepsPerFrame((int)candidate);
+                Calc();
+                if (GetFrameTime() > maxFrameNanoseconds)
+                    break;
+                best = candidate;
+            }
+            SetNumStepsPerFrame((int)best);
+            return;
+        }
+
+        const size_t steps = _computer->tuneBatchLength(TuningKey(std::string(_autoSimulationMode ? "auto " : "") + std::string("steps per frame in ") + std::to_string(maxFrameNanoseconds) + std::string(" ns")), candidates, maxFrameNanoseconds, [&](size_t numSteps) {
+            SetNumStepsPerFrame((int)numSteps);
+            // first frame uploads state
+            Calc();
+            Calc();
+            return GetFrameTime();
+        });
+        SetNumStepsPerFrame((int)steps);
+    }
+
+    // material of a cell on output of last Calc
+    unsigned char GetCell(int x, int y)
+    {
+        ReadAreaOutput();
+        return AreaOutValue(x + y * _width);
+    }
+
+    // colour of a material on frames of ColorizeFrame and Render (default: green of material x 200)
+    void SetMaterialColor(int material, unsigned char blue, unsigned char green, unsigned char red)
+    {
+        if (material < 0 || material >= PALETTE_MATERIALS)
+            throw std::invalid_argument(std::string("error: material of palette out of range: ") + std::to_string(material));
+        PaletteCell(3 * material) = blue;
+        PaletteCell(3 * material + 1) = green;
+        PaletteCell(3 * material + 2) = red;
+    }
+
+    // colours state of last Calc into frame (GetFrame) on devices (or host threads of native backend), returns sum of materials of all cells
+    int ColorizeFrame()
+    {
+        if (_native)
+            return _native->Colorize();
+
+        _computer->compute(*_parameterColorize[_stateParity], _colorizeKernel, GPGPU::Size2D(0, 0), GPGPU::Size2D(_width, _height), GPGPU::Size2D(SLEEP_TILE_SIZE, SLEEP_TILE_SIZE));
+        // record of a tile is on first row of tile
+        int total = 0;
+        for (int tileY = 0; tileY < _height / SLEEP_TILE_SIZE; tileY++)
+        {
+            for (int tileX = 0; tileX < _width / SLEEP_TILE_SIZE; tileX++)
+                total += _matterSums->value<int>(tileX + tileY * _width);
+        }
+        return total;
+    }
+
+    // frame of last ColorizeFrame: rows of width cells, 3 bytes (BGR) per cell
+    unsigned char* GetFrame()
+    {
+        return _native ? _native->frame.data() : _frameOut->accessPtr<unsigned char>(0);
+    }
+
+    // NativeSimd::INSTRUCTION_SET_* used by native backend (best one that CPU supports by default)
+    void SetNativeInstructionSet(int instructionSet)
+    {
+        if (!_native)
+            throw std::invalid_argument(std::string("error: instruction set can be selected only for native backend"));
+        _native->SetInstructionSet(instructionSet);
+    }
+
+    std::vector<std::string> GetDeviceNames()
+    {
+        if (_native)
+            return { std::string("native (") + std::to_string(_native->GetNumThreads()) + std::string(" threads, ") + NativeSimd::InstructionSetName(_native->GetInstructionSet()) + std::string(")") };
+        return _computer->deviceNames(false);
+    }
+
+    // host copies of input, output, seeds, palette and brush events (HostParameters of OpenCL backend or vectors of native backend)
+    // *Cell functions mark element as written (for upload), *Value functions only read it
+    unsigned char& AreaInCell(int i)
+    {
+        return _native ? _native->areaIn[i] : _areaIn->access<unsigned char>(i);
+    }
+
+    unsigned char& AreaOutCell(int i)
+    {
+        return _native ? _native->areaOut[i] : _areaOut->access<unsigned char>(i);
+    }
+
+    unsigned char AreaOutValue(int i)
+    {
+        return _native ? _native->areaOut[i] : _areaOut->value<unsigned char>(i);
+    }
+
+    unsigned int& RandomSeedInCell(int i)
+    {
+        return _native ? _native->randomSeedIn[i] : _randomSeedIn->access<unsigned int>(i);
+    }
+
+    unsigned char& PaletteCell(int i)
+    {
+        return _native ? _native->palette[i] : _palette->access<unsigned char>(i);
+    }
+
+    int& BrushEventCell(int i)
+    {
+        return _native ? _native->brushEvents[i] : _brushEvents->access<int>(i);
+    }
+
+    int BrushEventValue(int i)
+    {
+        return _native ? _native->brushEvents[i] : _brushEvents->value<int>(i);
+    }
+
+    // key of a tuned value in tuning profile
+    std::string TuningKey(std::string name)
     {
-        for (int j = -15; j <= 15; j++)
-            for (int i = -15; i <= 15; i++)
-                if (x + i >= 0 && x + i < _width && y + j >= 0 && y + j < _height)
+        return std::string("PlayArea ") + std::to_string(_width) + std::string("x") + std::to_string(_height) + std::string(" mode ") + std::to_string(_simulationMode) + std::string(" ") + name;
+    }
+
+    void PrepareGpuParameterList()
+    {
+        // state of other representation is re-uploaded from last output
+        _uploadArea = true;
+        if (_native)
+        {
+            _native->areaIn = _native->areaOut;
+            return;
+        }
+        ReadAreaOutput();
+        _areaIn->copyDataFromPtr(_areaOut->constPtr<unsigned char>(0));
+
+        // halo rows that a launch reads from neighboring strips (new state of a cell needs 3 rings of neighbors per fused step)
+        const int stateHalo = (_simulationMode == SIMULATION_MODE_TEMPORAL_BLOCKING ? 3 * _temporalBlockingSteps : (_simulationMode == SIMULATION_MODE_FUSED ? 3 : 1));
+        const int seedHalo = ((_simulationMode == SIMULATION_MODE_SEPARATE_KERNELS || _simulationMode == SIMULATION_MODE_SLEEPING_TILES || _simulationMode == SIMULATION_MODE_PACKED_RECORDS || _simulationMode == SIMULATION_MODE_PADDED_GRID) ? 0 : stateHalo);
+        const size_t bitWordsPerRow = (_width + 31) / 32;
+        for (auto& name : { "areaState", "areaState2" })
+            _computer->setParameterStrips(name, _width, stateHalo);
+        if (!_counterRandom)
+        {
+            for (auto& name : { "randomSeedState", "randomSeedState2" })
+                _computer->setParameterStrips(name, _width, seedHalo);
+        }
+        for (auto& name : { "areaTargetSource", "areaTargetSource2", "areaPressureIn", "areaPressureOut", "packedCells", "packedCells2" })
+            _computer->setParameterStrips(name, _width, 1);
+        for (auto& name : { "paddedState", "paddedState2", "paddedTargetSource", "paddedTargetSource2" })
+            _computer->setParameterStrips(name, _paddedPitch, 1, 1, _paddedPitch);
+        for (auto& name : { "bitState", "bitState2" })
+            _computer->setParameterStrips(name, bitWordsPerRow, 1);
+        _computer->setParameterStrips("bitProposals", bitWordsPerRow, 1, 4);
+        _computer->setParameterStrips("bitAccepts", bitWordsPerRow, 1, 4);
+
+        // seeds of tiles that slept in last frames catch up before other modes use them
+        if (_tileSeedsBehind && _simulationMode != SIMULATION_MODE_SLEEPING_TILES)
+        {
+            if (_randomSeedState->getCurrentIndex() != _seedParity)
+                _randomSeedState->swap();
+            _computer->compute(_randomSeedState->current().next(*_tileSleep), "catchUpRandomSeeds", 0, _totalCells, 256);
+        }
+        _tileSeedsBehind = (!_counterRandom && _simulationMode == SIMULATION_MODE_SLEEPING_TILES);
+
+        // step number is a scalar argument (set before each frame)
+        if (_counterRandom && !_randomFrameStep)
+            _randomFrameStep = std::make_shared<GPGPU::HostParameter>(_computer->createScalarInput<unsigned int>("randomStep"));
+
+        _areaInputKernel = _computer->kernelId("areaBufInput");
+        _areaOutputKernel = _computer->kernelId("areaBufOutput");
+        _brushKernel = _computer->kernelId("applyBrushEvents");
+        _colorizeKernel = _computer->kernelId("colorizeArea");
+        _areaInputOutputGlobalThreads = _totalCells;
+
+        // fused/temporal/sleeping kernels run 256 threads per tile, bit-packed kernels run 1 thread per word, packed-record and padded-grid kernels run 16x16 threads per tile of a 2D launch
+        if (_simulationMode == SIMULATION_MODE_BIT_PACKED)
+        {
+            _areaInputKernel = _computer->kernelId("bitAreaBufInput");
+            _areaOutputKernel = _computer->kernelId("bitAreaBufOutput");
+            _brushKernel = _computer->kernelId("bitApplyBrushEvents");
+            _colorizeKernel = _computer->kernelId("bitColorizeArea");
+            _areaInputOutputGlobalThreads = _bitWords;
+            _listGlobalThreads = _bitWords;
+        }
+        else if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+        {
+            _areaInputKernel = _computer->kernelId("packedAreaBufInput");
+            _areaOutputKernel = _computer->kernelId("packedAreaBufOutput");
+            _brushKernel = _computer->kernelId("packedApplyBrushEvents");
+            _colorizeKernel = _computer->kernelId("packedColorizeArea");
+            _listGlobalThreads = _totalCells;
+        }
+        else if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+        {
+            _areaInputKernel = _computer->kernelId("paddedAreaBufInput");
+            _areaOutputKernel = _computer->kernelId("paddedAreaBufOutput");
+            _brushKernel = _computer->kernelId("paddedApplyBrushEvents");
+            _colorizeKernel = _computer->kernelId("paddedColorizeArea");
+            _listGlobalThreads = _totalCells;
+        }
+        else if (_simulationMode == SIMULATION_MODE_TEMPORAL_BLOCKING)
+        {
+            const size_t tilesX = (_width + TEMPORAL_BLOCKING_TILE_SIZE - 1) / TEMPORAL_BLOCKING_TILE_SIZE;
+            const size_t tilesY = (_height + TEMPORAL_BLOCKING_TILE_SIZE - 1) / TEMPORAL_BLOCKING_TILE_SIZE;
+            _listGlobalThreads = tilesX * tilesY * 256;
+        }
+        else
+        {
+            _listGlobalThreads = _totalCells;
+        }
+
+        // state buffer of mode (byte, bit, packed or padded) that output is read from
+        std::shared_ptr<GPGPU::DoubleBuffer> stateBuffer = _areaState;
+        if (_simulationMode == SIMULATION_MODE_BIT_PACKED)
+            stateBuffer = _bitState;
+        else if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+            stateBuffer = _packedCells;
+        else if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+            stateBuffer = _paddedState;
+
+        // fused/temporal kernels swap seed buffers too, so a frame with odd number of launches leaves seeds in the other buffer
+        // state is not re-uploaded on each frame, so a frame with odd number of steps leaves state in the other buffer
+        // one list is prepared for each starting seed buffer and state buffer
+        for (int index = 0; index < 4; index++)
+        {
+            const int parity = index / 2;
+            const int stateParity = index % 2;
+            if (_randomSeedState->getCurrentIndex() != parity)
+                _randomSeedState->swap();
+            if (_areaState->getCurrentIndex() != stateParity)
+                _areaState->swap();
+            if (_bitState->getCurrentIndex() != stateParity)
+                _bitState->swap();
+            if (_packedCells->getCurrentIndex() != stateParity)
+                _packedCells->swap();
+            if (_paddedState->getCurrentIndex() != stateParity)
+                _paddedState->swap();
+            if (_tileFlags->getCurrentIndex() != stateParity)
+                _tileFlags->swap();
+
+            std::vector<GPGPU::HostParameter> listPrm;
+            std::vector<std::string> listKernel;
+
+            // frame is coloured from the state buffer that is current at start of next frame (same values as output)
+            _parameterColorize[stateParity] = std::make_shared<GPGPU::HostParameter>(_palette->next(stateBuffer->current()).next(*_frameOut).next(*_matterSums));
+
+            // input and brushes are written to the state buffer that is current at start of frame (and wake tiles of changed cells up)
+            if (_simulationMode == SIMULATION_MODE_BIT_PACKED)
+            {
+                _parameterAreaInput[parity][stateParity] = std::make_shared<GPGPU::HostParameter>(_areaIn->next(_bitState->current()));
+                _parameterBrush[stateParity] = std::make_shared<GPGPU::HostParameter>(_brushEvents->next(_bitState->current()));
+            }
+            else if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+            {
+                _parameterAreaInput[parity][stateParity] = std::make_shared<GPGPU::HostParameter>(_areaIn->next(_packedCells->current()));
+                _parameterBrush[stateParity] = std::make_shared<GPGPU::HostParameter>(_brushEvents->next(_packedCells->current()));
+            }
+            else if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+            {
+                // walls are written to both state buffers and both target/source buffers
+                _parameterAreaInput[parity][stateParity] = std::make_shared<GPGPU::HostParameter>(_areaIn->next(_paddedState->current()).next(_paddedState->next()).next(*_paddedTargetSource).next(*_paddedTargetSource2));
+                _parameterBrush[stateParity] = std::make_shared<GPGPU::HostParameter>(_brushEvents->next(_paddedState->current()));
+            }
+            else
+            {
+                _parameterAreaInput[parity][stateParity] = std::make_shared<GPGPU::HostParameter>(_areaIn->next(_areaState->current()).next(_tileFlags->current()));
+                _parameterBrush[stateParity] = std::make_shared<GPGPU::HostParameter>(_brushEvents->next(_areaState->current()).next(_tileFlags->current()));
+            }
+
+            // moveSand/simulationStep(s) writes to next buffer and the pair is swapped, so the next launch reads the result without a copy kernel
+            int step = 0;
+            std::vector<unsigned int> stepOfLaunches;
+            while (step < _numComputePerFrame)
+            {
+                // launches of this iteration start on this step
+                const unsigned int launchStep = step;
+                if (_simulationMode == SIMULATION_MODE_BIT_PACKED)
+                {
+                    listPrm.push_back(_bitState->current().next(*_bitRandomSeedState).next(*_bitProposals));
+                    listPrm.push_back(_bitProposals->next(*_bitRandomSeedState).next(*_bitAccepts));
+                    listPrm.push_back(_bitProposals->next(*_bitAccepts).next(_bitState->current()).next(_bitState->next()));
+                    listKernel.push_back("bitGuessParticleTarget");
+                    listKernel.push_back("bitPickOneTargetGuess");
+                    listKernel.push_back("bitMoveSand");
+                    _bitState->swap();
+                    step++;
+                }
+                else if (_simulationMode == SIMULATION_MODE_TEMPORAL_BLOCKING)
+                {
+                    const bool remainder = (_numComputePerFrame - step < _temporalBlockingSteps);
+                    if (_counterRandom)
+                    {
+                        listPrm.push_back(_areaState->current().next(_areaState->next()).next(*_randomFrameStep));
+                    }
+                    else
+                    {
+                        listPrm.push_back(_areaState->current().next(_areaState->next()).next(_randomSeedState->current()).next(_randomSeedState->next()));
+                        _randomSeedState->swap();
+                    }
+                    listKernel.push_back(remainder ? "simulationStepsRemainder" : "simulationSteps");
+                    step += (remainder ? 1 : _temporalBlockingSteps);
+                }
+                else if (_simulationMode == SIMULATION_MODE_SLEEPING_TILES)
+                {
+                    const GPGPU::HostParameter seeds = (_counterRandom ? *_randomFrameStep : _randomSeedState->current());
+                    listPrm.push_back(_areaState->current().next(seeds).next(*_areaTargetSource).next(_tileFlags->current()).next(_tileFlags->next()).next(*_tileAwake).next(*_tileSleep));
+                    listPrm.push_back(_areaTargetSource->next(*_areaTargetSource2).next(seeds).next(_tileFlags->current()).next(*_tileAwake));
+                    listPrm.push_back(_areaTargetSource->next(*_areaTargetSource2).next(_areaState->current()).next(_areaState->next()).next(_tileFlags->next()).next(*_tileAwake));
+                    listKernel.push_back("sleepingGuessParticleTarget");
+                    listKernel.push_back("sleepingPickOneTargetGuess");
+                    listKernel.push_back("sleepingMoveSand");
+                    // flags of this step are read on next step, like state
+                    _tileFlags->swap();
+                    step++;
+                }
+                else if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+                {
+                    // guess and move write next buffer, pick writes current buffer back, so a step swaps the pair once
+                    const GPGPU::HostParameter seeds = (_counterRandom ? *_randomFrameStep : _randomSeedState->current());
+                    listPrm.push_back(_packedCells->current().next(seeds).next(_packedCells->next()).next(*_packedTile));
+                    listPrm.push_back(_packedCells->next().next(seeds).next(_packedCells->current()).next(*_packedTile));
+                    listPrm.push_back(_packedCells->current().next(_packedCells->next()).next(*_packedTile));
+                    listKernel.push_back("packedGuessParticleTarget");
+                    listKernel.push_back("packedPickOneTargetGuess");
+                    listKernel.push_back("packedMoveSand");
+                    _packedCells->swap();
+                    step++;
+                }
+                else if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+                {
+                    const GPGPU::HostParameter seeds = (_counterRandom ? *_randomFrameStep : _randomSeedState->current());
+                    listPrm.push_back(_paddedState->current().next(seeds).next(*_paddedTargetSource));
+                    listPrm.push_back(_paddedTargetSource->next(*_paddedTargetSource2).next(seeds));
+                    listPrm.push_back(_paddedTargetSource->next(*_paddedTargetSource2).next(_paddedState->current()).next(_paddedState->next()));
+                    listKernel.push_back("paddedGuessParticleTarget");
+                    listKernel.push_back("paddedPickOneTargetGuess");
+                    listKernel.push_back("paddedMoveSand");
+                    _paddedState->swap();
+                    step++;
+                }
+                else if (_simulationMode == SIMULATION_MODE_FUSED)
+                {
+                    if (_counterRandom)
+                    {
+                        listPrm.push_back(_areaState->current().next(_areaState->next()).next(*_randomFrameStep));
+                    }
+                    else
+                    {
+                        listPrm.push_back(_areaState->current().next(_areaState->next()).next(_randomSeedState->current()).next(_randomSeedState->next()));
+                        _randomSeedState->swap();
+                    }
+                    listKernel.push_back("simulationStep");
+                    step++;
+                }
+                else
                 {
-                    auto id = x + i + (y + j) * _width;
-                    _areaIn->access<unsigned char>(id)=1;                    
+                    const GPGPU::HostParameter seeds = (_counterRandom ? *_randomFrameStep : _randomSeedState->current());
+                    listPrm.push_back(_areaState->current().next(seeds).next(*_areaTargetSource).next(*_areaPressureIn));
+                    listPrm.push_back(_areaTargetSource->next(*_areaTargetSource2).next(seeds));
+                    listPrm.push_back(_areaTargetSource->next(*_areaTargetSource2).next(_areaState->current()).next(_areaState->next()));
+                    listKernel.push_back("guessParticleTarget");
+                    listKernel.push_back("pickOneTargetGuess");
+                    listKernel.push_back("moveSand");
+                    step++;
                 }
+                stepOfLaunches.resize(listKernel.size(), launchStep);
+                _areaState->swap();
+            }
+
+            // output is read from the buffer that is current after last step
+            _parameterAreaOutput[parity][stateParity] = std::make_shared<GPGPU::HostParameter>(
+                _areaOut->next(stateBuffer->current())
+            );
+
+            const bool tiled = (_simulationMode == SIMULATION_MODE_FUSED || _simulationMode == SIMULATION_MODE_TEMPORAL_BLOCKING || _simulationMode == SIMULATION_MODE_SLEEPING_TILES || _simulationMode == SIMULATION_MODE_PACKED_RECORDS || _simulationMode == SIMULATION_MODE_PADDED_GRID);
+            if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+                _launchPlan[parity][stateParity] = _computer->createLaunchPlan(listPrm, listKernel, GPGPU::Size2D(0, 0), GPGPU::Size2D(_width, _height), GPGPU::Size2D(PACKED_TILE_SIZE, PACKED_TILE_SIZE));
+            else if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+                _launchPlan[parity][stateParity] = _computer->createLaunchPlan(listPrm, listKernel, GPGPU::Size2D(0, 0), GPGPU::Size2D(_width, _height), GPGPU::Size2D(PADDED_GROUP_SIZE, PADDED_GROUP_SIZE));
+            else
+                _launchPlan[parity][stateParity] = _computer->createLaunchPlan(listPrm, listKernel, 0, _listGlobalThreads, tiled ? 256 : _localThreads);
+            if (_counterRandom)
+                _computer->setLaunchOffsets(_launchPlan[parity][stateParity], *_randomFrameStep, stepOfLaunches);
+            // first plan is measured (its buffers are restored after measuring), others load its result
+            if (_autoTune && !tiled)
+            {
+                std::vector<size_t> candidates;
+                for (size_t localThreads = 32; localThreads <= (size_t)_localThreads; localThreads *= 2)
+                    candidates.push_back(localThreads);
+                _computer->tuneLocalThreads(_launchPlan[parity][stateParity], TuningKey(std::string("local threads of ") + std::to_string(_localThreads)), candidates);
+            }
+            _seedParityChange = (_randomSeedState->getCurrentIndex() != parity);
+            _stateParityChange = (stateBuffer->getCurrentIndex() != stateParity);
+        }
+    }
+    void CalcFallingSand()
+    {
+        if (_autoSimulationMode)
+        {
+            const int simulationMode = PickSimulationMode();
+            if (simulationMode != _simulationMode)
+            {
+                _simulationMode = simulationMode;
+                PrepareGpuParameterList();
+            }
+        }
+
+        if (_native)
+        {
+            if (_uploadArea)
+            {
+                _native->AreaInput();
+                _uploadArea = false;
+            }
+            ApplyBrushEvents();
+            for (int step = 0; step < _numComputePerFrame; step++)
+                _native->Step();
+            _native->AreaOutput();
+            return;
+        }
+
+        const int parity = _seedParity;
+        const int stateParity = _stateParity;
+        if (_uploadArea)
+        {
+            _computer->compute(*_parameterAreaInput[parity][stateParity], _areaInputKernel, 0, _areaInputOutputGlobalThreads, _localThreads);
+            _uploadArea = false;
+        }
+        ApplyBrushEvents();
+
+        if (_counterRandom)
+        {
+            _randomFrameStep->access<unsigned int>(0) = _randomStep;
+            _randomStep += _numComputePerFrame;
+        }
+
+        // runs many repeatations of a kernel sequence
+        _computer->run(_launchPlan[parity][stateParity]);
+        
+
+        _areaOutStale = true;
+        _areaOutParity = parity;
+        _areaOutStateParity = stateParity;
+        if (_autoSimulationMode && _otherMaterialsRecheck)
+            RecheckOtherMaterials();
+
+        if (_seedParityChange)
+            _seedParity = 1 - _seedParity;
+        if (_stateParityChange)
+            _stateParity = 1 - _stateParity;
+    }
+
+    // copies state of last frame to _areaOut if it was not copied yet (state does not change until next frame)
+    void ReadAreaOutput()
+    {
+        if (!_areaOutStale)
+            return;
+        _areaOutStale = false;
+        _computer->compute(*_parameterAreaOutput[_areaOutParity][_areaOutStateParity], _areaOutputKernel, 0, _areaInputOutputGlobalThreads, _localThreads);
+    }
+
+    // element index of k-th pending brush record
+    int BrushRecordIndex(int k)
+    {
+        return BRUSH_RECORD_INTS * (1 + (_brushFirst + k) % BRUSH_CAPACITY);
+    }
+
+    // stamps pending brushes into state buffer on device
+    void ApplyBrushEvents()
+    {
+        if (_brushCount == 0)
+            return;
+
+        for (int k = 0; k < _brushCount; k++)
+        {
+            if (BrushEventValue(BrushRecordIndex(k) + 4) > 1)
+                _otherMaterialsRecheck = false;
+            else if (_otherMaterials)
+                _otherMaterialsRecheck = true;
+        }
+
+        BrushEventCell(0) = _brushCount;
+        BrushEventCell(1) = _brushFirst;
+        if (_native)
+            _native->ApplyBrushEvents();
+        else
+            _computer->compute(*_parameterBrush[_stateParity], _brushKernel, 0, _areaInputOutputGlobalThreads, _localThreads);
+        _brushFirst = (_brushFirst + _brushCount) % BRUSH_CAPACITY;
+        _brushCount = 0;
+    }
+
+    // queues a brush to be stamped at start of next frame (a full queue is stamped immediately)
+    // shape: BRUSH_SHAPE_SQUARE or BRUSH_SHAPE_CIRCLE, material: 0 = empty, 1 = sand, probability: ratio of covered cells that are changed
+    void AddBrushEvent(int x, int y, int radius, int shape, int material, float probability = 1.0f)
+    {
+        if (_brushCount == BRUSH_CAPACITY)
+            ApplyBrushEvents();
+
+        const int record = BrushRecordIndex(_brushCount);
+        BrushEventCell(record) = x;
+        BrushEventCell(record + 1) = y;
+        BrushEventCell(record + 2) = radius;
+        BrushEventCell(record + 3) = shape;
+        BrushEventCell(record + 4) = material;
+        if (material > 1)
+            _otherMaterials = true;
+        BrushEventCell(record + 5) = (int)(std::min(std::max(probability, 0.0f), 1.0f) * 65536);
+        BrushEventCell(record + 6) = (int)_brushSerial++;
+        _brushCount++;
+    }
+
+
+
+    void AddSandToCursorPosition(int x, int y)
+    {
+        AddBrushEvent(x, y, 15, BRUSH_SHAPE_SQUARE, 1);
     }
 
     void RemoveSandFromCursorPosition(int x, int y)
     {
-        for (int j = -15; j <= 15; j++)
-            for (int i = -15; i <= 15; i++)
-                if (x + i >= 0 && x + i < _width && y + j >= 0 && y + j < _height)
-                {
-                    auto id = x + i + (y + j) * _width;
-                   _areaIn->access<unsigned char>(id) = 0;
-                }
+        AddBrushEvent(x, y, 15, BRUSH_SHAPE_SQUARE, 0);
     }
 
     void Render()
     {
+#ifndef PLAY_AREA_HEADLESS
         size_t ti = 0;
-        static cv::Mat frame(_height, _width, CV_8UC3);
 
         {
 
 
             GPGPU::Bench bench(&ti);
-            std::vector<std::thread> thr;
-            std::atomic<int> _j = 0,total=0;
-            
-            for (int k = 0; k < std::thread::hardware_concurrency(); k++)
-            {
-                thr.emplace_back([&]() {
-                    int j = 0;
-                    int tot = 0;
-                        
-                    while ((j = _j++) < frame.rows)
-                    {
-                        for (int i = 0; i < frame.cols; i++)
-                        {
-                            unsigned char matter = _areaOut->access<unsigned char>(i + j * _width);
-                            frame.at<cv::Vec3b>(i + j * _width).val[0] = 0;
-                            frame.at<cv::Vec3b>(i + j * _width).val[1] = matter*200;
-                            frame.at<cv::Vec3b>(i + j * _width).val[2] = 0;
-                            tot += matter;
-                        }
-                    }
-
-                    total += tot;
-                    });
-            }
-            for (auto& e : thr)
-                e.join();
-            cv::putText(frame, std::string("compute(")+std::to_string(_numComputePerFrame) + std::string(" steps): ") + std::to_string(_frameTime / 1000000000.0) + std::string(" seconds"), cv::Point2f(46, 76), 1, 4, cv::Scalar(50, 59, 69));
+            // frame is coloured and summed by devices, then read back into memory that the cv::Mat wraps (text is drawn over it)
+            const int total = ColorizeFrame();
+            cv::Mat frame(_height, _width, CV_8UC3, GetFrame());
+            std::string modeName = "";
+            if (_simulationMode == SIMULATION_MODE_FUSED)
+                modeName = " fused";
+            if (_simulationMode == SIMULATION_MODE_TEMPORAL_BLOCKING)
+                modeName = std::string(" ") + std::to_string(_temporalBlockingSteps) + std::string("-per-launch");
+            if (_simulationMode == SIMULATION_MODE_BIT_PACKED)
+                modeName = " bit-packed";
+            if (_simulationMode == SIMULATION_MODE_SLEEPING_TILES)
+                modeName = " sleeping-tiles";
+            if (_simulationMode == SIMULATION_MODE_PACKED_RECORDS)
+                modeName = " packed-records";
+            if (_simulationMode == SIMULATION_MODE_PADDED_GRID)
+                modeName = " padded-grid";
+            if (_autoSimulationMode)
+                modeName += " auto";
+            if (_native)
+                modeName += " native";
+            cv::putText(frame, std::string("compute(")+std::to_string(_numComputePerFrame) + modeName + std::string(" steps): ") + std::to_string(_frameTime / 1000000000.0) + std::string(" seconds"), cv::Point2f(46, 76), 1, 4, cv::Scalar(50, 59, 69));
             cv::putText(frame, std::string("steps per second: ") + std::to_string(_numComputePerFrame/(_frameTime / 1000000000.0)), cv::Point2f(46, 126), 1, 4, cv::Scalar(50, 59, 69));
-            cv::putText(frame, std::string("matter: ") + std::to_string(total.load()), cv::Point2f(46, 176), 1, 4, cv::Scalar(50, 59, 69));
+            cv::putText(frame, std::string("matter: ") + std::to_string(total), cv::Point2f(46, 176), 1, 4, cv::Scalar(50, 59, 69));
+            if (_profiling)
+                RenderProfile(frame);
             cv::imshow("AATPTPT", frame);
 
         }
+#endif
+    }
 
-     
+#ifndef PLAY_AREA_HEADLESS
+
+    // device milliseconds per frame of each kernel and of copies (sum of all devices) since last Render
+    void RenderProfile(cv::Mat& frame)
+    {
+        std::vector<std::pair<std::string, double>> lines;
+        double transfers = 0;
+        for (auto& command : _computer->profile())
+        {
+            const double perFrame = (command.second.totalRunTime - _profileTotals[command.first]) / std::max(_profileFrames, 1) / 1000000.0;
+            _profileTotals[command.first] = command.second.totalRunTime;
+            if (command.first == GPGPU::PROFILE_UPLOAD || command.first == GPGPU::PROFILE_DOWNLOAD)
+                transfers += perFrame;
+            else if (perFrame > 0)
+                lines.push_back({ command.first, perFrame });
+        }
+        lines.push_back({ "transfers", transfers });
+        _profileFrames = 0;
 
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            cv::putText(frame, lines[i].first + std::string(": ") + std::to_string(lines[i].second) + std::string(" ms"), cv::Point2f(46, 226 + 40 * i), 1, 3, cv::Scalar(50, 59, 69));
+        }
     }
+#endif
 
     void Stop()
     {
+#ifndef PLAY_AREA_HEADLESS
         cv::destroyWindow("AATPTPT");
+#endif
     }
 };
\ No newline at end of file
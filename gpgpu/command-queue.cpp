@@ -3,36 +3,159 @@
 #include "command-queue.h"
 namespace GPGPU_LIB
 {
-	CommandQueue::CommandQueue(Context con) :queue(con.context, con.device.device)
+	// out-of-order execution is enabled only if device supports it (profiling is supported by all devices)
+	static cl_command_queue_properties queueProperties(Context& con, bool outOfOrderExecution, bool profiling)
+	{
+		if (con.device.id < 0)
+			return 0;
+
+		cl_command_queue_properties properties = (profiling ? CL_QUEUE_PROFILING_ENABLE : 0);
+		if (!outOfOrderExecution)
+			return properties;
+
+		cl_int op;
+		cl_command_queue_properties supported = con.device.device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>(&op);
+		if (op != CL_SUCCESS)
+		{
+			throw std::invalid_argument(std::string("error: device queue properties query") + getErrorString(op));
+		}
+		return properties | (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+	}
+
+	CommandQueue::CommandQueue(Context con, bool outOfOrderExecution, bool profiling) :queue(con.context, con.device.device, queueProperties(con, outOfOrderExecution, profiling))
 	{
 		sharesRAM = con.device.sharesRAM;
+		outOfOrder = ((queueProperties(con, outOfOrderExecution, false) & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0);
+		pendingCallbacks = std::make_shared<std::atomic<int>>(0);
+		failedStatus = std::make_shared<std::atomic<int>>(0);
+		if (profiling && con.device.id >= 0)
+			profile = std::make_shared<CommandProfile>();
+	}
+
+	void CommandQueue::addProfile(const std::string& name, cl::Event& event)
+	{
+		if (!profile)
+			return;
+
+		std::shared_ptr<CommandProfile> commandProfile = profile;
+		cl::Event completed = event;
+		onComplete(event, [commandProfile, name, completed]() mutable {
+			commandProfile->add(name, completed);
+		});
 	}
 
-	void CommandQueue::run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset)
+	std::vector<cl::Event> CommandQueue::dependencies(Parameter& prm, bool write)
 	{
-		cl_int op = queue.enqueueNDRangeKernel(kernel.kernel, cl::NDRange(offset + globalOffset), cl::NDRange(nGlobal), cl::NDRange(nLocal));
+		std::vector<cl::Event> result;
+		auto itWrite = lastWriteEvents.find(prm.buffer());
+		if (itWrite != lastWriteEvents.end())
+		{
+			result.push_back(itWrite->second);
+		}
+
+		if (write)
+		{
+			auto itRead = readEvents.find(prm.buffer());
+			if (itRead != readEvents.end())
+			{
+				result.insert(result.end(), itRead->second.begin(), itRead->second.end());
+			}
+		}
+		return result;
+	}
+
+	void CommandQueue::addDependency(Parameter& prm, cl::Event& event, bool write)
+	{
+		if (write)
+		{
+			lastWriteEvents[prm.buffer()] = event;
+			readEvents[prm.buffer()].clear();
+		}
+		else
+		{
+			readEvents[prm.buffer()].push_back(event);
+		}
+	}
+
+	// same parameter can be bound to multiple positions but it is a single dependency/copy
+	static void addUnique(std::vector<Parameter*>& prms, Parameter* prm)
+	{
+		if (std::find(prms.begin(), prms.end(), prm) == prms.end())
+		{
+			prms.push_back(prm);
+		}
+	}
+
+	cl::Event CommandQueue::run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset, const LaunchRows& rows)
+	{
+		std::vector<Parameter*> buffers;
+		const int n = kernel.arguments.size();
+		for (int i = 0; i < n; i++)
+		{
+			Parameter* prm = kernel.arguments[i];
+			if (prm != nullptr && !prm->isScalar() && !prm->isLocal())
+			{
+				addUnique(buffers, prm);
+			}
+
+			// scalars are passed by value, host may have changed them after they were bound
+			if (prm != nullptr && prm->isScalar())
+			{
+				setArg(kernel.kernel, *prm, i);
+			}
+		}
+		return run(kernel.kernel, buffers, globalOffset, nGlobal, nLocal, offset, rows);
+	}
+
+	cl::Event CommandQueue::run(cl::Kernel& kernel, std::vector<Parameter*>& buffers, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset, const LaunchRows& rows)
+	{
+		// kernel may read or write any of its buffers
+		std::vector<cl::Event> waitList;
+		for (Parameter* prm : buffers)
+		{
+			std::vector<cl::Event> dep = dependencies(*prm, true);
+			waitList.insert(waitList.end(), dep.begin(), dep.end());
+		}
+
+		cl::Event event;
+		cl_int op = CL_SUCCESS;
+		if (rows.rowThreads > 0)
+		{
+			const size_t firstRow = (offset + globalOffset) / rows.rowThreads;
+			op = queue.enqueueNDRangeKernel(kernel, cl::NDRange(rows.columnOffset, firstRow), cl::NDRange(rows.rowThreads, nGlobal / rows.rowThreads), cl::NDRange(rows.localRowThreads, nLocal / rows.localRowThreads), waitList.size() > 0 ? &waitList : nullptr, &event);
+		}
+		else
+		{
+			op = queue.enqueueNDRangeKernel(kernel, cl::NDRange(offset + globalOffset), cl::NDRange(nGlobal), cl::NDRange(nLocal), waitList.size() > 0 ? &waitList : nullptr, &event);
+		}
 		if (op != CL_SUCCESS)
 		{
 			throw std::invalid_argument(std::string("enqueueNDRangeKernel error: ") + getErrorString(op));
 		}
-	}
 
+		for (Parameter* prm : buffers)
+		{
+			addDependency(*prm, event, true);
+		}
 
+		if (profile)
+			addProfile(kernel.getInfo<CL_KERNEL_FUNCTION_NAME>(), event);
+		return event;
+	}
 
-	void CommandQueue::setPrm(Kernel& kernel, Parameter& prm, int idx)
+	void CommandQueue::setArg(cl::Kernel& kernel, Parameter& prm, int idx)
 	{
 		cl_int op = 0;
-		kernel.mapParameterNameToParameter[prm.name] = prm;
-		
-			
 		cl::size_type st = prm.elementSize;	
 		if (prm.n == 1 && prm.isScalar())
 		{
 			
-			kernel.kernel.setArg(idx, st, prm.hostPrm.quickPtr);
+			op = kernel.setArg(idx, st, prm.hostPrm.quickPtr);
 		}
+		else if (prm.isLocal())
+			op = kernel.setArg(idx, cl::Local(prm.elementSize * prm.n));
 		else
-			op = kernel.kernel.setArg(idx, prm.buffer);
+			op = kernel.setArg(idx, prm.buffer);
 
 		if (op != CL_SUCCESS)
 		{
@@ -40,49 +163,144 @@ namespace GPGPU_LIB
 		}
 	}
 
-	void CommandQueue::copyInputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement)
+	void CommandQueue::setPrm(Kernel& kernel, Parameter& prm, int idx)
 	{
-		if (!sharesRAM)
+		if ((size_t)idx >= kernel.arguments.size())
+		{
+			kernel.arguments.resize(idx + 1, nullptr);
+		}
+		kernel.arguments[idx] = &prm;
+		setArg(kernel.kernel, prm, idx);
+	}
+
+	void CommandQueue::setArgs(Kernel& kernel, std::vector<Parameter*>& prms)
+	{
+		const int n = prms.size();
+		for (int i = 0; i < n; i++)
+		{
+			setArg(kernel.kernel, *prms[i], i);
+		}
+	}
+
+	void CommandQueue::setArgWithOffset(Kernel& kernel, Parameter& prm, int idx, unsigned int offset)
+	{
+		const unsigned int value = *reinterpret_cast<const unsigned int*>(prm.hostPrm.quickPtr) + offset;
+		cl_int op = kernel.kernel.setArg(idx, value);
+		if (op != CL_SUCCESS)
+		{
+			throw std::invalid_argument(std::string("setArg error: ") + getErrorString(op));
+		}
+	}
+
+	void CommandQueue::restoreArgs(Kernel& kernel)
+	{
+		const int n = kernel.arguments.size();
+		for (int i = 0; i < n; i++)
 		{
-			for (auto& e : kernel.mapParameterNameToParameter)
-			{				
-				if (e.second.readOp)
+			if (kernel.arguments[i] != nullptr)
+			{
+				setArg(kernel.kernel, *kernel.arguments[i], i);
+			}
+		}
+	}
+
+	std::vector<cl::Event> CommandQueue::copyInputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement)
+	{
+		std::vector<Parameter*> inputs;
+		for (Parameter* prm : kernel.arguments)
+		{
+			if (prm != nullptr && prm->readOp && !prm->isScalar() && !prm->isLocal())
+			{
+				addUnique(inputs, prm);
+			}
+		}
+		return copyInputs(inputs, globalOffset, offsetElement, numElement);
+	}
+
+	std::vector<cl::Event> CommandQueue::copyOutputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement, bool skipOutputsWithAllElements)
+	{
+		std::vector<Parameter*> outputs;
+		for (Parameter* prm : kernel.arguments)
+		{
+			if (prm != nullptr && prm->writeOp)
+			{
+				addUnique(outputs, prm);
+			}
+		}
+		return copyOutputs(outputs, globalOffset, offsetElement, numElement, skipOutputsWithAllElements);
+	}
+
+	std::vector<std::array<size_t, 3>> CommandQueue::inputRegions(Parameter& prm, size_t globalOffset, size_t offsetElement, size_t numElement)
+	{
+		std::vector<std::array<size_t, 3>> regions;
+		if (prm.readAll && prm.dirtyDevice >= 0)
+		{
+			for (auto& range : prm.hostPrm.dirty->take(prm.dirtyDevice))
+			{
+				regions.push_back({ range.first, range.second - range.first, range.first });
+			}
+		}
+		else if (prm.readAll)
+		{
+			regions.push_back({ 0, prm.elementSize * prm.n, 0 });
+		}
+		else
+		{
+			// device gets a different region on each run (load-balancing) so its region is always sent
+			regions.push_back({
+				prm.bytesOfThreads(globalOffset + offsetElement),
+				prm.bytesOfThreads(numElement),
+				prm.bytesOfThreads(globalOffset + offsetElement)
+			});
+		}
+		return regions;
+	}
+
+	std::vector<cl::Event> CommandQueue::copyInputs(std::vector<Parameter*>& inputs, size_t globalOffset, size_t offsetElement, size_t numElement)
+	{
+		std::vector<cl::Event> events;
+		for (Parameter* prm : inputs)
+		{
+			if (prm->isScalar() || prm->isLocal())
+				continue;
+
+			std::vector<std::array<size_t, 3>> regions = inputRegions(*prm, globalOffset, offsetElement, numElement);
+			if (regions.size() == 0)
+				continue;
+
+			// regions are copied one after another, so the last copy is the only dependency of later commands
+			std::vector<cl::Event> waitList = dependencies(*prm, true);
+			cl::Event event;
+			for (auto& region : regions)
+			{
+				if (!sharesRAM)
 				{
-					
 					cl_int op = queue.enqueueWriteBuffer(
-						e.second.buffer,
+						prm->buffer,
 						CL_FALSE,
-						e.second.readAll ? 0 : (globalOffset * e.second.elementSize * e.second.elementsPerThread + offsetElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.readAll ? (e.second.elementSize * e.second.n) : (numElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.hostPrm.quickPtr +
-						(
-							e.second.readAll ? 0 : (globalOffset * e.second.elementSize + offsetElement * e.second.elementSize * e.second.elementsPerThread)
-							)
+						region[0],
+						region[1],
+						prm->hostPrm.quickPtr + region[2],
+						waitList.size() > 0 ? &waitList : nullptr,
+						&event
 					);
 					if (op != CL_SUCCESS)
 					{
 						throw std::invalid_argument(std::string("enqueueReadBuffer error: ") + getErrorString(op));
 					}
 				}
-			}
-		}
-		else
-		{
-			for (auto& e : kernel.mapParameterNameToParameter)
-			{
-
-				if (e.second.readOp)
+				else
 				{
-					
+					cl::Event mapEvent;
 					cl_int op;
 					void* ptrMap = queue.enqueueMapBuffer(
-						e.second.buffer,
+						prm->buffer,
 						CL_FALSE,
 						CL_MAP_WRITE,
-						e.second.readAll ? 0 : (globalOffset * e.second.elementSize * e.second.elementsPerThread + offsetElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.readAll ? (e.second.elementSize * e.second.n) : (numElement * e.second.elementSize * e.second.elementsPerThread),
-						nullptr,
-						nullptr,
+						region[0],
+						region[1],
+						waitList.size() > 0 ? &waitList : nullptr,
+						&mapEvent,
 						&op
 					);
 
@@ -91,78 +309,188 @@ namespace GPGPU_LIB
 						throw std::invalid_argument(std::string("enqueueMapBuffer(write) error: ") + getErrorString(op));
 					}
 
-					op = queue.enqueueUnmapMemObject(e.second.buffer, ptrMap, NULL, NULL);
+					std::vector<cl::Event> unmapWaitList = { mapEvent };
+					op = queue.enqueueUnmapMemObject(prm->buffer, ptrMap, &unmapWaitList, &event);
 					if (op != CL_SUCCESS)
 					{
 						throw std::invalid_argument(std::string("enqueueUnmapMemObject(write) error: ") + getErrorString(op));
 					}
 				}
+				waitList = { event };
+				addProfile(GPGPU::PROFILE_UPLOAD, event);
 			}
-
+			addDependency(*prm, event, true);
+			events.push_back(event);
 		}
+		return events;
 	}
 
-	void CommandQueue::copyOutputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement)
+	std::vector<cl::Event> CommandQueue::copyOutputs(std::vector<Parameter*>& outputs, size_t globalOffset, size_t offsetElement, size_t numElement, bool skipOutputsWithAllElements)
 	{
+		std::vector<cl::Event> events;
 		if (!sharesRAM)
 		{
-			for (auto& e : kernel.mapParameterNameToParameter)
+			for (Parameter* prm : outputs)
 			{			
-				if (e.second.writeOp)
+				if (skipOutputsWithAllElements && prm->writeAll)
+					continue;
+
+				std::vector<cl::Event> waitList = dependencies(*prm, false);
+				cl::Event event;
+				cl_int op = queue.enqueueReadBuffer(
+					prm->buffer,
+					CL_FALSE,
+					prm->writeAll?0:prm->bytesOfThreads(globalOffset + offsetElement),
+					prm->writeAll?(prm->elementSize*prm->n):prm->bytesOfThreads(numElement),
+					prm->hostPrm.quickPtr +
+					(
+						prm->writeAll ? 0 : prm->bytesOfThreads(globalOffset + offsetElement)
+						),
+					waitList.size() > 0 ? &waitList : nullptr,
+					&event
+				);
+				if (op != CL_SUCCESS)
 				{
-					cl_int op = queue.enqueueReadBuffer(
-						e.second.buffer,
-						CL_FALSE,
-						e.second.writeAll?0:(globalOffset * e.second.elementSize * e.second.elementsPerThread + offsetElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.writeAll?(e.second.elementSize*e.second.n):(numElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.hostPrm.quickPtr +
-						(
-							(globalOffset * e.second.elementSize * e.second.elementsPerThread + offsetElement * e.second.elementSize * e.second.elementsPerThread)
-							)
-					);
-					if (op != CL_SUCCESS)
-					{
-						std::string err1 = std::string("global offset = ") + std::to_string(globalOffset) + "\n";
-						err1 += std::string("offset = ") + std::to_string(offsetElement) + "\n";
-						err1 += std::string("num element = ") + std::to_string(numElement) + "\n";
-						throw std::invalid_argument(std::string("enqueueWriteBuffer-1 error: ") + getErrorString(op)+err1);
-					}
+					std::string err1 = std::string("global offset = ") + std::to_string(globalOffset) + "\n";
+					err1 += std::string("offset = ") + std::to_string(offsetElement) + "\n";
+					err1 += std::string("num element = ") + std::to_string(numElement) + "\n";
+					throw std::invalid_argument(std::string("enqueueWriteBuffer-1 error: ") + getErrorString(op)+err1);
 				}
+				addDependency(*prm, event, false);
+				addProfile(GPGPU::PROFILE_DOWNLOAD, event);
+				events.push_back(event);
 			}
 		}
 		else
 		{
-			for (auto& e : kernel.mapParameterNameToParameter)
+			for (Parameter* prm : outputs)
 			{
+				if (skipOutputsWithAllElements && prm->writeAll)
+					continue;
+
+				std::vector<cl::Event> waitList = dependencies(*prm, false);
+				cl::Event mapEvent;
+				cl_int op;
+				void* ptrMap = queue.enqueueMapBuffer(
+					prm->buffer,
+					CL_FALSE,
+					CL_MAP_READ,
+					prm->writeAll?0:prm->bytesOfThreads(globalOffset + offsetElement),
+					prm->writeAll?(prm->elementSize * prm->n):prm->bytesOfThreads(numElement),
+					waitList.size() > 0 ? &waitList : nullptr,
+					&mapEvent,
+					&op
+				);
 
-				if (e.second.writeOp)
+				if (op != CL_SUCCESS)
 				{
+					throw std::invalid_argument(std::string("enqueueMapBuffer(read) error: ") + getErrorString(op));
+				}
 
-					cl_int op;
-					void* ptrMap = queue.enqueueMapBuffer(
-						e.second.buffer,
-						CL_FALSE,
-						CL_MAP_READ,
-						e.second.writeAll?0:(globalOffset * e.second.elementSize * e.second.elementsPerThread + offsetElement * e.second.elementSize * e.second.elementsPerThread),
-						e.second.writeAll?(e.second.elementSize * e.second.n):(numElement * e.second.elementSize * e.second.elementsPerThread),
-						nullptr,
-						nullptr,
-						&op
-					);
+				std::vector<cl::Event> unmapWaitList = { mapEvent };
+				cl::Event event;
+				op = queue.enqueueUnmapMemObject(prm->buffer, ptrMap, &unmapWaitList, &event);
+				if (op != CL_SUCCESS)
+				{
+					throw std::invalid_argument(std::string("enqueueUnmapMemObject(read) error: ") + getErrorString(op));
+				}
+				addDependency(*prm, event, false);
+				addProfile(GPGPU::PROFILE_DOWNLOAD, event);
+				events.push_back(event);
+			}
+		}
+		return events;
+	}
 
-					if (op != CL_SUCCESS)
-					{
-						throw std::invalid_argument(std::string("enqueueMapBuffer(read) error: ") + getErrorString(op));
-					}
+	cl::Event CommandQueue::copyRange(Parameter& prm, size_t byteOffset, size_t numBytes, bool toDevice)
+	{
+		std::vector<cl::Event> waitList = dependencies(prm, toDevice);
+		cl::Event event;
+		cl_int op;
+		if (!sharesRAM)
+		{
+			if (toDevice)
+				op = queue.enqueueWriteBuffer(prm.buffer, CL_FALSE, byteOffset, numBytes, prm.hostPrm.quickPtr + byteOffset, waitList.size() > 0 ? &waitList : nullptr, &event);
+			else
+				op = queue.enqueueReadBuffer(prm.buffer, CL_FALSE, byteOffset, numBytes, prm.hostPrm.quickPtr + byteOffset, waitList.size() > 0 ? &waitList : nullptr, &event);
 
-					op = queue.enqueueUnmapMemObject(e.second.buffer, ptrMap, NULL, NULL);
-					if (op != CL_SUCCESS)
-					{
-						throw std::invalid_argument(std::string("enqueueUnmapMemObject(read) error: ") + getErrorString(op));
-					}
-				}
+			if (op != CL_SUCCESS)
+			{
+				throw std::invalid_argument(std::string("copyRange error: ") + getErrorString(op));
 			}
 		}
+		else
+		{
+			cl::Event mapEvent;
+			void* ptrMap = queue.enqueueMapBuffer(prm.buffer, CL_FALSE, toDevice ? CL_MAP_WRITE : CL_MAP_READ, byteOffset, numBytes, waitList.size() > 0 ? &waitList : nullptr, &mapEvent, &op);
+			if (op != CL_SUCCESS)
+			{
+				throw std::invalid_argument(std::string("enqueueMapBuffer(range) error: ") + getErrorString(op));
+			}
+
+			std::vector<cl::Event> unmapWaitList = { mapEvent };
+			op = queue.enqueueUnmapMemObject(prm.buffer, ptrMap, &unmapWaitList, &event);
+			if (op != CL_SUCCESS)
+			{
+				throw std::invalid_argument(std::string("enqueueUnmapMemObject(range) error: ") + getErrorString(op));
+			}
+		}
+		addDependency(prm, event, toDevice);
+		addProfile(toDevice ? GPGPU::PROFILE_UPLOAD : GPGPU::PROFILE_DOWNLOAD, event);
+		return event;
+	}
+
+	void CommandQueue::wait(std::vector<cl::Event>& events)
+	{
+		if (events.size() == 0)
+			return;
+
+		cl_int op = cl::Event::waitForEvents(events);
+		if (op != CL_SUCCESS)
+		{
+			throw std::invalid_argument(std::string("waitForEvents error: ") + getErrorString(op));
+		}
+		throwFailedStatus();
+	}
+
+	void CommandQueue::throwFailedStatus()
+	{
+		const int status = failedStatus->exchange(0);
+		if (status < 0)
+		{
+			throw std::invalid_argument(std::string("command execution error: ") + getErrorString(status));
+		}
+	}
+
+	// heap-allocated callback is deleted after it is called (status is negative if command ended with an error)
+	static void CL_CALLBACK completionCallback(cl_event /* event */, cl_int status, void* userData)
+	{
+		std::function<void(cl_int)>* callback = reinterpret_cast<std::function<void(cl_int)>*>(userData);
+		(*callback)(status);
+		delete callback;
+	}
+
+	void CommandQueue::onComplete(cl::Event& event, std::function<void()> callback)
+	{
+		std::shared_ptr<std::atomic<int>> pending = pendingCallbacks;
+		std::shared_ptr<std::atomic<int>> failed = failedStatus;
+		pending->fetch_add(1);
+		std::function<void(cl_int)>* callbackPtr = new std::function<void(cl_int)>([pending, failed, callback](cl_int status) {
+			// times of a failed command are not valid
+			if (status < 0)
+				failed->store(status);
+			else
+				callback();
+			pending->fetch_sub(1);
+		});
+
+		cl_int op = event.setCallback(CL_COMPLETE, completionCallback, callbackPtr);
+		if (op != CL_SUCCESS)
+		{
+			delete callbackPtr;
+			pending->fetch_sub(1);
+			throw std::invalid_argument(std::string("setCallback error: ") + getErrorString(op));
+		}
 	}
 
 	void CommandQueue::flush()
@@ -181,6 +509,18 @@ namespace GPGPU_LIB
 		{
 			throw std::invalid_argument(std::string("finish error: ") + getErrorString(op));
 		}
+
+		// all commands are complete, no need to keep their events
+		lastWriteEvents.clear();
+		readEvents.clear();
+
+		// callbacks may be called a bit later than completion
+		while (pendingCallbacks->load() > 0)
+		{
+			std::this_thread::yield();
+		}
+
+		throwFailedStatus();
 	}
 
 }
\ No newline at end of file
@@ -10,34 +10,111 @@
 #include "device.h"
 #include "parameter.h"
 #include "kernel.h"
+#include "profile.h"
+#include <map>
+#include <atomic>
+#include <functional>
+#include <array>
 
 namespace GPGPU_LIB
 {
 	// opencl command queue wrapper that offers basic functionality: kernel execution, buffer copies. Setting parameter does not enqueue, it is an immediate operation but not thread-safe when kernel is already in use.
+	// every enqueued command waits only for earlier commands that use same buffers (tracked by events per buffer), so commands on different buffers can overlap on out-of-order queues
 	struct CommandQueue
 	{
 		cl::CommandQueue queue;
 		bool sharesRAM;
+		bool outOfOrder; // true = device runs commands in any order that respects event dependencies
+
+		// last command that wrote a buffer and commands that read it after that (per device buffer)
+		std::map<cl_mem, cl::Event> lastWriteEvents;
+		std::map<cl_mem, std::vector<cl::Event>> readEvents;
+
+		// number of completion callbacks not called yet
+		std::shared_ptr<std::atomic<int>> pendingCallbacks;
+
+		// negative status of last command that ended with an error (its callback is not called, sync throws it), 0 = no error
+		std::shared_ptr<std::atomic<int>> failedStatus;
+
+		// device-side times of kernels and copies (nullptr = profiling is not enabled)
+		std::shared_ptr<CommandProfile> profile;
+
 		// requires a context to build
-		CommandQueue(Context con = Context());
+		// outOfOrderExecution = true: uses out-of-order queue if device supports it
+		// profiling = true: device times of each kernel and copy are collected into profile
+		CommandQueue(Context con = Context(), bool outOfOrderExecution = false, bool profiling = false);
 
 		// runs a kernel with globalOffset starting thread offset, nGlobal number of global threads, nLocal number of local threads, offset thread offset that is unique to current device
-		void run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset);
+		// rows: 2D launch of whole rows (thread counts and offsets are multiples of rows.rowThreads, nLocal is a multiple of rows.localRowThreads)
+		// returns completion event of kernel
+		cl::Event run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset, const LaunchRows& rows = LaunchRows());
 
-		// sets a parameter for kernel with position idx that is zero-based
+		// same as run but dependencies are taken from given buffers instead of kernel's bound parameters (for launch plans)
+		cl::Event run(cl::Kernel& kernel, std::vector<Parameter*>& buffers, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset, const LaunchRows& rows = LaunchRows());
+
+		// sets a parameter for kernel with position idx that is zero-based (prm has to outlive the binding)
 		void setPrm(Kernel& kernel, Parameter& prm, int idx);
 
-		// copies (or no-copies for RAM-sharing devices) input buffers of kernel to devices from RAM
-		void copyInputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement);
+		// sets arguments of kernel from given parameters (by position) without changing kernel's own bindings
+		void setArgs(Kernel& kernel, std::vector<Parameter*>& prms);
+
+		// sets unsigned int scalar argument at position idx to value of prm + offset
+		void setArgWithOffset(Kernel& kernel, Parameter& prm, int idx, unsigned int offset);
+
+		// sets arguments of kernel from its own bindings again (after setArgs)
+		void restoreArgs(Kernel& kernel);
+
+		// copies (or no-copies for RAM-sharing devices) input buffers of kernel to devices from RAM (scalars are passed by value and local arrays have no buffer, so they are not copied)
+		// inputs with all elements copy only regions that changed after their last copy to this device (nothing if unchanged)
+		// returns events of copies that read RAM (host data should not be changed until they complete)
+		std::vector<cl::Event> copyInputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement);
 
 		// copies (or no-copies for RAM-sharing devices) output buffers of kernel from devices to RAM
-		void copyOutputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement);
+		// skipOutputsWithAllElements = true: only outputs of thread's own elements are copied (strip launches copy the others per strip of rows)
+		// returns events of copies that write RAM (host data is ready when they complete)
+		std::vector<cl::Event> copyOutputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement, bool skipOutputsWithAllElements = false);
+
+		// copyInputsOfKernel and copyOutputsOfKernel for given input/output parameters
+		std::vector<cl::Event> copyInputs(std::vector<Parameter*>& inputs, size_t globalOffset, size_t offsetElement, size_t numElement);
+		std::vector<cl::Event> copyOutputs(std::vector<Parameter*>& outputs, size_t globalOffset, size_t offsetElement, size_t numElement, bool skipOutputsWithAllElements = false);
+
+		// copies numBytes bytes from byteOffset of parameter between device and RAM (toDevice = RAM to device), for halo rows of strips
+		// returns event of copy that accesses RAM
+		cl::Event copyRange(Parameter& prm, size_t byteOffset, size_t numBytes, bool toDevice);
+
+		// blocks until all given events complete, throws if a command ended with an error since last check
+		void wait(std::vector<cl::Event>& events);
+
+		// throws (and clears) error status reported by completion callback of a failed command
+		void throwFailedStatus();
+
+		// calls callback (from a thread of OpenCL runtime) when event completes successfully
+		// a command that ends with an error skips callback and its status is thrown by next sync
+		void onComplete(cl::Event& event, std::function<void()> callback);
 
 		// starts pushing commands to device
 		void flush();
 
-		// waits for device to complete all commands on current queue
+		// waits for device to complete all commands on current queue (and their completion callbacks)
+		// throws if a command ended with an error since last sync
 		void sync();
+
+	private:
+		// events that a command using the parameter has to wait for (writer waits for readers and writer, reader waits for writer)
+		std::vector<cl::Event> dependencies(Parameter& prm, bool write);
+
+		// records a command that uses the parameter
+		void addDependency(Parameter& prm, cl::Event& event, bool write);
+
+		// adds times of command to profile when it completes (if profiling)
+		void addProfile(const std::string& name, cl::Event& event);
+
+		// sets a single argument of kernel (scalars by value, local arrays by size, others by buffer)
+		void setArg(cl::Kernel& kernel, Parameter& prm, int idx);
+
+		// byte regions of an input to copy: {device offset, size, host offset}
+		// inputs with all elements send only regions that changed after last upload to this device
+		static std::vector<std::array<size_t, 3>> inputRegions(Parameter& prm, size_t globalOffset, size_t offsetElement, size_t numElement);
 	};
 }
 
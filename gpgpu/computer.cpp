@@ -1,8 +1,9 @@
 #include "computer.h"
+#include <algorithm>
 
 namespace GPGPU
 {
-	Computer::Computer(int deviceSelection, int selectionIndex, int clonesPerDevice, bool giveDirectRamAccessToCPU, int maxDevices)
+	Computer::Computer(int deviceSelection, int selectionIndex, int clonesPerDevice, bool giveDirectRamAccessToCPU, int maxDevices, bool outOfOrderQueues, bool profiling) :kernelCacheDirectory("gpgpu-kernel-cache"), tuningProfile("gpgpu-tuning-profile.txt"), stripRows(0), stripRowGranularity(1)
 	{
 
 		std::vector<GPGPU_LIB::Device> allGPUs = platform.getDevices(CL_DEVICE_TYPE_GPU);
@@ -102,7 +103,7 @@ namespace GPGPU
 					ranges.push_back(1);
 					selectedDevices[i].id = uniqueId++;// giving unique id to each device
 					if (uniqueId < maxDevices + 1)
-						workers.push_back(std::make_shared<GPGPU_LIB::Worker>(selectedDevices[i]));
+						workers.push_back(std::make_shared<GPGPU_LIB::Worker>(selectedDevices[i], outOfOrderQueues, profiling));
 				}
 			}
 		}
@@ -113,102 +114,222 @@ namespace GPGPU
 		return workers.size();
 	}
 
-	void Computer::compile(std::string kernelCode, std::string kernelName)
+	KernelId Computer::compile(std::string kernelCode, std::string kernelName)
 	{
+		return compile(kernelCode, std::vector<std::string>{ kernelName })[0];
+	}
+
+	std::vector<KernelId> Computer::compile(std::string kernelCode, std::vector<std::string> kernelNames)
+	{
+		std::vector<KernelId> ids;
+		for (auto& kernelName : kernelNames)
+		{
+			ids.push_back(kernelSlot(kernelName));
+		}
+
+		// all devices build their program at the same time
+		for (int i = 0; i < workers.size(); i++)
+		{
+			workers[i]->compile(kernelCode, kernelNames, ids, kernelCacheDirectory);
+		}
+
 		for (int i = 0; i < workers.size(); i++)
 		{
-			workers[i]->compile(kernelCode, kernelName, &compileLock);
+			workers[i]->waitAllTasks();
+		}
+
+		if (workers.size() > 0)
+		{
+			for (auto& id : ids)
+				kernelWrites[id.index] = workers[0]->kernels[id.index].writes;
 		}
+		return ids;
 	}
 
+	KernelId Computer::kernelSlot(std::string kernelName)
+	{
+		KernelId id(kernelParameters.size());
+		auto it = kernelIds.find(kernelName);
+		if (it == kernelIds.end())
+		{
+			kernelIds[kernelName] = id;
+			kernelParameters.push_back(std::vector<ParamId>());
+			kernelWrites.push_back(std::vector<bool>());
+			kernelThreadsPerRow.push_back(0);
+			loadBalances.push_back(std::vector<double>(workers.size(), 1.0));
+			oldLoadBalances.push_back(std::vector<std::vector<double>>());
+		}
+		else
+		{
+			id = it->second;
 
+			// new kernel object has no arguments set
+			kernelParameters[id.index].clear();
+		}
+		return id;
+	}
 
-	// binds a parameter to a kernel at parameterPosition-th position
-	void Computer::setKernelParameter(std::string kernelName, std::string parameterName, int parameterPosition)
+	void Computer::setKernelCacheDirectory(std::string directory)
 	{
-		// iterating 2 maps with several items should be faster than several threads to do something
+		kernelCacheDirectory = directory;
+	}
 
-		std::map<std::string, std::map<std::string, int>>::iterator it1 = kernelParameters.find(kernelName);
-		bool sendToThreads = false;
+	void Computer::setTuningProfileFile(std::string fileName)
+	{
+		tuningProfile.fileName = fileName;
+	}
 
-		// if  kernel name not found (not run before)
-		if (it1 == kernelParameters.end())
+	KernelId Computer::kernelId(std::string kernelName)
+	{
+		auto it = kernelIds.find(kernelName);
+		if (it == kernelIds.end())
 		{
-			kernelParameters[kernelName][parameterName] = parameterPosition;
-			sendToThreads = true;
+			throw std::invalid_argument(std::string("error: kernel is not compiled: ") + kernelName);
 		}
-		else
+		return it->second;
+	}
+
+	ParamId Computer::parameterId(std::string parameterName)
+	{
+		auto it = parameterIds.find(parameterName);
+		if (it == parameterIds.end())
+		{
+			throw std::invalid_argument(std::string("error: parameter is not created: ") + parameterName);
+		}
+		return it->second;
+	}
+
+	std::vector<KernelId> Computer::kernelIdsOf(std::vector<std::string> kernelNames)
+	{
+		std::vector<KernelId> ids;
+		for (auto& kernelName : kernelNames)
 		{
-			std::map<std::string, int>::iterator it2 = it1->second.find(parameterName);
+			ids.push_back(kernelId(kernelName));
+		}
+		return ids;
+	}
 
-			// if parameter name not found in kernel settings (not used with this kernel before)
-			if (it2 == it1->second.end())
-			{
-				it1->second[parameterName] = parameterPosition;
-				sendToThreads = true;
-			}
-			else
+	std::vector<std::vector<ParamId>> Computer::parameterIdsOf(std::vector<std::vector<std::string>> parameterNames)
+	{
+		std::vector<std::vector<ParamId>> ids;
+		for (auto& chain : parameterNames)
+		{
+			std::vector<ParamId> chainIds;
+			for (auto& parameterName : chain)
 			{
-				// if parameter position changed, then update
-				if (it2->second != parameterPosition)
-				{
-					it2->second = parameterPosition;
-					sendToThreads = true;
-				}
-				else
-				{
-					// if another parameter had same position, then remove it and update
-					for (auto it = it1->second.cbegin(); it != it1->second.cend();)
-					{
-						bool del = false;
-						if (it->second == parameterPosition)
-						{
-							if (it->first != parameterName)
-							{
-								sendToThreads = true;
-								del = true;
-							}
-						}
-						if (del)
-						{
-							it1->second.erase(it++);
-						}
-						else
-						{
-							++it;
-						}
-					}
-				}
+				chainIds.push_back(parameterId(parameterName));
 			}
+			ids.push_back(chainIds);
+		}
+		return ids;
+	}
+
+	// binds a parameter to a kernel at parameterPosition-th position
+	void Computer::setKernelParameter(KernelId kernelId, ParamId parameterId, int parameterPosition)
+	{
+		if (!kernelId.valid() || kernelId.index >= kernelParameters.size())
+		{
+			throw std::invalid_argument(std::string("error: kernel is not compiled. kernel id = ") + std::to_string(kernelId.index));
 		}
 
-		if (sendToThreads)
+		if (!parameterId.valid() || parameterId.index >= hostParameters.size())
 		{
+			throw std::invalid_argument(std::string("error: parameter is not created. parameter id = ") + std::to_string(parameterId.index));
+		}
+
+		// only changed positions are sent to worker threads
+		std::vector<ParamId>& boundParameters = kernelParameters[kernelId.index];
+		if (parameterPosition >= boundParameters.size())
+		{
+			boundParameters.resize(parameterPosition + 1);
+		}
+
+		if (boundParameters[parameterPosition] != parameterId)
+		{
+			boundParameters[parameterPosition] = parameterId;
 			const int nWork = workers.size();
 			for (int i = 0; i < nWork; i++)
 			{
-				workers[i]->setArg(kernelName, parameterName, parameterPosition);
+				workers[i]->setArg(kernelId, parameterId, parameterPosition);
 			}
 		}
+	}
+
+	void Computer::setStrips(size_t numRows, size_t rowGranularity)
+	{
+		if (rowGranularity == 0)
+		{
+			throw std::invalid_argument(std::string("error: row granularity of strips has to be at least 1"));
+		}
+
+		const int n = workers.size();
+		stripRows = numRows;
+		stripRowGranularity = rowGranularity;
+		stripRanges = std::vector<size_t>(n, 1);
+		stripOffsets = std::vector<size_t>(n, 1);
+		stripParameters.clear();
+	}
+
+	void Computer::setKernelStrips(KernelId kernelId, size_t numThreadsPerRow)
+	{
+		if (!kernelId.valid() || kernelId.index >= kernelThreadsPerRow.size())
+		{
+			throw std::invalid_argument(std::string("error: kernel id is not valid: ") + std::to_string(kernelId.index));
+		}
+		kernelThreadsPerRow[kernelId.index] = numThreadsPerRow;
+	}
+
+	void Computer::setKernelStrips(std::string kernelName, size_t numThreadsPerRow)
+	{
+		setKernelStrips(kernelId(kernelName), numThreadsPerRow);
+	}
+
+	void Computer::setParameterStrips(ParamId parameterId, size_t elementsPerRow, size_t haloRows, size_t planes, size_t firstElement)
+	{
+		if (!parameterId.valid() || parameterId.index >= hostParameters.size())
+		{
+			throw std::invalid_argument(std::string("error: parameter id is not valid: ") + std::to_string(parameterId.index));
+		}
+
+		if (stripRows == 0)
+		{
+			throw std::invalid_argument(std::string("error: setStrips has to be called before setParameterStrips"));
+		}
 
+		if (stripParameters.size() <= parameterId.index)
+			stripParameters.resize(parameterId.index + 1);
 
+		// only halo changes: devices keep their rows
+		GPGPU_LIB::StripParameter& strips = stripParameters[parameterId.index];
+		if (strips.elementsPerRow == elementsPerRow && strips.planes == planes && strips.firstElement == firstElement && elementsPerRow > 0)
+			strips.haloRows = haloRows;
+		else
+			strips = GPGPU_LIB::StripParameter(elementsPerRow, haloRows, planes, stripRows, workers.size(), firstElement);
+	}
+
+	void Computer::setParameterStrips(std::string parameterName, size_t elementsPerRow, size_t haloRows, size_t planes, size_t firstElement)
+	{
+		setParameterStrips(parameterId(parameterName), elementsPerRow, haloRows, planes, firstElement);
+	}
+
+	void Computer::setKernelParameter(std::string kernelName, std::string parameterName, int parameterPosition)
+	{
+		setKernelParameter(kernelId(kernelName), parameterId(parameterName), parameterPosition);
 	}
 
 	// applies load-balancing inside each call
-	std::vector<double> Computer::runFineGrainedLoadBalancing(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize)
+	std::vector<double> Computer::runFineGrainedLoadBalancing(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize)
 	{
 		std::vector<double> performancesOfDevices(workers.size());
 
-		//std::cout << "debug 2.5" << std::endl;
 		std::shared_ptr<GPGPU_LIB::GPGPUTaskQueue> taskQueue = std::make_shared<GPGPU_LIB::GPGPUTaskQueue>();
 
-		//std::cout << "debug 4" << std::endl;
 		for (size_t i = 0; i < numGlobalThreads; i += loadSize)
 		{
 
 			GPGPU_LIB::GPGPUTask task;
 			task.taskType = GPGPU_LIB::GPGPUTask::GPGPU_TASK_COMPUTE;
-			task.kernelName = kernelName;
+			task.kernelId = kernelId;
 			task.globalOffset = offsetElement;
 			task.offset = i;
 			task.globalSize = loadSize;
@@ -216,25 +337,21 @@ namespace GPGPU
 			taskQueue->push(task);
 
 		}
-		//std::cout << "debug 5" << std::endl;
+
 		// compute kernels with balanced loads
-		//std::cout << "debug 1" << std::endl;
 		for (int i = 0; i < workers.size(); i++)
 		{
 			// mark end of queue for each worker
 			GPGPU_LIB::GPGPUTask task;
 			task.taskType = GPGPU_LIB::GPGPUTask::GPGPU_TASK_NULL;
 			taskQueue->push(task);
-			workers[i]->runTasks(taskQueue, kernelName);
+			workers[i]->runTasks(taskQueue.get(), kernelId);
 		}
 
-		//std::cout << "debug 2" << std::endl;
-		//std::cout << "debug 6" << std::endl;
 		for (int i = 0; i < workers.size(); i++)
 		{
 			workers[i]->waitAllTasks();
 		}
-		//std::cout << "debug 3" << std::endl;
 
 		double norm = 0.0;
 
@@ -242,7 +359,7 @@ namespace GPGPU
 		{
 			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
 
-			performancesOfDevices[i] = workers[i]->works[kernelName] / workers[i]->benchmarks[kernelName];
+			performancesOfDevices[i] = workers[i]->works[kernelId.index] / workers[i]->benchmarks[kernelId.index];
 			norm += performancesOfDevices[i];
 		}
 
@@ -253,22 +370,19 @@ namespace GPGPU
 		return performancesOfDevices;
 	}
 
+	std::vector<double> Computer::runFineGrainedLoadBalancing(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize)
+	{
+		return runFineGrainedLoadBalancing(kernelId(kernelName), offsetElement, numGlobalThreads, numLocalThreads, loadSize);
+	}
+
 
-	// applies load-balancing between calls
-	std::vector<double> Computer::run(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	// updates load-balancing ratios from last run times and splits global threads into ranges (multiples of local threads) and offsets per device
+	void Computer::balanceLoad(std::vector<double> runTimes, std::vector<double>& selectedKernelLB, std::vector<std::vector<double>>& oldLoadBalnc, std::vector<size_t>& rangesOfDevices, std::vector<size_t>& offsetsOfDevices, size_t numGlobalThreads, size_t numLocalThreads)
 	{
 		const int n = workers.size();
 		std::vector<double> nano(n);
-		if (loadBalances.find(kernelName) == loadBalances.end())
-		{
-			loadBalances[kernelName] = std::vector<double>(n, 1.0);
-		}
-
-		std::vector<double>& selectedKernelLB = loadBalances[kernelName];
-
 
 		// compute load-balancing
-		auto& oldLoadBalnc = oldLoadBalances[kernelName];
 		const int nlb = oldLoadBalnc.size();
 		double totalLoad = 0;
 		std::vector<double> avg(n, 0);
@@ -283,14 +397,7 @@ namespace GPGPU
 
 		for (int i = 0; i < n; i++)
 		{
-			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
-			nano[i] = workers[i]->benchmarks[kernelName];
-
-		}
-
-		for (int i = 0; i < n; i++)
-		{
-			nano[i] = ranges[i] / nano[i]; // capability = run_size / run_time
+			nano[i] = rangesOfDevices[i] / runTimes[i]; // capability = run_size / run_time
 			nano[i] = (avg[i] + (nano[i] * 4)) / (nlb + 4);
 			totalLoad += nano[i];
 		}
@@ -313,7 +420,7 @@ namespace GPGPU
 		// calculate ranges
 		for (int i = 0; i < n; i++)
 		{
-			ranges[i] = (((size_t)(numGlobalThreads * selectedKernelLB[i])) / numLocalThreads) * numLocalThreads;
+			rangesOfDevices[i] = (((size_t)(numGlobalThreads * selectedKernelLB[i])) / numLocalThreads) * numLocalThreads;
 		}
 
 		size_t totalThreads = 0;
@@ -322,11 +429,11 @@ namespace GPGPU
 		for (int i = 0; i < n; i++)
 		{
 			// if no work was given, give it at least single work group 
-			if (ranges[i] == 0)
+			if (rangesOfDevices[i] == 0)
 			{
-				ranges[i] = numLocalThreads;
+				rangesOfDevices[i] = numLocalThreads;
 			}
-			totalThreads += ranges[i];
+			totalThreads += rangesOfDevices[i];
 		}
 
 
@@ -354,15 +461,15 @@ namespace GPGPU
 				break;
 			for (int i = 0; i < n; i++)
 			{
-				if (toBeSubtracted > 0 && ranges[i] > numLocalThreads)
+				if (toBeSubtracted > 0 && rangesOfDevices[i] > numLocalThreads)
 				{
-					ranges[i] -= numLocalThreads;
+					rangesOfDevices[i] -= numLocalThreads;
 					toBeSubtracted -= numLocalThreads;
 				}
 
 				if (toBeAdded > 0)
 				{
-					ranges[i] += numLocalThreads;
+					rangesOfDevices[i] += numLocalThreads;
 					toBeAdded -= numLocalThreads;
 				}
 			}
@@ -370,7 +477,7 @@ namespace GPGPU
 
 
 		for (int i = 0; i < n; i++)
-			newTotal += ranges[i];
+			newTotal += rangesOfDevices[i];
 
 		if (toBeSubtracted > 0 || toBeAdded > 0 || newTotal != numGlobalThreads || (newTotal / numLocalThreads) * numLocalThreads != newTotal)
 		{
@@ -382,7 +489,7 @@ namespace GPGPU
 			for (int i = 0; i < n; i++)
 			{
 				err += std::string("\n performance of device = ");
-				err += std::to_string(workers[i]->benchmarks[kernelName]);
+				err += std::to_string(runTimes[i]);
 			}
 			throw std::invalid_argument(err);
 		}
@@ -392,223 +499,617 @@ namespace GPGPU
 		size_t curOfs = 0;
 		for (int i = 0; i < n; i++)
 		{
-			offsets[i] = curOfs;
-			curOfs += ranges[i];
+			offsetsOfDevices[i] = curOfs;
+			curOfs += rangesOfDevices[i];
 		}
 
-		// compute kernels with balanced loads
-		for (int i = 0; i < n; i++)
-		{
-
-			workers[i]->run(kernelName, offsetElement, offsets[i], ranges[i], numLocalThreads);
-		}
-
-
-		// do some work while gpus are working independently
 		oldLoadBalnc.push_back(avg);
+	}
+
+	// workload ratios of devices from their ranges
+	static std::vector<double> workloadRatios(std::vector<size_t>& rangesOfDevices)
+	{
+		const int n = rangesOfDevices.size();
+		std::vector<double> ratios(n);
 		double norm = 0.0;
 
 		for (int i = 0; i < n; i++)
 		{
-			nano[i] = ranges[i];
-			norm += ranges[i];
+			ratios[i] = rangesOfDevices[i];
+			norm += rangesOfDevices[i];
 		}
 
 		for (int i = 0; i < n; i++)
 		{
-			nano[i] /= norm;
+			ratios[i] /= norm;
 		}
+		return ratios;
+	}
 
+	bool Computer::stripped(KernelId kernelId)
+	{
+		return workers.size() > 1 && stripRows > 0 && kernelThreadsPerRow[kernelId.index] > 0;
+	}
+
+	std::vector<GPGPU_LIB::RowRange> Computer::stripRowsOf(std::vector<size_t>& rangesOfDevices, std::vector<size_t>& offsetsOfDevices)
+	{
+		const int n = rangesOfDevices.size();
+		std::vector<GPGPU_LIB::RowRange> rows(n);
 		for (int i = 0; i < n; i++)
 		{
-			workers[i]->waitAllTasks();
+			rows[i].begin = std::min(offsetsOfDevices[i] * stripRowGranularity, stripRows);
+			rows[i].end = (i == n - 1) ? stripRows : std::min((offsetsOfDevices[i] + rangesOfDevices[i]) * stripRowGranularity, stripRows);
 		}
+		return rows;
+	}
 
-		return nano;
+	size_t Computer::stripThreadsOf(int device, const GPGPU_LIB::RowRange& rows, size_t threadsPerRow, size_t numGlobalThreads, size_t granularity, size_t& threadOffset)
+	{
+		// threads of strip, rounded up to a multiple of local threads and kept inside the global range
+		threadOffset = rows.begin * threadsPerRow;
+		const size_t threadEnd = (device == (int)workers.size() - 1) ? numGlobalThreads : std::min(rows.end * threadsPerRow, numGlobalThreads);
+		const size_t numThreads = threadEnd > threadOffset ? ((threadEnd - threadOffset + granularity - 1) / granularity) * granularity : 0;
+		if (threadOffset + numThreads > numGlobalThreads)
+			threadOffset = numGlobalThreads > numThreads ? numGlobalThreads - numThreads : 0;
+		return numThreads;
 	}
 
-	// applies load-balancing between calls
-	std::vector<double> Computer::runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	void Computer::runStripLaunch(KernelId kernelId, const std::vector<ParamId>& chain, LaunchPlan* plan, size_t launchIndex, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, const std::vector<GPGPU_LIB::RowRange>& rows, const GPGPU_LIB::LaunchRows& launchRows)
 	{
-		std::string kernelName;
-		for (auto& str : kernelNames)
-		{
-			kernelName += (str + " ");
-		}
 		const int n = workers.size();
-		std::vector<double> nano(n);
-		if (loadBalances.find(kernelName) == loadBalances.end())
+		const size_t threadsPerRow = kernelThreadsPerRow[kernelId.index];
+		const std::vector<bool>& writes = kernelWrites[kernelId.index];
+		if (launchRows.rowThreads > 0 && launchRows.rowThreads != threadsPerRow)
 		{
-			loadBalances[kernelName] = std::vector<double>(n, 1.0);
+			throw std::invalid_argument(std::string("error: 2D launch has ") + std::to_string(launchRows.rowThreads) + std::string(" work-items per row but its kernel has ") + std::to_string(threadsPerRow) + std::string(" threads per row of strips"));
 		}
+		// strips of 2D launches are whole rows of work-groups
+		const size_t granularity = launchRows.granularity(numLocalThreads);
 
-		std::vector<double>& selectedKernelLB = loadBalances[kernelName];
+		// strip parameters of launch (once per parameter)
+		std::vector<ParamId> prms;
+		for (auto& id : chain)
+		{
+			if (id.valid() && id.index < stripParameters.size() && stripParameters[id.index].elementsPerRow > 0 && std::find(prms.begin(), prms.end(), id) == prms.end())
+				prms.push_back(id);
+		}
 
+		// halo rows go through RAM: all owners download them before any device uploads them
+		std::vector<std::vector<GPGPU_LIB::StripTransfer>> downloads(n), uploads(n), outputs(n);
+		for (auto& id : prms)
+		{
+			HostParameter& prm = hostParameters[id.index];
+			stripParameters[id.index].exchange(id, prm.elementSize, prm.n, stripRows, rows, downloads, uploads);
+		}
 
-		// compute load-balancing
-		auto& oldLoadBalnc = oldLoadBalances[kernelName];
-		const int nlb = oldLoadBalnc.size();
-		double totalLoad = 0;
-		std::vector<double> avg(n, 0);
-		for (int i = 0; i < nlb; i++)
+		bool anyDownload = false;
+		for (int i = 0; i < n; i++)
 		{
-			for (int j = 0; j < n; j++)
+			if (downloads[i].size() > 0)
 			{
-				avg[j] += oldLoadBalnc[i][j];
+				workers[i]->transfer(&downloads[i]);
+				anyDownload = true;
 			}
+		}
 
+		if (anyDownload)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				workers[i]->waitAllTasks();
+			}
 		}
 
 		for (int i = 0; i < n; i++)
 		{
-			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
-			if (workers[i]->benchmarks.find(kernelName) == workers[i]->benchmarks.end())
-				workers[i]->benchmarks[kernelName] = 1;
-			nano[i] = workers[i]->benchmarks[kernelName];
+			size_t threadOffset = 0;
+			const size_t numThreads = stripThreadsOf(i, rows[i], threadsPerRow, numGlobalThreads, granularity, threadOffset);
+
+			if (uploads[i].size() > 0)
+				workers[i]->transfer(&uploads[i]);
+
+			if (numThreads == 0)
+				continue;
+
+			if (plan)
+				workers[i]->runStrip(plan->workerPlans[i].get(), offsetElement, threadOffset, numThreads, plan->localThreadsOfDevices[i], launchIndex, launchIndex + 1);
+			else
+				workers[i]->runStrip(kernelId, offsetElement, threadOffset, numThreads, numLocalThreads, launchRows);
+		}
+
+		// written parameters are owned by strips, outputs with all elements are copied per strip
+		for (auto& id : prms)
+		{
+			bool written = false;
+			for (size_t j = 0; j < chain.size(); j++)
+			{
+				if (chain[j] == id && (j >= writes.size() || writes[j]))
+					written = true;
+			}
+
+			if (!written)
+				continue;
 
+			HostParameter& prm = hostParameters[id.index];
+			stripParameters[id.index].written(rows);
+			if (prm.writeOp && prm.writeAllOp)
+				stripParameters[id.index].collect(id, prm.elementSize, prm.n, stripRows, rows, outputs);
 		}
 
 		for (int i = 0; i < n; i++)
 		{
-			nano[i] = ranges[i] / nano[i]; // capability = run_size / run_time
-			nano[i] = (avg[i] + (nano[i] * 4)) / (nlb + 4);
-			totalLoad += nano[i];
+			if (outputs[i].size() > 0)
+				workers[i]->transfer(&outputs[i]);
 		}
 
-		// normalized loads
 		for (int i = 0; i < n; i++)
 		{
-			avg[i] = nano[i];
-			selectedKernelLB[i] = nano[i] / totalLoad;
+			workers[i]->waitAllTasks();
 		}
+	}
 
-		for (int i = 0; i < nlb - 1; i++)
+	// applies load-balancing between calls
+	std::vector<double> Computer::run(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	{
+		return runKernel(kernelId, offsetElement, numGlobalThreads, numLocalThreads, GPGPU_LIB::LaunchRows());
+	}
+
+	std::vector<double> Computer::runKernel(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, const GPGPU_LIB::LaunchRows& launchRows)
+	{
+		const int n = workers.size();
+		std::vector<double> nano(n);
+		for (int i = 0; i < n; i++)
 		{
-			oldLoadBalnc[i] = oldLoadBalnc[i + 1];
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			nano[i] = workers[i]->benchmarks[kernelId.index];
+
 		}
 
-		if (oldLoadBalnc.size() > 1)
-			oldLoadBalnc.resize(1);
+		if (stripped(kernelId))
+		{
+			// strips are balanced in units of row granularity
+			balanceLoad(nano, loadBalances[kernelId.index], oldLoadBalances[kernelId.index], stripRanges, stripOffsets, (stripRows + stripRowGranularity - 1) / stripRowGranularity, 1);
+			runStripLaunch(kernelId, kernelParameters[kernelId.index], nullptr, 0, offsetElement, numGlobalThreads, numLocalThreads, stripRowsOf(stripRanges, stripOffsets), launchRows);
+			return workloadRatios(stripRanges);
+		}
 
-		// calculate ranges
+		balanceLoad(nano, loadBalances[kernelId.index], oldLoadBalances[kernelId.index], ranges, offsets, numGlobalThreads, launchRows.granularity(numLocalThreads));
+
+		// compute kernels with balanced loads
 		for (int i = 0; i < n; i++)
 		{
-			ranges[i] = (((size_t)(numGlobalThreads * selectedKernelLB[i])) / numLocalThreads) * numLocalThreads;
+
+			workers[i]->run(kernelId, offsetElement, offsets[i], ranges[i], numLocalThreads, false, nullptr, nullptr, launchRows);
 		}
 
-		size_t totalThreads = 0;
 
-		// refine ranges (invalid values)
+		// do some work while gpus are working independently
+		nano = workloadRatios(ranges);
+
 		for (int i = 0; i < n; i++)
 		{
-			// if no work was given, give it at least single work group 
-			if (ranges[i] == 0)
-			{
-				ranges[i] = numLocalThreads;
-			}
-			totalThreads += ranges[i];
+			workers[i]->waitAllTasks();
 		}
 
+		return nano;
+	}
+
+	std::vector<double> Computer::run(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	{
+		return run(kernelId(kernelName), offsetElement, numGlobalThreads, numLocalThreads);
+	}
 
-		size_t toBeSubtracted = 0;
-		size_t toBeAdded = 0;
-		// can not compute more threads than given
-		if (totalThreads > numGlobalThreads)
+	// applies load-balancing between calls
+	std::vector<double> Computer::runMultiple(std::vector<KernelId> kernelIds, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, std::vector<std::vector<ParamId>> kernelParameterIds)
+	{
+		const int n = workers.size();
+		std::vector<double> nano(n);
+		if (listLoadBalances.find(kernelIds) == listLoadBalances.end())
 		{
-			toBeSubtracted = totalThreads - numGlobalThreads;
+			listLoadBalances[kernelIds] = std::vector<double>(n, 1.0);
 		}
 
-		// can not compute more threads than given
-		if (totalThreads < numGlobalThreads)
+		for (int i = 0; i < n; i++)
 		{
-			toBeAdded = numGlobalThreads - totalThreads;
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			auto it = workers[i]->listBenchmarks.find(kernelIds);
+			nano[i] = (it == workers[i]->listBenchmarks.end()) ? 1 : it->second;
 		}
 
-		// redistribute the remainder
-		// first devices tend to trade more of it, negligible when numGlobalThreads >> numLocalThreads
-		int tryCt = 0;
-		size_t newTotal = 0;
-		while (toBeSubtracted > 0 || toBeAdded > 0)
+		balanceLoad(nano, listLoadBalances[kernelIds], oldListLoadBalances[kernelIds], ranges, offsets, numGlobalThreads, numLocalThreads);
+
+		// compute kernels with balanced loads			
+		for (int i = 0; i < n; i++)
 		{
-			if (tryCt++ > 10)
-				break;
-			for (int i = 0; i < n; i++)
-			{
-				if (toBeSubtracted > 0 && ranges[i] > numLocalThreads)
-				{
-					ranges[i] -= numLocalThreads;
-					toBeSubtracted -= numLocalThreads;
-				}
+			workers[i]->run(KernelId(), offsetElement, offsets[i], ranges[i], numLocalThreads, true, &kernelIds, &kernelParameterIds);
+		}
 
-				if (toBeAdded > 0)
-				{
-					ranges[i] += numLocalThreads;
-					toBeAdded -= numLocalThreads;
-				}
-			}
+
+		// do some work while gpus are working independently
+		nano = workloadRatios(ranges);
+
+		for (int i = 0; i < n; i++)
+		{
+			workers[i]->waitAllTasks();
 		}
 
+		return nano;
+	}
+
+	std::vector<double> Computer::runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, std::vector<std::vector<std::string>> kernelParameterNames)
+	{
+		return runMultiple(kernelIdsOf(kernelNames), offsetElement, numGlobalThreads, numLocalThreads, parameterIdsOf(kernelParameterNames));
+	}
 
+	// applies load-balancing between replays
+	std::vector<double> Computer::run(LaunchPlan& plan)
+	{
+		const int n = workers.size();
+		std::vector<double> nano(n);
 		for (int i = 0; i < n; i++)
-			newTotal += ranges[i];
+		{
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			nano[i] = plan.workerPlans[i]->benchmark;
+		}
 
-		if (toBeSubtracted > 0 || toBeAdded > 0 || newTotal != numGlobalThreads || (newTotal / numLocalThreads) * numLocalThreads != newTotal)
+		bool strips = plan.numLaunches > 0;
+		for (auto& id : plan.kernelIds)
 		{
-			std::string err("error: load-balancing failed. check if there is enough number of local threads in global number of threads to share between all devices and global must be integer-multiple of local");
-			err += std::string(" \n  threads need to be subtracted =  ") + std::to_string(toBeSubtracted);
-			err += std::string(" \n  threads need to be added =  ") + std::to_string(toBeAdded);
-			err += std::string(" \n  total threads distributed =  ") + std::to_string(newTotal);
-			err += std::string(" \n  global threads required =  ") + std::to_string(numGlobalThreads);
-			for (int i = 0; i < n; i++)
+			if (!stripped(id))
+				strips = false;
+		}
+
+		if (strips)
+		{
+			// same strips for all launches of plan
+			balanceLoad(nano, plan.loadBalance, plan.oldLoadBalances, plan.ranges, plan.offsets, (stripRows + stripRowGranularity - 1) / stripRowGranularity, 1);
+			std::vector<GPGPU_LIB::RowRange> rows = stripRowsOf(plan.ranges, plan.offsets);
+			for (size_t i = 0; i < plan.numLaunches; i++)
 			{
-				err += std::string("\n performance of device = ");
-				err += std::to_string(workers[i]->benchmarks[kernelName]);
+				runStripLaunch(plan.kernelIds[i], plan.parameterIds[i], &plan, i, plan.offsetElement, plan.numGlobalThreads, plan.numLocalThreads, rows, plan.rows);
 			}
-			throw std::invalid_argument(err);
+			return workloadRatios(plan.ranges);
 		}
 
+		balanceLoad(nano, plan.loadBalance, plan.oldLoadBalances, plan.ranges, plan.offsets, plan.numGlobalThreads, plan.rows.granularity(plan.numLocalThreads));
 
-		// compute offsets
-		size_t curOfs = 0;
 		for (int i = 0; i < n; i++)
 		{
-			offsets[i] = curOfs;
-			curOfs += ranges[i];
+			workers[i]->run(plan.workerPlans[i].get(), plan.offsetElement, plan.offsets[i], plan.ranges[i], plan.localThreadsOfDevices[i]);
 		}
 
-		// compute kernels with balanced loads			
+		// do some work while gpus are working independently
+		nano = workloadRatios(plan.ranges);
+
 		for (int i = 0; i < n; i++)
 		{
-			workers[i]->run(kernelName, offsetElement, offsets[i], ranges[i], numLocalThreads, true, kernelNames);
+			workers[i]->waitAllTasks();
 		}
 
+		return nano;
+	}
 
-		// do some work while gpus are working independently
-		oldLoadBalnc.push_back(avg);
-		double norm = 0.0;
+	LaunchPlan Computer::createLaunchPlan(
+		std::vector<GPGPU::HostParameter> prms,
+		std::vector<KernelId> kernelIds,
+		size_t offsetElement,
+		size_t numGlobalThreads,
+		size_t numLocalThreads)
+	{
+		if (prms.size() != kernelIds.size())
+		{
+			throw std::invalid_argument(std::string("error: launch plan needs 1 parameter chain per kernel launch. chains = ") + std::to_string(prms.size()) + std::string(" kernels = ") + std::to_string(kernelIds.size()));
+		}
+
+		const int n = workers.size();
+		LaunchPlan plan;
+		plan.offsetElement = offsetElement;
+		plan.numGlobalThreads = numGlobalThreads;
+		plan.numLocalThreads = numLocalThreads;
+		plan.localThreadsOfDevices = std::vector<size_t>(n, numLocalThreads);
+		plan.numLaunches = kernelIds.size();
+		plan.loadBalance = std::vector<double>(n, 1.0);
+		plan.ranges = std::vector<size_t>(n, 1);
+		plan.offsets = std::vector<size_t>(n, 1);
+
+		std::vector<std::vector<ParamId>> kernelParameterIds;
+		for (auto& prm : prms)
+		{
+			kernelParameterIds.push_back(prm.prmList);
+		}
+		plan.kernelIds = kernelIds;
+		plan.parameterIds = kernelParameterIds;
 
 		for (int i = 0; i < n; i++)
 		{
-			nano[i] = ranges[i];
-			norm += ranges[i];
+			plan.workerPlans.push_back(workers[i]->createLaunchPlan(kernelIds, kernelParameterIds));
+		}
+		return plan;
+	}
+
+	LaunchPlan Computer::createLaunchPlan(
+		std::vector<GPGPU::HostParameter> prms,
+		std::vector<std::string> kernelNames,
+		size_t offsetElement,
+		size_t numGlobalThreads,
+		size_t numLocalThreads)
+	{
+		return createLaunchPlan(prms, kernelIdsOf(kernelNames), offsetElement, numGlobalThreads, numLocalThreads);
+	}
+
+	GPGPU_LIB::LaunchRows Computer::launchRowsOf(Size2D offset, Size2D numGlobalThreads, Size2D numLocalThreads)
+	{
+		if (numLocalThreads.x == 0 || numLocalThreads.y == 0 || numGlobalThreads.x % numLocalThreads.x != 0 || numGlobalThreads.y % numLocalThreads.y != 0)
+		{
+			throw std::invalid_argument(std::string("error: 2D global size ") + std::to_string(numGlobalThreads.x) + std::string("x") + std::to_string(numGlobalThreads.y) +
+				std::string(" has to be integer-multiple of local size ") + std::to_string(numLocalThreads.x) + std::string("x") + std::to_string(numLocalThreads.y));
 		}
+		return GPGPU_LIB::LaunchRows(numGlobalThreads.x, numLocalThreads.x, offset.x);
+	}
 
+	LaunchPlan Computer::createLaunchPlan(
+		std::vector<GPGPU::HostParameter> prms,
+		std::vector<KernelId> kernelIds,
+		Size2D offset,
+		Size2D numGlobalThreads,
+		Size2D numLocalThreads)
+	{
+		const GPGPU_LIB::LaunchRows launchRows = launchRowsOf(offset, numGlobalThreads, numLocalThreads);
+		LaunchPlan plan = createLaunchPlan(prms, kernelIds, offset.y * numGlobalThreads.x, numGlobalThreads.x * numGlobalThreads.y, numLocalThreads.x * numLocalThreads.y);
+		plan.rows = launchRows;
+		for (auto& workerPlan : plan.workerPlans)
+			workerPlan->rows = launchRows;
+		return plan;
+	}
+
+	LaunchPlan Computer::createLaunchPlan(
+		std::vector<GPGPU::HostParameter> prms,
+		std::vector<std::string> kernelNames,
+		Size2D offset,
+		Size2D numGlobalThreads,
+		Size2D numLocalThreads)
+	{
+		return createLaunchPlan(prms, kernelIdsOf(kernelNames), offset, numGlobalThreads, numLocalThreads);
+	}
+
+	void Computer::lastThreadRanges(std::vector<size_t>& offsetsOfDevices, std::vector<size_t>& rangesOfDevices)
+	{
+		offsetsOfDevices = offsets;
+		rangesOfDevices = ranges;
+	}
+
+	void Computer::download(HostParameter prm, int device, size_t firstElement, size_t numElements)
+	{
+		if (device < 0 || device >= (int)workers.size())
+		{
+			throw std::invalid_argument(std::string("error: device index out of range: ") + std::to_string(device));
+		}
+
+		if (!prm.id.valid() || firstElement + numElements > prm.n || prm.isScalar() || prm.isLocal())
+		{
+			throw std::invalid_argument(std::string("error: download out of range of array ") + prm.name + std::string(": ") + std::to_string(firstElement) + std::string(" + ") + std::to_string(numElements));
+		}
+
+		std::vector<GPGPU_LIB::StripTransfer> transfers = { { prm.id, firstElement * prm.elementSize, numElements * prm.elementSize, false } };
+		workers[device]->transfer(&transfers);
+		workers[device]->waitAllTasks();
+	}
+
+	void Computer::setLaunchOffsets(LaunchPlan& plan, HostParameter scalar, std::vector<unsigned int> offsets)
+	{
+		if (!scalar.isScalar() || scalar.elementSize != sizeof(unsigned int))
+		{
+			throw std::invalid_argument(std::string("error: launch offsets need an unsigned int scalar: ") + scalar.name);
+		}
+
+		if (offsets.size() != plan.numLaunches)
+		{
+			throw std::invalid_argument(std::string("error: launch plan needs 1 offset per kernel launch. offsets = ") + std::to_string(offsets.size()) + std::string(" launches = ") + std::to_string(plan.numLaunches));
+		}
+
+		// worker plans are resolved by worker threads
+		const int n = workers.size();
 		for (int i = 0; i < n; i++)
 		{
-			nano[i] /= norm;
+			workers[i]->waitAllTasks();
+			for (size_t l = 0; l < plan.numLaunches; l++)
+			{
+				GPGPU_LIB::PlannedLaunch& launch = plan.workerPlans[i]->launches[l];
+				for (size_t position = 0; position < plan.parameterIds[l].size(); position++)
+				{
+					if (plan.parameterIds[l][position] == scalar.id)
+						launch.scalarOffsets.push_back(std::make_pair((int)position, offsets[l]));
+				}
+			}
+		}
+	}
+
+	std::vector<size_t> Computer::tuneLocalThreads(LaunchPlan& plan, std::string key, std::vector<size_t> candidates, int repeats)
+	{
+		if (plan.rows.rowThreads > 0)
+		{
+			throw std::invalid_argument(std::string("error: work-group size of a 2D launch plan can not be tuned"));
 		}
 
+		for (auto& candidate : candidates)
+		{
+			if (candidate == 0 || plan.numLocalThreads % candidate != 0)
+			{
+				throw std::invalid_argument(std::string("error: work-group size candidate ") + std::to_string(candidate) + std::string(" does not divide ") + std::to_string(plan.numLocalThreads));
+			}
+		}
+
+		const int n = workers.size();
+		bool strips = plan.numLaunches > 0;
+		for (auto& id : plan.kernelIds)
+		{
+			if (!stripped(id))
+				strips = false;
+		}
+
+		// devices are measured on the ranges (or strips) that next replay gives them, balancing state of plan is not changed
+		std::vector<double> nano(n);
 		for (int i = 0; i < n; i++)
 		{
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			nano[i] = plan.workerPlans[i]->benchmark;
+		}
+		std::vector<double> loadBalance = plan.loadBalance;
+		std::vector<std::vector<double>> oldLoadBalances = plan.oldLoadBalances;
+		std::vector<size_t> ranges = plan.ranges;
+		std::vector<size_t> offsets = plan.offsets;
+		if (strips)
+			balanceLoad(nano, loadBalance, oldLoadBalances, ranges, offsets, (stripRows + stripRowGranularity - 1) / stripRowGranularity, 1);
+		else
+			balanceLoad(nano, loadBalance, oldLoadBalances, ranges, offsets, plan.numGlobalThreads, plan.numLocalThreads);
+		std::vector<GPGPU_LIB::RowRange> rows;
+		if (strips)
+			rows = stripRowsOf(ranges, offsets);
+
+		// buffers that plan may write (each is saved before measuring a device and restored after it)
+		std::vector<ParamId> buffers;
+		for (auto& chain : plan.parameterIds)
+		{
+			for (auto& id : chain)
+			{
+				if (id.valid() && !hostParameters[id.index].isScalar() && !hostParameters[id.index].isLocal() && std::find(buffers.begin(), buffers.end(), id) == buffers.end())
+					buffers.push_back(id);
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			size_t tuned = 0;
+			if (tuningProfile.get(workers[i]->deviceName(), key, tuned) && tuned > 0 && plan.numLocalThreads % tuned == 0)
+			{
+				plan.localThreadsOfDevices[i] = tuned;
+				continue;
+			}
+
+			// RAM copy of a buffer is replaced by the device copy while it is saved or restored
+			// changes of inputs that device did not upload yet are uploaded first (measuring would take them and restoring would lose them)
+			std::vector<std::vector<int8_t>> savedRAM(buffers.size()), savedDevice(buffers.size());
+			std::vector<GPGPU_LIB::StripTransfer> pending, downloads, uploads;
+			for (size_t k = 0; k < buffers.size(); k++)
+			{
+				HostParameter& prm = hostParameters[buffers[k].index];
+				const int dirtyDevice = workers[i]->parameters[buffers[k].index].dirtyDevice;
+				if (prm.readAllOp && prm.dirty && dirtyDevice >= 0)
+				{
+					for (auto& range : prm.dirty->take(dirtyDevice))
+						pending.push_back({ buffers[k], range.first, range.second - range.first, true });
+				}
+				savedRAM[k].assign(prm.quickPtr, prm.quickPtr + prm.n * prm.elementSize);
+				downloads.push_back({ buffers[k], 0, prm.n * prm.elementSize, false });
+				uploads.push_back({ buffers[k], 0, prm.n * prm.elementSize, true });
+			}
+			workers[i]->transfer(&pending);
+			workers[i]->transfer(&downloads);
 			workers[i]->waitAllTasks();
+			for (size_t k = 0; k < buffers.size(); k++)
+			{
+				HostParameter& prm = hostParameters[buffers[k].index];
+				savedDevice[k].assign(prm.quickPtr, prm.quickPtr + prm.n * prm.elementSize);
+			}
+			double benchmark = 0;
+			size_t work = 0;
+			{
+				std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+				benchmark = plan.workerPlans[i]->benchmark;
+				work = plan.workerPlans[i]->work;
+			}
+
+			// devices are measured 1 at a time so that they do not share RAM bandwidth or host threads
+			size_t best = plan.numLocalThreads;
+			size_t bestTime = 0;
+			for (auto& candidate : candidates)
+			{
+				size_t time = 0;
+				for (int r = 0; r < repeats + 1; r++)
+				{
+					size_t nanoseconds = 0;
+					{
+						GPGPU::Bench bench(&nanoseconds);
+						if (strips)
+						{
+							// halo rows are not exchanged, values are discarded
+							for (size_t l = 0; l < plan.numLaunches; l++)
+							{
+								size_t threadOffset = 0;
+								const size_t numThreads = stripThreadsOf(i, rows[i], kernelThreadsPerRow[plan.kernelIds[l].index], plan.numGlobalThreads, plan.numLocalThreads, threadOffset);
+								if (numThreads > 0)
+									workers[i]->runStrip(plan.workerPlans[i].get(), plan.offsetElement, threadOffset, numThreads, candidate, l, l + 1);
+							}
+						}
+						else
+						{
+							workers[i]->run(plan.workerPlans[i].get(), plan.offsetElement, offsets[i], ranges[i], candidate);
+						}
+						workers[i]->waitAllTasks();
+					}
+					// first replay warms up caches and driver
+					if (r > 0)
+						time += nanoseconds;
+				}
+				if (bestTime == 0 || time < bestTime)
+				{
+					bestTime = time;
+					best = candidate;
+				}
+			}
+			plan.localThreadsOfDevices[i] = best;
+			tuningProfile.set(workers[i]->deviceName(), key, best);
+
+			for (size_t k = 0; k < buffers.size(); k++)
+			{
+				HostParameter& prm = hostParameters[buffers[k].index];
+				std::copy(savedDevice[k].begin(), savedDevice[k].end(), prm.quickPtr);
+			}
+			workers[i]->transfer(&uploads);
+			workers[i]->waitAllTasks();
+			for (size_t k = 0; k < buffers.size(); k++)
+			{
+				HostParameter& prm = hostParameters[buffers[k].index];
+				std::copy(savedRAM[k].begin(), savedRAM[k].end(), prm.quickPtr);
+			}
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			plan.workerPlans[i]->benchmark = benchmark;
+			plan.workerPlans[i]->work = work;
 		}
+		return plan.localThreadsOfDevices;
+	}
 
-		return nano;
+	size_t Computer::tuneBatchLength(std::string key, std::vector<size_t> candidates, size_t maxNanoseconds, std::function<size_t(size_t)> runBatch)
+	{
+		if (candidates.size() == 0)
+		{
+			throw std::invalid_argument(std::string("error: no batch length candidate for ") + key);
+		}
+
+		// batches run on all devices together, so the set of devices is the profile's device
+		std::string devices;
+		for (auto& worker : workers)
+			devices += worker->deviceName() + ";";
+
+		size_t tuned = 0;
+		if (tuningProfile.get(devices, key, tuned) && tuned > 0)
+			return tuned;
+
+		std::sort(candidates.begin(), candidates.end());
+		size_t best = candidates[0];
+		for (auto& candidate : candidates)
+		{
+			if (runBatch(candidate) > maxNanoseconds)
+				break;
+			best = candidate;
+		}
+		tuningProfile.set(devices, key, best);
+		return best;
 	}
 
 	std::vector<double> Computer::compute(
 		GPGPU::HostParameter prm,
-		std::string kernelName,
+		KernelId kernelId,
 		size_t offsetElement,
 		size_t numGlobalThreads,
 		size_t numLocalThreads,
@@ -619,43 +1120,66 @@ namespace GPGPU
 		const int k = prm.prmList.size();
 		for (int i = 0; i < k; i++)
 		{
-			setKernelParameter(kernelName, prm.prmList[i], i);
+			setKernelParameter(kernelId, prm.prmList[i], i);
 		}
 
 		if (fineGrainedLoadBalancing)
-			performancesOfDevices = runFineGrainedLoadBalancing(kernelName, offsetElement, numGlobalThreads, numLocalThreads, fineGrainSize == 0 ? numLocalThreads : fineGrainSize);
+			performancesOfDevices = runFineGrainedLoadBalancing(kernelId, offsetElement, numGlobalThreads, numLocalThreads, fineGrainSize == 0 ? numLocalThreads : fineGrainSize);
 		else
-			performancesOfDevices = run(kernelName, offsetElement, numGlobalThreads, numLocalThreads);
+			performancesOfDevices = run(kernelId, offsetElement, numGlobalThreads, numLocalThreads);
 		return performancesOfDevices;
 	}
 
+	std::vector<double> Computer::compute(
+		GPGPU::HostParameter prm,
+		std::string kernelName,
+		size_t offsetElement,
+		size_t numGlobalThreads,
+		size_t numLocalThreads,
+		bool fineGrainedLoadBalancing,
+		size_t fineGrainSize)
+	{
+		return compute(prm, kernelId(kernelName), offsetElement, numGlobalThreads, numLocalThreads, fineGrainedLoadBalancing, fineGrainSize);
+	}
+
+	std::vector<double> Computer::compute(
+		GPGPU::HostParameter prm,
+		KernelId kernelId,
+		Size2D offset,
+		Size2D numGlobalThreads,
+		Size2D numLocalThreads)
+	{
+		const GPGPU_LIB::LaunchRows launchRows = launchRowsOf(offset, numGlobalThreads, numLocalThreads);
+		const int k = prm.prmList.size();
+		for (int i = 0; i < k; i++)
+		{
+			setKernelParameter(kernelId, prm.prmList[i], i);
+		}
+		return runKernel(kernelId, offset.y * numGlobalThreads.x, numGlobalThreads.x * numGlobalThreads.y, numLocalThreads.x * numLocalThreads.y, launchRows);
+	}
+
+	std::vector<double> Computer::compute(
+		GPGPU::HostParameter prm,
+		std::string kernelName,
+		Size2D offset,
+		Size2D numGlobalThreads,
+		Size2D numLocalThreads)
+	{
+		return compute(prm, kernelId(kernelName), offset, numGlobalThreads, numLocalThreads);
+	}
+
 	std::vector<double> Computer::computeMultiple(
 		std::vector<GPGPU::HostParameter> prms,
-		std::vector<std::string> kernelNames,
+		std::vector<KernelId> kernelIds,
 		size_t offsetElement,
 		size_t numGlobalThreads,
 		size_t numLocalThreads,
 		bool fineGrainedLoadBalancing,
 		size_t fineGrainSize)
 	{
-		std::map<std::string, bool> isSet;
 		std::vector<double> performancesOfDevices;
 		const int n = prms.size();
 
-		for (int i = 0; i < n; i++)
-		{
-			auto kernIt = isSet.find(kernelNames[i]);
-			if (kernIt == isSet.end())
-			{
-				const int k = prms[i].prmList.size();
-				for (int j = 0; j < k; j++)
-				{
-					setKernelParameter(kernelNames[i], prms[i].prmList[j], j);
-				}
-				isSet.emplace(kernelNames[i], true);
-			}
-		}
-
 		if (fineGrainedLoadBalancing)
 		{
 			const int nw = workers.size();
@@ -666,7 +1190,13 @@ namespace GPGPU
 			}
 			for (int i = 0; i < n; i++)
 			{
-				auto performancesOfDevicesTmp = runFineGrainedLoadBalancing(kernelNames[i], offsetElement, numGlobalThreads, numLocalThreads, fineGrainSize == 0 ? numLocalThreads : fineGrainSize);
+				// each launch is a separate call so its chain can be bound directly (only changed positions are sent to workers)
+				const int k = prms[i].prmList.size();
+				for (int j = 0; j < k; j++)
+				{
+					setKernelParameter(kernelIds[i], prms[i].prmList[j], j);
+				}
+				auto performancesOfDevicesTmp = runFineGrainedLoadBalancing(kernelIds[i], offsetElement, numGlobalThreads, numLocalThreads, fineGrainSize == 0 ? numLocalThreads : fineGrainSize);
 				for (int j = 0; j < nw; j++)
 					performancesOfDevices[j] += performancesOfDevicesTmp[j];
 			}
@@ -675,12 +1205,60 @@ namespace GPGPU
 		}
 		else
 		{
-			performancesOfDevices = runMultiple(kernelNames, offsetElement, numGlobalThreads, numLocalThreads);
+			// first chain of each kernel is bound before the run, later chains that differ from the previous launch of same kernel are re-bound by workers in-order
+			std::map<KernelId, std::vector<ParamId>> lastChain;
+			std::vector<std::vector<ParamId>> kernelParameterIds;
+			for (int i = 0; i < n; i++)
+			{
+				auto kernIt = lastChain.find(kernelIds[i]);
+				if (kernIt == lastChain.end())
+				{
+					const int k = prms[i].prmList.size();
+					for (int j = 0; j < k; j++)
+					{
+						setKernelParameter(kernelIds[i], prms[i].prmList[j], j);
+					}
+					lastChain.emplace(kernelIds[i], prms[i].prmList);
+				}
+				else if (kernIt->second != prms[i].prmList)
+				{
+					if (kernelParameterIds.size() == 0)
+						kernelParameterIds.resize(n);
+					kernelParameterIds[i] = prms[i].prmList;
+					kernIt->second = prms[i].prmList;
+				}
+			}
+
+			performancesOfDevices = runMultiple(kernelIds, offsetElement, numGlobalThreads, numLocalThreads, kernelParameterIds);
+
+			// workers end up with last chain of each kernel bound
+			if (kernelParameterIds.size() > 0)
+			{
+				for (auto& chain : lastChain)
+				{
+					std::vector<ParamId>& boundParameters = kernelParameters[chain.first.index];
+					if (boundParameters.size() < chain.second.size())
+						boundParameters.resize(chain.second.size());
+					std::copy(chain.second.begin(), chain.second.end(), boundParameters.begin());
+				}
+			}
 		}
 
 		return performancesOfDevices;
 	}
 
+	std::vector<double> Computer::computeMultiple(
+		std::vector<GPGPU::HostParameter> prms,
+		std::vector<std::string> kernelNames,
+		size_t offsetElement,
+		size_t numGlobalThreads,
+		size_t numLocalThreads,
+		bool fineGrainedLoadBalancing,
+		size_t fineGrainSize)
+	{
+		return computeMultiple(prms, kernelIdsOf(kernelNames), offsetElement, numGlobalThreads, numLocalThreads, fineGrainedLoadBalancing, fineGrainSize);
+	}
+
 	std::vector<std::string> Computer::deviceNames(bool detailed)
 	{
 		std::vector<std::string> names;
@@ -693,4 +1271,46 @@ namespace GPGPU
 		}
 		return names;
 	}
-}
\ No newline at end of file
+
+	std::vector<size_t> Computer::deviceLocalMemorySizes()
+	{
+		std::vector<size_t> sizes;
+		for (int i = 0; i < workers.size(); i++)
+		{
+			sizes.push_back(workers[i]->deviceLocalMemorySize());
+		}
+		return sizes;
+	}
+
+	std::map<std::string, CommandStatistics> Computer::profile()
+	{
+		std::map<std::string, CommandStatistics> statistics;
+		for (auto& device : profileOfDevices())
+		{
+			for (auto& command : device)
+			{
+				statistics[command.first].merge(command.second);
+			}
+		}
+		return statistics;
+	}
+
+	std::vector<std::map<std::string, CommandStatistics>> Computer::profileOfDevices()
+	{
+		std::vector<std::map<std::string, CommandStatistics>> statistics;
+		for (int i = 0; i < workers.size(); i++)
+		{
+			statistics.push_back(workers[i]->queue.profile ? workers[i]->queue.profile->get() : std::map<std::string, CommandStatistics>());
+		}
+		return statistics;
+	}
+
+	void Computer::resetProfile()
+	{
+		for (int i = 0; i < workers.size(); i++)
+		{
+			if (workers[i]->queue.profile)
+				workers[i]->queue.profile->reset();
+		}
+	}
+}
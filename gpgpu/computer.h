@@ -7,6 +7,8 @@
 #include "gpgpu_init.hpp"
 #include "worker.h"
 #include "platform.h"
+#include "tuning-profile.h"
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
@@ -23,18 +25,63 @@ namespace GPGPU
 		const static int DEVICE_SELECTION_ALL = -1;
 
 	private:
-		std::map<std::string, std::vector<double>> loadBalances;
+		// per KernelId
+		std::vector<std::vector<double>> loadBalances;
+		std::vector<std::vector<std::vector<double>>> oldLoadBalances;
+		// per kernel list of runMultiple
+		std::map<std::vector<KernelId>, std::vector<double>> listLoadBalances;
+		std::map<std::vector<KernelId>, std::vector<std::vector<double>>> oldListLoadBalances;
 		std::vector<size_t> offsets;
 		std::vector<size_t> ranges;
-		std::map<std::string, std::vector<std::vector<double>>> oldLoadBalances;
 
 		GPGPU_LIB::PlatformManager platform;
 		std::vector<std::shared_ptr<GPGPU_LIB::Worker>> workers;
-		std::map<std::string, GPGPU::HostParameter> hostParameters;
-		std::mutex compileLock; // serialize device code compilations
+		std::vector<GPGPU::HostParameter> hostParameters; // per ParamId
+		std::string kernelCacheDirectory; // compiled binaries of kernels (empty = always compiled from source)
+		GPGPU_LIB::TuningProfile tuningProfile; // winners of tuneLocalThreads and tuneBatchLength
 
-		// kernel to parameters to position mapping
-		std::map<std::string, std::map<std::string, int>> kernelParameters;
+		// name to handle mapping (only used by the overloads that take names)
+		std::map<std::string, KernelId> kernelIds;
+		std::map<std::string, ParamId> parameterIds;
+
+		// bound parameter per argument position of each kernel (per KernelId)
+		std::vector<std::vector<ParamId>> kernelParameters;
+
+		// argument positions that kernel can write (per KernelId)
+		std::vector<std::vector<bool>> kernelWrites;
+
+		// horizontal strips of a 2D grid (setStrips), ranges/offsets are in units of stripRowGranularity rows
+		size_t stripRows;
+		size_t stripRowGranularity;
+		std::vector<size_t> stripRanges;
+		std::vector<size_t> stripOffsets;
+		std::vector<size_t> kernelThreadsPerRow; // per KernelId (0 = kernel is not split into strips)
+		std::vector<GPGPU_LIB::StripParameter> stripParameters; // per ParamId
+
+		// handle of kernel name (new handle for a new name, arguments are unbound for a re-compiled name)
+		KernelId kernelSlot(std::string kernelName);
+
+		// kernel is run as strips of rows (multiple devices, strips are set and kernel has threads per row)
+		bool stripped(KernelId kernelId);
+
+		// rows of devices from strip ranges/offsets
+		std::vector<GPGPU_LIB::RowRange> stripRowsOf(std::vector<size_t>& rangesOfDevices, std::vector<size_t>& offsetsOfDevices);
+
+		// threads of strip of a device (multiple of granularity inside global range), sets threadOffset
+		size_t stripThreadsOf(int device, const GPGPU_LIB::RowRange& rows, size_t threadsPerRow, size_t numGlobalThreads, size_t granularity, size_t& threadOffset);
+
+		// exchanges halo rows of parameters in chain, runs kernel (or launch of plan) on strips of devices, copies outputs of strips and waits
+		// launchRows: 2D launch (its rows are the rows of strips)
+		void runStripLaunch(KernelId kernelId, const std::vector<ParamId>& chain, LaunchPlan* plan, size_t launchIndex, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, const std::vector<GPGPU_LIB::RowRange>& rows, const GPGPU_LIB::LaunchRows& launchRows);
+
+		// run of a 1D or 2D launch (2D launches are balanced in whole rows of work-groups)
+		std::vector<double> runKernel(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, const GPGPU_LIB::LaunchRows& launchRows);
+
+		// checks sizes of a 2D launch
+		static GPGPU_LIB::LaunchRows launchRowsOf(Size2D offset, Size2D numGlobalThreads, Size2D numLocalThreads);
+
+		// updates load-balancing ratios from last run times (nanoseconds per device) and computes ranges/offsets of devices for next run
+		void balanceLoad(std::vector<double> runTimes, std::vector<double>& selectedKernelLB, std::vector<std::vector<double>>& oldLoadBalnc, std::vector<size_t>& rangesOfDevices, std::vector<size_t>& offsetsOfDevices, size_t numGlobalThreads, size_t numLocalThreads);
 		/*
 			deviceSelection = Computer::DEVICE_ALL ==> uses all gpu & cpu devices
 
@@ -51,16 +98,40 @@ namespace GPGPU
 			true = CPU gets direct RAM access
 			false = iGPU gets direct RAM access
 			the other one works same as a discrete device
+		outOfOrderQueues: lets devices run commands (copies, kernels) in any order that respects their buffer dependencies, if device supports it. Commands that use different buffers can overlap.
+		profiling: devices measure run time of each kernel and copy (see profile()), adds a completion callback per command
 		*/
-		Computer(int deviceSelection, int selectionIndex = DEVICE_SELECTION_ALL, int clonesPerDevice = 1, bool giveDirectRamAccessToCPU=true, int maxDevices=100);
+		Computer(int deviceSelection, int selectionIndex = DEVICE_SELECTION_ALL, int clonesPerDevice = 1, bool giveDirectRamAccessToCPU=true, int maxDevices=100, bool outOfOrderQueues=false, bool profiling=false);
 
 		// returns number of queried devices (sum of devices from all platforms)
 		int getNumDevices();
 
 		/* compiles kernel code for given kernel name(that needs to be same as the function name in the kernel code) for all devices
 		* not thread-safe between multiple Computer objects
+		* returns handle of kernel to be used instead of its name (compiling same name again keeps the handle)
+		*/
+		KernelId compile(std::string kernelCode, std::string kernelName);
+
+		/* compiles kernel code that has many kernels into 1 program per device, devices compile at the same time
+		* returns handles of kernels on same order as kernelNames
+		*/
+		std::vector<KernelId> compile(std::string kernelCode, std::vector<std::string> kernelNames);
+
+		/* directory that compiled binaries are saved to and loaded from by compile() (default: "gpgpu-kernel-cache" in working directory)
+		* a binary is re-used only for same kernel code, kernel name, build options, device and driver version, otherwise kernel is compiled from source
+		* empty = no caching
 		*/
-		void compile(std::string kernelCode, std::string kernelName);
+		void setKernelCacheDirectory(std::string directory);
+
+		// returns handle of a compiled kernel
+		KernelId kernelId(std::string kernelName);
+
+		// returns handle of a created parameter
+		ParamId parameterId(std::string parameterName);
+
+		// handles of kernels/parameter chains given by names
+		std::vector<KernelId> kernelIdsOf(std::vector<std::string> kernelNames);
+		std::vector<std::vector<ParamId>> parameterIdsOf(std::vector<std::vector<std::string>> parameterNames);
 
 		/* 
 		parameterName: parameter's name that is used when binding to kernel by setKernelParameter() or by method chaining ( computer.compute(  a.next(b).next(c), "kernelName",..   )  )
@@ -71,16 +142,39 @@ namespace GPGPU
 		isOutput=true ==> this parameter's devices' data are copied to host after kernel is run (each device copies its own regio)
 		isInputWithAllElements=true ==> whole buffer is read instead of thread's own region when isInput=true. This is useful when all devices need a copy of whole array.
 		!!! host parameter can only be input-only or output-only (currently) (because this lets all devices run independently without extra synchronization cost) !!!
+		returned host parameter carries its handle (getId()), creating same name again keeps the handle
 		*/
 		template<typename T>
-		HostParameter createHostParameter(std::string parameterName, size_t numElements, size_t numElementsPerThread, bool isInput, bool isOutput, bool isInputWithAllElements,bool isOutputWithAllElements, bool isScalar)
+		HostParameter createHostParameter(std::string parameterName, size_t numElements, size_t numElementsPerThread, bool isInput, bool isOutput, bool isInputWithAllElements,bool isOutputWithAllElements, bool isScalar, bool isLocal = false, size_t numThreadsPerGroup = 1)
 		{
-			hostParameters[parameterName] = HostParameter(parameterName, numElements, sizeof(T), numElementsPerThread, isInput, isOutput, isInputWithAllElements,isOutputWithAllElements,isScalar);
+			ParamId id(hostParameters.size());
+			auto it = parameterIds.find(parameterName);
+			if (it == parameterIds.end())
+			{
+				parameterIds[parameterName] = id;
+				hostParameters.push_back(HostParameter());
+			}
+			else
+			{
+				id = it->second;
+
+				// re-created parameter has a new buffer, kernels that were bound to old one are bound again on next setKernelParameter
+				for (auto& boundParameters : kernelParameters)
+				{
+					for (auto& bound : boundParameters)
+					{
+						if (bound == id)
+							bound = ParamId();
+					}
+				}
+			}
+
+			hostParameters[id.index] = HostParameter(parameterName, numElements, sizeof(T), numElementsPerThread, isInput, isOutput, isInputWithAllElements,isOutputWithAllElements,isScalar,id,isLocal,numThreadsPerGroup);
 			for (int i = 0; i < workers.size(); i++)
 			{
-				workers[i]->mirror(&hostParameters[parameterName]);
+				workers[i]->mirror(&hostParameters[id.index]);
 			}
-			return hostParameters[parameterName];
+			return hostParameters[id.index];
 		}
 
 		// creates a single item - array on host side but a scalar on device side
@@ -130,10 +224,66 @@ namespace GPGPU
 			return createHostParameter<T>(parameterName, numElements, numElementsPerThread, false, false, false,false,false);
 		}
 
+		// creates local memory argument of numElements elements per work-group (cl::Local), it has no buffer and no host data
+		// use for tiles that work-items of a group share, when the tile size is picked on host (such as from work-group size of a 2D launch)
+		template<typename T>
+		HostParameter createLocalArray(std::string parameterName, size_t numElements)
+		{
+			return createHostParameter<T>(parameterName, numElements, 1, false, false, false, false, false, true);
+		}
+
+		// creates input array of numElementsPerGroup elements per numThreadsPerGroup work-items, devices get only elements of their own work-groups
+		// numThreadsPerGroup has to be the local threads of launches that use it (such as 1 offset per work-group that is computed on host)
+		template<typename T>
+		HostParameter createArrayInputPerGroup(std::string parameterName, size_t numElements, size_t numThreadsPerGroup, size_t numElementsPerGroup = 1)
+		{
+			return createHostParameter<T>(parameterName, numElements, numElementsPerGroup, true, false, false, false, false, false, numThreadsPerGroup);
+		}
+
+		// creates output array of numElementsPerGroup elements per numThreadsPerGroup work-items, devices copy only elements of their own work-groups
+		// use for per-work-group partial results (such as reductions) that are combined on host
+		template<typename T>
+		HostParameter createArrayOutputPerGroup(std::string parameterName, size_t numElements, size_t numThreadsPerGroup, size_t numElementsPerGroup = 1)
+		{
+			return createHostParameter<T>(parameterName, numElements, numElementsPerGroup, false, true, false, false, false, false, numThreadsPerGroup);
+		}
+
+		// creates 2 device-side state arrays (parameterName and parameterName + "2") that are ping-ponged as current/next buffers
+		// computeMultiple re-binds kernel arguments when same kernel is given a different parameter chain in the list (such as a swapped pair)
+		template<typename T>
+		DoubleBuffer createArrayStateDoubleBuffer(std::string parameterName, size_t numElements, size_t numElementsPerThread = 1)
+		{
+			HostParameter first = createArrayState<T>(parameterName, numElements, numElementsPerThread);
+			HostParameter second = createArrayState<T>(parameterName + "2", numElements, numElementsPerThread);
+			return DoubleBuffer(first, second);
+		}
+
+		/*
+			splits a 2D grid of numRows rows into horizontal strips (1 per device) for kernels that have threads per row (setKernelStrips)
+			strip heights are multiples of rowGranularity and are load-balanced like thread ranges, only used when there are multiple devices
+			every device keeps its own copy of whole grid but computes only its strip, rows that its kernels read from other strips (halo) are copied through RAM before launch
+			kernels that write strip parameters have to be strip kernels (so that owners of rows are known)
+		*/
+		void setStrips(size_t numRows, size_t rowGranularity);
+
+		// numThreadsPerRow: threads of kernel that compute 1 row of grid (0 = kernel is not split into strips)
+		// a strip launch can be rounded up to a multiple of local threads, extra threads compute rows of other strips (their results are not used)
+		void setKernelStrips(KernelId kernelId, size_t numThreadsPerRow);
+		void setKernelStrips(std::string kernelName, size_t numThreadsPerRow);
+
+		// elementsPerRow: elements of parameter per row of grid, haloRows: rows above and below a strip that kernels read
+		// planes: parameter is planes grids one after another
+		// firstElement: element of first row (for grids that have a border row or padding before first row)
+		// outputs with all elements are copied per strip
+		void setParameterStrips(ParamId parameterId, size_t elementsPerRow, size_t haloRows, size_t planes = 1, size_t firstElement = 0);
+		void setParameterStrips(std::string parameterName, size_t elementsPerRow, size_t haloRows, size_t planes = 1, size_t firstElement = 0);
+
 		// binds a parameter to a kernel at parameterPosition-th position
+		void setKernelParameter(KernelId kernelId, ParamId parameterId, int parameterPosition);
 		void setKernelParameter(std::string kernelName, std::string parameterName, int parameterPosition);
 
 		// applies load-balancing inside each call (better for uneven workloads per work-item)
+		std::vector<double>  runFineGrainedLoadBalancing(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize);
 		std::vector<double>  runFineGrainedLoadBalancing(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize);
 		std::vector<double>  runFineGrainedLoadBalancingMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, size_t loadSize);
 
@@ -141,11 +291,22 @@ namespace GPGPU
 			applies load - balancing between calls(better for even workloads per work - item)
 			returns workload ratios of devices (on the same order their names appear on deviceNames())
 		*/
+		std::vector<double> run(KernelId kernelId, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads);
 		std::vector<double> run(std::string kernelName, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads);
-		std::vector<double> runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads);
+		// kernelParameterIds: optional per-launch parameter chains to re-bind before launching (empty chain = keep current binding)
+		std::vector<double> runMultiple(std::vector<KernelId> kernelIds, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, std::vector<std::vector<ParamId>> kernelParameterIds = std::vector<std::vector<ParamId>>());
+		std::vector<double> runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads, std::vector<std::vector<std::string>> kernelParameterNames = std::vector<std::vector<std::string>>());
 
 		// works same as run with default parameters of fineGrainedLoadBalancing = false and fineGrainSize = 0
 		// works same as runFineGrainedLoadBalancing with fineGrainedLoadBalancing = true (which sets fineGrainSize = numLocalThreads that may not be optimal for performance for too high global threads)
+		std::vector<double> compute(
+			GPGPU::HostParameter prm,
+			KernelId kernelId,
+			size_t offsetElement,
+			size_t numGlobalThreads,
+			size_t numLocalThreads,
+			bool fineGrainedLoadBalancing = false,
+			size_t fineGrainSize = 0);
 		std::vector<double> compute(
 			GPGPU::HostParameter prm,
 			std::string kernelName,
@@ -155,6 +316,33 @@ namespace GPGPU
 			bool fineGrainedLoadBalancing = false,
 			size_t fineGrainSize = 0);
 
+		/* 2D launch: work-items are get_global_id(0) = offset.x + column, get_global_id(1) = offset.y + row and work-groups are numLocalThreads.x x numLocalThreads.y
+		* devices get bands of whole rows of work-groups (load-balanced between calls), kernels that are split into strips get the rows of their strips (numThreadsPerRow of setKernelStrips has to be numGlobalThreads.x)
+		* inputs/outputs that are not all elements are copied per band of rows with numGlobalThreads.x threads per row
+		*/
+		std::vector<double> compute(
+			GPGPU::HostParameter prm,
+			KernelId kernelId,
+			Size2D offset,
+			Size2D numGlobalThreads,
+			Size2D numLocalThreads);
+		std::vector<double> compute(
+			GPGPU::HostParameter prm,
+			std::string kernelName,
+			Size2D offset,
+			Size2D numGlobalThreads,
+			Size2D numLocalThreads);
+
+		// runs kernels in given order with their own parameter chains
+		// if a kernel appears with different chains (i.e. DoubleBuffer current/next swapped), its arguments are re-bound before each such launch
+		std::vector<double> computeMultiple(
+			std::vector<GPGPU::HostParameter> prm,
+			std::vector<KernelId> kernelId,
+			size_t offsetElement,
+			size_t numGlobalThreads,
+			size_t numLocalThreads,
+			bool fineGrainedLoadBalancing = false,
+			size_t fineGrainSize = 0);
 		std::vector<double> computeMultiple(
 			std::vector<GPGPU::HostParameter> prm,
 			std::vector<std::string> kernelName,
@@ -164,8 +352,88 @@ namespace GPGPU
 			bool fineGrainedLoadBalancing = false,
 			size_t fineGrainSize = 0);
 
+		// resolves a kernel list with its parameter chains (same as computeMultiple without fine-grained load-balancing) once on all devices
+		// replaying it with run(plan) does not look up anything by name, only its load-balancing is computed per replay
+		// parameters and kernels have to be created/compiled before
+		LaunchPlan createLaunchPlan(
+			std::vector<GPGPU::HostParameter> prm,
+			std::vector<KernelId> kernelId,
+			size_t offsetElement,
+			size_t numGlobalThreads,
+			size_t numLocalThreads);
+		LaunchPlan createLaunchPlan(
+			std::vector<GPGPU::HostParameter> prm,
+			std::vector<std::string> kernelName,
+			size_t offsetElement,
+			size_t numGlobalThreads,
+			size_t numLocalThreads);
+
+		// launch plan of 2D launches (same sizes for all launches, see 2D compute)
+		LaunchPlan createLaunchPlan(
+			std::vector<GPGPU::HostParameter> prm,
+			std::vector<KernelId> kernelId,
+			Size2D offset,
+			Size2D numGlobalThreads,
+			Size2D numLocalThreads);
+		LaunchPlan createLaunchPlan(
+			std::vector<GPGPU::HostParameter> prm,
+			std::vector<std::string> kernelName,
+			Size2D offset,
+			Size2D numGlobalThreads,
+			Size2D numLocalThreads);
+
+		// replays a launch plan, applies load-balancing between replays
+		// plans of strip kernels are replayed 1 launch at a time on all devices (halo rows are exchanged between launches)
+		// returns workload ratios of devices (on the same order their names appear on deviceNames())
+		std::vector<double> run(LaunchPlan& plan);
+
+		// thread offsets and numbers of threads that devices got in last 1D run or compute (without strips), on the same order as deviceNames()
+		void lastThreadRanges(std::vector<size_t>& offsetsOfDevices, std::vector<size_t>& rangesOfDevices);
+
+		// copies numElements elements of an array from a device (on the same order as deviceNames()) to RAM, starting from element firstElement, and waits
+		// for arrays that kernels write at positions known only after they run (such as dense result of a stream compaction)
+		void download(HostParameter prm, int device, size_t firstElement, size_t numElements);
+
+		/* launch i of plan gets value of scalar + offsets[i] wherever scalar is an argument (for example step number of each launch from 1 base step per replay)
+		* scalar has to be an unsigned int, offsets has 1 value per launch
+		*/
+		void setLaunchOffsets(LaunchPlan& plan, HostParameter scalar, std::vector<unsigned int> offsets);
+
+		/* picks fastest work-group size of a launch plan for each device, later replays of plan use it
+		* candidates have to divide numLocalThreads of plan (load-balancing still distributes multiples of numLocalThreads), plan has to be 1D
+		* each device replays plan alone on the range (or strip of rows) that next replay gives it (repeats times per candidate)
+		* buffers of plan are saved before and restored after measuring a device, so replays after tuning compute the same values
+		* winners are saved to tuning profile under key and device name, then later calls with same key only load them
+		* returns work-group size per device (on the same order their names appear on deviceNames())
+		*/
+		std::vector<size_t> tuneLocalThreads(LaunchPlan& plan, std::string key, std::vector<size_t> candidates, int repeats = 3);
+
+		/* picks longest batch that runs in maxNanoseconds on all devices together (for example number of steps per frame)
+		* runBatch runs a batch of given length and returns its nanoseconds, candidates are tried on increasing order until one takes longer (first candidate is picked if none fits)
+		* winner is saved to tuning profile under key and names of all devices, then later calls with same key only load it
+		*/
+		size_t tuneBatchLength(std::string key, std::vector<size_t> candidates, size_t maxNanoseconds, std::function<size_t(size_t)> runBatch);
+
+		/* text file that tuneLocalThreads and tuneBatchLength save winners to (default: "gpgpu-tuning-profile.txt" in working directory)
+		* empty = always benchmarked
+		*/
+		void setTuningProfileFile(std::string fileName);
+
 		// returns list of device names with their opencl version support
 		std::vector<std::string> deviceNames(bool detailed = true);
+
+		// returns local memory sizes (bytes per work-group) of devices (on the same order their names appear on deviceNames())
+		std::vector<size_t> deviceLocalMemorySizes();
+
+		// device-side statistics per kernel name (and PROFILE_UPLOAD, PROFILE_DOWNLOAD for copies) of all devices, empty if profiling is not enabled
+		// commands that completed recently may not be added yet
+		std::map<std::string, CommandStatistics> profile();
+
+		// profile() per device (on the same order their names appear on deviceNames())
+		std::vector<std::map<std::string, CommandStatistics>> profileOfDevices();
+
+		// clears statistics of all devices
+		void resetProfile();
 	};
 }
 #endif // !GPGPU_COMPUTER_LIB
\ No newline at end of file
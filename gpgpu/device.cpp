@@ -7,6 +7,7 @@ namespace GPGPU_LIB
 		device = dev;
 		id = idPrm;
 		isCPU = isCPUPrm;
+		localMemorySize = 0;
 		cl_int op;
 		if (id != -1)
 		{
@@ -55,6 +56,12 @@ namespace GPGPU_LIB
 					ver = 120;
 			}
 
+			localMemorySize = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>(&op);
+			if (op != CL_SUCCESS)
+			{
+				throw std::invalid_argument(std::string("error: device local memory size query") + getErrorString(op));
+			}
+
 		}
 		else
 		{
@@ -14,6 +14,7 @@ namespace GPGPU_LIB
 		int ver;
 		bool sharesRAM;
 		bool isCPU;
+		size_t localMemorySize; // bytes of local (shared) memory per work-group
 
 		std::string simpleName;
 		std::string name;
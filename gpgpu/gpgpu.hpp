@@ -8,5 +8,8 @@
 #include "worker.h"
 #include "kernel.h"
 #include "command-queue.h"
+#include "profile.h"
+#include "launch-plan.h"
 #include "computer.h"
+#include "primitives.h"
 // todo: add error-checking for all operations
\ No newline at end of file
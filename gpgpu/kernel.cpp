@@ -1,7 +1,25 @@
 #include "kernel.h"
 namespace GPGPU_LIB
 {
-	Kernel::Kernel(Context con, std::string kernelCode, std::string kernelName )
+	// all arguments are assumed to be written when driver does not give qualifiers
+	static std::vector<bool> argumentWrites(cl::Kernel& kernel)
+	{
+		std::vector<bool> writes;
+		const cl_uint numArgs = kernel.getInfo<CL_KERNEL_NUM_ARGS>();
+		for (cl_uint i = 0; i < numArgs; i++)
+		{
+			cl_int addressOp = 0;
+			cl_int typeOp = 0;
+			cl_kernel_arg_address_qualifier address = kernel.getArgInfo<CL_KERNEL_ARG_ADDRESS_QUALIFIER>(i, &addressOp);
+			cl_kernel_arg_type_qualifier type = kernel.getArgInfo<CL_KERNEL_ARG_TYPE_QUALIFIER>(i, &typeOp);
+			const bool known = (addressOp == CL_SUCCESS && typeOp == CL_SUCCESS);
+			const bool readOnly = known && (address == CL_KERNEL_ARG_ADDRESS_PRIVATE || address == CL_KERNEL_ARG_ADDRESS_CONSTANT || (type & CL_KERNEL_ARG_TYPE_CONST));
+			writes.push_back(!readOnly);
+		}
+		return writes;
+	}
+
+	Kernel::Kernel(Context con, std::string kernelCode, std::string kernelName, std::string cacheDirectory)
 	{
 		isRunning = false;
 		code = kernelCode;
@@ -13,32 +31,73 @@ namespace GPGPU_LIB
 		}
 		else
 		{
-			cl::Program::Sources source;
-			source.push_back(code);
-			cl::Program program(con.context, source);
-			cl_int op = 0;
-			if (con.device.ver >= 300)
-			{
-				op = program.build(con.device.device, "-cl-std=CL3.0 -cl-mad-enable");
-			}
-			else if (con.device.ver >= 200)
-			{
-				op = program.build(con.device.device, "-cl-std=CL2.0 -cl-mad-enable");
-			}
-			else if (con.device.ver >= 120)
-			{
-				op = program.build(con.device.device, "-cl-std=CL1.2 -cl-mad-enable");
-			}
+			*this = compile(con, kernelCode, { kernelName }, cacheDirectory)[0];
+		}
+	}
 
+	Kernel::Kernel(Context con, cl::Program& program, std::string kernelCode, std::string kernelName, std::vector<bool> writesPrm)
+	{
+		isRunning = false;
+		code = kernelCode;
+		name = kernelName;
+		context = con;
+		writes = writesPrm;
 
-			if (op == CL_SUCCESS)
-			{
-				kernel = cl::Kernel(program, name.c_str());
-			}
-			else
+		cl_int op = CL_SUCCESS;
+		kernel = cl::Kernel(program, name.c_str(), &op);
+		if (op != CL_SUCCESS)
+		{
+			throw std::invalid_argument(std::string("kernel creation error: kernel name=") + name + std::string(" error-code=") + getErrorString(op));
+		}
+	}
+
+	std::vector<Kernel> Kernel::compile(Context con, std::string kernelCode, std::vector<std::string> kernelNames, std::string cacheDirectory)
+	{
+		std::string options;
+		if (con.device.ver >= 300)
+		{
+			options = "-cl-std=CL3.0 -cl-mad-enable -cl-kernel-arg-info";
+		}
+		else if (con.device.ver >= 200)
+		{
+			options = "-cl-std=CL2.0 -cl-mad-enable -cl-kernel-arg-info";
+		}
+		else if (con.device.ver >= 120)
+		{
+			options = "-cl-std=CL1.2 -cl-mad-enable -cl-kernel-arg-info";
+		}
+
+		std::vector<Kernel> kernels;
+		ProgramCache cache(cacheDirectory);
+		cl::Program program;
+		std::vector<std::vector<bool>> writes;
+		if (cache.load(con, kernelCode, kernelNames, options, program, writes))
+		{
+			for (size_t i = 0; i < kernelNames.size(); i++)
 			{
-				throw std::invalid_argument(std::string("program build error: error-code=") + getErrorString(op) + std::string(" --> ") + program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(con.device.device));
+				kernels.push_back(Kernel(con, program, kernelCode, kernelNames[i], writes[i]));
 			}
+			return kernels;
+		}
+
+		cl::Program::Sources source;
+		source.push_back(kernelCode);
+		program = cl::Program(con.context, source);
+		cl_int op = program.build(con.device.device, options.c_str());
+		if (op != CL_SUCCESS)
+		{
+			throw std::invalid_argument(std::string("program build error: error-code=") + getErrorString(op) + std::string(" --> ") + program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(con.device.device));
 		}
+
+		writes.clear();
+		for (auto& kernelName : kernelNames)
+		{
+			kernels.push_back(Kernel(con, program, kernelCode, kernelName, std::vector<bool>()));
+			kernels.back().writes = argumentWrites(kernels.back().kernel);
+			writes.push_back(kernels.back().writes);
+		}
+
+		cache.store(con, kernelCode, kernelNames, options, program, writes);
+		return kernels;
 	}
-}
\ No newline at end of file
+}
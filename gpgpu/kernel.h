@@ -10,10 +10,46 @@
 #include "context.h"
 #include "device.h"
 #include "parameter.h"
+#include "program-cache.h"
 
 
+namespace GPGPU
+{
+	// handle of a kernel compiled by Computer (index of kernel in flat arrays of Computer and all devices)
+	struct KernelId
+	{
+		int index;
+		explicit KernelId(int indexPrm = -1) :index(indexPrm) { }
+		const bool valid() const { return index >= 0; }
+		bool operator == (const KernelId& id) const { return index == id.index; }
+		bool operator != (const KernelId& id) const { return index != id.index; }
+		bool operator < (const KernelId& id) const { return index < id.index; }
+	};
+
+	// sizes or offsets of a 2D launch (x = work-items per row, y = rows)
+	struct Size2D
+	{
+		size_t x;
+		size_t y;
+		Size2D(size_t xPrm = 0, size_t yPrm = 0) :x(xPrm), y(yPrm) { }
+	};
+}
+
 namespace GPGPU_LIB
 {
+	// a 2D launch is load-balanced, split into strips and copied as a 1D range of whole rows and becomes a 2D NDRange when it is enqueued
+	// work-item t of the range is at column columnOffset + t % rowThreads of row t / rowThreads (rowThreads = 0: 1D launch)
+	struct LaunchRows
+	{
+		size_t rowThreads;
+		size_t localRowThreads;
+		size_t columnOffset;
+		LaunchRows(size_t rowThreadsPrm = 0, size_t localRowThreadsPrm = 0, size_t columnOffsetPrm = 0) :rowThreads(rowThreadsPrm), localRowThreads(localRowThreadsPrm), columnOffset(columnOffsetPrm) { }
+
+		// ranges of devices are multiples of this (whole rows of work-groups for 2D launches)
+		const size_t granularity(size_t numLocalThreads) const { return rowThreads > 0 ? rowThreads * (numLocalThreads / localRowThreads) : numLocalThreads; }
+	};
+
 	// wrapper for  OpenCL kernel object with some helper fields to be re-used later
 	struct Kernel
 	{
@@ -22,12 +58,19 @@ namespace GPGPU_LIB
 		std::string code;
 		Context context;
 		bool isRunning; // todo: check this before setting an argument (and wait) and set this before running
-		std::map<std::string, Parameter> mapParameterNameToParameter;
+		std::vector<Parameter*> arguments; // bound parameter per argument position (nullptr = not bound), parameters are owned by worker
+		std::vector<bool> writes; // per argument position: kernel can write the argument (not a const global/constant pointer or a scalar)
 
 		/* compiles the given kernel code for the kernel name to be called later
-		 todo: add caching for binary code, probably not needed if driver has its own caching
+		 cacheDirectory: binary of program is loaded from (or saved to) this directory, empty = always compiled from source
 		 */
-		Kernel(Context con = Context(), std::string kernelCode = "", std::string kernelName = "");
+		Kernel(Context con = Context(), std::string kernelCode = "", std::string kernelName = "", std::string cacheDirectory = "");
+
+		// kernel of an already built program, writes: argument write flags
+		Kernel(Context con, cl::Program& program, std::string kernelCode, std::string kernelName, std::vector<bool> writesPrm);
+
+		// compiles kernel code once into 1 program and returns its kernels (on same order as kernelNames)
+		static std::vector<Kernel> compile(Context con, std::string kernelCode, std::vector<std::string> kernelNames, std::string cacheDirectory = "");
 	};
 }
 #endif // !GPGPU_KERNEL_LIB
\ No newline at end of file
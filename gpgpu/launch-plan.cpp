@@ -0,0 +1,22 @@
+#include "launch-plan.h"
+
+namespace GPGPU_LIB
+{
+	PlannedLaunch::PlannedLaunch() :kernel(nullptr), rebind(false)
+	{
+
+	}
+
+	WorkerLaunchPlan::WorkerLaunchPlan() :benchmark(1), work(0)
+	{
+
+	}
+}
+
+namespace GPGPU
+{
+	LaunchPlan::LaunchPlan() :offsetElement(0), numGlobalThreads(0), numLocalThreads(0), numLaunches(0)
+	{
+
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef GPGPU_LAUNCH_PLAN_LIB
+#define GPGPU_LAUNCH_PLAN_LIB
+
+
+#include "gpgpu_init.hpp"
+#include "parameter.h"
+#include "kernel.h"
+#include <vector>
+#include <memory>
+
+namespace GPGPU_LIB
+{
+	// single kernel launch of a plan with kernel and parameters already resolved on a worker
+	struct PlannedLaunch
+	{
+		Kernel* kernel;
+		std::vector<Parameter*> parameters; // bound parameter per argument position
+		std::vector<Parameter*> buffers; // non-scalar parameters (kernel may read or write any of them)
+		std::vector<Parameter*> inputs; // copied from RAM before kernel
+		std::vector<Parameter*> outputs; // copied to RAM after kernel
+		std::vector<std::pair<int, unsigned int>> scalarOffsets; // argument position and value added to its unsigned int scalar in this launch (Computer::setLaunchOffsets)
+		bool rebind; // arguments are set before launch (first launch of kernel in plan or its chain differs from previous launch of same kernel)
+		PlannedLaunch();
+	};
+
+	// launch list of a plan for a worker
+	// completion callbacks keep it alive with shared_from_this() after its LaunchPlan is destroyed
+	struct WorkerLaunchPlan : public std::enable_shared_from_this<WorkerLaunchPlan>
+	{
+		std::vector<PlannedLaunch> launches;
+		std::vector<Kernel*> kernels; // kernels of plan without duplicates (their own bindings are restored after replay)
+		double benchmark; // nanoseconds spent by last replay (for load-balancing)
+		size_t work; // number of threads launched by last replay
+		LaunchRows rows; // all launches are 2D if rows.rowThreads > 0
+		WorkerLaunchPlan();
+	};
+}
+
+namespace GPGPU
+{
+	struct Computer;
+
+	// a kernel list with parameter chains, resolved once by Computer::createLaunchPlan and replayed by Computer::run(plan)
+	// replay does not look up any kernel or parameter by name and keeps its own load-balancing state
+	struct LaunchPlan
+	{
+		friend struct Computer;
+	private:
+		std::vector<std::shared_ptr<GPGPU_LIB::WorkerLaunchPlan>> workerPlans; // per worker
+		size_t offsetElement;
+		size_t numGlobalThreads;
+		size_t numLocalThreads;
+		GPGPU_LIB::LaunchRows rows; // 2D plan: global/local sizes above are products of x and y
+		std::vector<size_t> localThreadsOfDevices; // per worker, divides numLocalThreads (tuneLocalThreads)
+		size_t numLaunches;
+		std::vector<double> loadBalance;
+		std::vector<std::vector<double>> oldLoadBalances;
+		std::vector<size_t> ranges;
+		std::vector<size_t> offsets;
+		// launches (for strip replays that exchange halo rows between launches)
+		std::vector<KernelId> kernelIds;
+		std::vector<std::vector<ParamId>> parameterIds;
+	public:
+		LaunchPlan();
+
+		// number of kernel launches per replay
+		const size_t size() const { return numLaunches; }
+	};
+}
+#endif // !GPGPU_LAUNCH_PLAN_LIB
@@ -13,17 +13,23 @@ namespace GPGPU
 		bool write,
 		bool readAll,
 		bool writeAll,
-		bool isScalar
+		bool isScalar,
+		ParamId parameterId,
+		bool isLocal,
+		size_t threadsPerGroup
 	) :
 		name(parameterName),
 		n(nElements),
 		elementSize(sizeElement),
 		elementsPerThr(elementsPerThread),
+		groupThreads(threadsPerGroup),
+		id(parameterId),
 		readOp(read),
 		writeOp(write),
 		readAllOp(readAll),
 		writeAllOp(writeAll),
-		scalar(isScalar)
+		scalar(isScalar),
+		local(isLocal)
 	{
 		
 		// if a buffer is meant to be read-write in kernel, then it can not be read/written from host side for optimization reasons so use it as read=false write=false that means only device can access it.
@@ -32,7 +38,7 @@ namespace GPGPU
 			throw std::invalid_argument("Error: Buffer can not be both input and output at the same time. If kernel is meant to read/write this buffer arbitrarily, then use read=false write=false and access it within device freely as a state-management. This may also require an extra kernel to initialize the buffer.");
 		}
 
-		if (parameterName == "")
+		if (parameterName == "" || isLocal)
 		{
 			ptr = nullptr;
 		}
@@ -50,14 +56,149 @@ namespace GPGPU
 
 			ptr = std::shared_ptr<int8_t>(quickPtrVal, [](int8_t* pt) { if (pt) delete[] pt; }); // last host parameter standing releases memory
 			quickPtr = reinterpret_cast<int8_t*>(val);
+			dirty = std::make_shared<DirtyRegions>(nElements * sizeElement);
 		}
-		prmList.push_back(parameterName);
+		prmList.push_back(parameterId);
+	}
+
+	void HostParameter::markDirty(size_t elementOffset, size_t numElements)
+	{
+		if (dirty && numElements > 0)
+			dirty->mark(elementOffset * elementSize, (elementOffset + numElements) * elementSize);
+	}
+
+	void HostParameter::markDirtyRect(size_t x, size_t y, size_t width, size_t height, size_t rowElements)
+	{
+		for (size_t j = y; j < y + height; j++)
+		{
+			markDirty(j * rowElements + x, width);
+		}
+	}
+
+	void HostParameter::copyChangedBytes(const int8_t* source, size_t byteOffset, size_t numBytes)
+	{
+		const size_t block = DirtyRegions::MERGE_GAP;
+		int8_t* target = quickPtr + byteOffset;
+
+		// consecutive changed blocks are marked as 1 range
+		size_t runBegin = 0;
+		bool inRun = false;
+		for (size_t i = 0; i < numBytes; i += block)
+		{
+			const size_t len = std::min(block, numBytes - i);
+			const bool changed = (std::memcmp(target + i, source + i, len) != 0);
+			if (changed)
+			{
+				std::memcpy(target + i, source + i, len);
+				if (!inRun)
+				{
+					runBegin = i;
+					inRun = true;
+				}
+			}
+			else if (inRun)
+			{
+				if (dirty)
+					dirty->mark(byteOffset + runBegin, byteOffset + i);
+				inRun = false;
+			}
+		}
+
+		if (inRun && dirty)
+			dirty->mark(byteOffset + runBegin, byteOffset + numBytes);
+	}
+
+	DirtyRegions::DirtyRegions(size_t numBytes) :version(1), size(numBytes)
+	{
+		ranges.push_back({ 0, numBytes, version });
+	}
+
+	void DirtyRegions::mark(size_t begin, size_t end)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		version++;
+
+		// writes are mostly sequential (loops, brush rows) so trying only the last range is enough
+		if (ranges.size() > 0)
+		{
+			Range& last = ranges.back();
+			if (begin <= last.end + MERGE_GAP && end + MERGE_GAP >= last.begin)
+			{
+				last.begin = std::min(last.begin, begin);
+				last.end = std::max(last.end, end);
+				last.version = version;
+				return;
+			}
+		}
+
+		ranges.push_back({ begin, end, version });
+		if (ranges.size() > MAX_RANGES)
+		{
+			Range merged = ranges[0];
+			for (Range& range : ranges)
+			{
+				merged.begin = std::min(merged.begin, range.begin);
+				merged.end = std::max(merged.end, range.end);
+			}
+			merged.version = version;
+			ranges.clear();
+			ranges.push_back(merged);
+		}
+	}
+
+	int DirtyRegions::addDevice()
+	{
+		std::lock_guard<std::mutex> lock(sync);
+
+		// ranges that are already dropped were never uploaded to new device, so whole buffer is dirty again
+		if (uploadedVersions.size() > 0)
+		{
+			version++;
+			ranges.clear();
+			ranges.push_back({ 0, size, version });
+		}
+		uploadedVersions.push_back(0);
+		return uploadedVersions.size() - 1;
+	}
+
+	std::vector<std::pair<size_t, size_t>> DirtyRegions::take(int device)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		std::vector<std::pair<size_t, size_t>> result;
+		for (Range& range : ranges)
+		{
+			if (range.version > uploadedVersions[device])
+			{
+				result.push_back(std::make_pair(range.begin, range.end));
+			}
+		}
+		uploadedVersions[device] = version;
+
+		// coalesce
+		std::sort(result.begin(), result.end());
+		std::vector<std::pair<size_t, size_t>> coalesced;
+		for (auto& range : result)
+		{
+			if (coalesced.size() > 0 && range.first <= coalesced.back().second + MERGE_GAP)
+			{
+				coalesced.back().second = std::max(coalesced.back().second, range.second);
+			}
+			else
+			{
+				coalesced.push_back(range);
+			}
+		}
+
+		// ranges that all devices uploaded are not needed anymore
+		const uint64_t minUploaded = *std::min_element(uploadedVersions.begin(), uploadedVersions.end());
+		ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [minUploaded](Range& range) { return range.version <= minUploaded; }), ranges.end());
+		return coalesced;
 	}
 
 	HostParameter HostParameter::next(HostParameter prm)
 	{
 		HostParameter result = *this;
-		result.prmList.push_back(prm.name);
+		result.prmList.push_back(prm.id);
 		return result;
 	}
 
@@ -75,19 +216,28 @@ namespace GPGPU_LIB
 			name(hostParameter.name),
 			n(hostParameter.n),
 			elementSize(hostParameter.elementSize),
+			elementsPerThread(hostParameter.elementsPerThr),
+			groupThreads(hostParameter.groupThreads),
 			hostPrm(hostParameter),
 			readOp(hostParameter.readOp),
 			writeOp(hostParameter.writeOp),
 			readAll(hostParameter.readAllOp),
 			writeAll(hostParameter.writeAllOp),
 			scalar(hostParameter.isScalar()),
-			elementsPerThread(hostParameter.elementsPerThr)
+			local(hostParameter.isLocal()),
+			dirtyDevice(-1)
 		{
+			// only inputs are uploaded
+			if (hostParameter.dirty && hostParameter.readOp)
+			{
+				dirtyDevice = hostParameter.dirty->addDevice();
+			}
+
 			bool sharesRAM = con.device.sharesRAM;
 
 
 
-			buffer = ((hostParameter.name == "") ? cl::Buffer() : cl::Buffer(con.context,
+			buffer = ((hostParameter.name == "" || hostParameter.isLocal()) ? cl::Buffer() : cl::Buffer(con.context,
 
 				(sharesRAM ? CL_MEM_USE_HOST_PTR : 0) |
 				(
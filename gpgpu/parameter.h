@@ -8,6 +8,8 @@
 
 #include <memory>
 #include <algorithm>
+#include <mutex>
+#include <cstring>
 // forward-declaring for friendship because only friends have access to private parts
 namespace GPGPU_LIB
 {
@@ -20,6 +22,48 @@ namespace GPGPU
 	struct Computer;
 	struct Worker;
 
+	// handle of a parameter created by Computer (index of parameter in flat arrays of Computer and all devices)
+	struct ParamId
+	{
+		int index;
+		explicit ParamId(int indexPrm = -1) :index(indexPrm) { }
+		const bool valid() const { return index >= 0; }
+		bool operator == (const ParamId& id) const { return index == id.index; }
+		bool operator != (const ParamId& id) const { return index != id.index; }
+		bool operator < (const ParamId& id) const { return index < id.index; }
+	};
+
+	// byte ranges of a host buffer that were changed after devices uploaded them
+	// shared by all copies of a host parameter, written by host thread and taken by worker threads
+	struct DirtyRegions
+	{
+		const static size_t MERGE_GAP = 4096; // ranges closer than this are uploaded as 1 copy
+		const static int MAX_RANGES = 64; // more ranges than this are merged into 1 range
+		struct Range
+		{
+			size_t begin;
+			size_t end;
+			uint64_t version; // last change of range
+		};
+
+		std::mutex sync;
+		uint64_t version; // incremented on each change
+		size_t size; // bytes of buffer
+		std::vector<Range> ranges;
+		std::vector<uint64_t> uploadedVersions; // last uploaded version per device
+
+		// whole buffer is dirty for devices that are added later
+		DirtyRegions(size_t numBytes);
+
+		void mark(size_t begin, size_t end);
+
+		// returns index of a new device (that has not uploaded anything yet)
+		int addDevice();
+
+		// returns coalesced ranges changed after last upload of device and marks them uploaded
+		std::vector<std::pair<size_t, size_t>> take(int device);
+	};
+
 	// per-program allocated host memory
 	struct HostParameter
 	{
@@ -32,17 +76,24 @@ namespace GPGPU
 		size_t n;
 		size_t elementSize;
 		size_t elementsPerThr;
+		size_t groupThreads; // work-items that share elementsPerThr elements (1 = per work-item, local threads of launches = per work-group)
 		std::shared_ptr<int8_t> ptr;
-		std::vector<std::string> prmList;
+		ParamId id;
+		std::vector<ParamId> prmList;
 		// points to 4096-aligned region, has a size of multiple of 4096 bytes (for zero-copy access from CPU, iGPU)
 		// todo: also make the copies multiple of 4096 bytes (if that is the last chunk of parameter to copy [i.e. last device to run it] )
 		int8_t* quickPtr;
 		int8_t* quickPtrVal;
+		std::shared_ptr<DirtyRegions> dirty;
 		bool readOp;
 		bool writeOp;
 		bool readAllOp;
 		bool writeAllOp;
 		bool scalar;
+		bool local; // local memory of work-groups (no buffer and no host data, only its size is given to kernel)
+
+		// copies bytes that differ (per block of DirtyRegions::MERGE_GAP bytes) and marks them dirty
+		void copyChangedBytes(const int8_t* source, size_t byteOffset, size_t numBytes);
 	public:
 		HostParameter(
 			std::string parameterName = "",
@@ -53,24 +104,55 @@ namespace GPGPU
 			bool write = false,
 			bool readAll = false,
 			bool writeAll = false,
-			bool isScalar = false
+			bool isScalar = false,
+			ParamId parameterId = ParamId(),
+			bool isLocal = false,
+			size_t threadsPerGroup = 1
 		);
 
 		const bool isScalar() const { return scalar; }
 
+		const bool isLocal() const { return local; }
+
+		// handle given by Computer::createHostParameter
+		const ParamId getId() const { return id; }
+
 		// operator overloading from char buffer
+		// element is assumed to be written (marked dirty for next upload), use value() for reading
 		template<typename T>
 		T& access(size_t index)
 		{
+			markDirty(index, 1);
 			return *reinterpret_cast<T*>(quickPtr + (index * elementSize));
 		}
 
+		// all elements starting from index are assumed to be written, use constPtr() for reading
 		template<typename T>
 		T* accessPtr(size_t index)
 		{
+			markDirty(index, n - index);
 			return reinterpret_cast<T*>(quickPtr + (index * elementSize));
 		}
 
+		// reads element without marking it dirty
+		template<typename T>
+		const T& value(size_t index) const
+		{
+			return *reinterpret_cast<const T*>(quickPtr + (index * elementSize));
+		}
+
+		template<typename T>
+		const T* constPtr(size_t index) const
+		{
+			return reinterpret_cast<const T*>(quickPtr + (index * elementSize));
+		}
+
+		// marks elements as changed so that they are uploaded on next input copy (for writes through pointers that are kept)
+		void markDirty(size_t elementOffset, size_t numElements);
+
+		// marks a 2D rectangle of elements as changed, rowElements = number of elements per row of buffer
+		void markDirtyRect(size_t x, size_t y, size_t width, size_t height, size_t rowElements);
+
 		HostParameter next(HostParameter prm);
 
 		// read buffer and write to region starting at ptrPrm
@@ -88,16 +170,13 @@ namespace GPGPU
 
 		// read region starting from ptrPrm and write to buffer
 		// numElements=0 means all elements are copied
+		// only changed blocks are copied and marked dirty
 		template<typename T>
-		void copyDataFromPtr(T* ptrPrm, size_t numElements=0, size_t elementOffset=0)
+		void copyDataFromPtr(const T* ptrPrm, size_t numElements=0, size_t elementOffset=0)
 		{
 			elementOffset = (numElements == 0 ? 0 : elementOffset);
 			numElements = (numElements == 0 ? n : numElements);
-			std::copy(
-				ptrPrm,
-				ptrPrm+numElements,
-				reinterpret_cast<T*>(quickPtr + (elementOffset * elementSize))				
-			);
+			copyChangedBytes(reinterpret_cast<const int8_t*>(ptrPrm), elementOffset * elementSize, numElements * sizeof(T));
 		}
 
 		std::string getName();		
@@ -112,6 +191,7 @@ namespace GPGPU
 		template<typename T>
 		void operator = (const T& newValue)
 		{
+			markDirty(0, n);
 			std::fill(
 				reinterpret_cast<T*>(quickPtr),
 				reinterpret_cast<T*>(quickPtr + (n * elementSize)),
@@ -127,20 +207,51 @@ namespace GPGPU
 			n=hPrm.n;
 			elementSize=hPrm.elementSize;
 			elementsPerThr=hPrm.elementsPerThr;
+			groupThreads=hPrm.groupThreads;
 			ptr=hPrm.ptr;
+			id=hPrm.id;
 			prmList=hPrm.prmList;
 
 			
 			quickPtr=hPrm.quickPtr;
 			quickPtrVal=hPrm.quickPtrVal;
+			dirty=hPrm.dirty;
 			readOp=hPrm.readOp;
 			writeOp=hPrm.writeOp;
 			readAllOp=hPrm.readAllOp;
 			writeAllOp = hPrm.writeAllOp;
 			scalar = hPrm.scalar;
+			local = hPrm.local;
 		}
 
 	};
+
+	// pair of equally sized device-side arrays that swap roles of "current" and "next" buffers on each swap()
+	// parameter chains built with current()/next() are re-bound to kernels per launch, so no copy kernel is needed between steps
+	struct DoubleBuffer
+	{
+	private:
+		HostParameter buffers[2];
+		int currentIndex;
+	public:
+		DoubleBuffer(HostParameter first = HostParameter(), HostParameter second = HostParameter()) :currentIndex(0)
+		{
+			buffers[0] = first;
+			buffers[1] = second;
+		}
+
+		// buffer that is read by current step
+		HostParameter current() { return buffers[currentIndex]; }
+
+		// buffer that is written by current step
+		HostParameter next() { return buffers[currentIndex ^ 1]; }
+
+		// makes the written buffer the current one (for building parameter chains of next step)
+		void swap() { currentIndex ^= 1; }
+
+		// 0 = first buffer is current, 1 = second buffer is current
+		int getCurrentIndex() const { return currentIndex; }
+	};
 }
 
 namespace GPGPU_LIB
@@ -155,6 +266,7 @@ namespace GPGPU_LIB
 		size_t n;
 		size_t elementSize;
 		size_t elementsPerThread;
+		size_t groupThreads; // elementsPerThread elements per groupThreads work-items
 		cl::Buffer buffer;
 		GPGPU::HostParameter hostPrm;
 		bool readOp;
@@ -162,8 +274,14 @@ namespace GPGPU_LIB
 		bool readAll;
 		bool writeAll;	
 		bool scalar;
+		bool local; // no buffer, kernel argument is local memory of elementSize * n bytes
+		int dirtyDevice; // index of this device in dirty regions of host parameter
 		Parameter(Context con = Context(), GPGPU::HostParameter hostParameter = GPGPU::HostParameter());
 		const bool isScalar() const { return scalar;  }
+		const bool isLocal() const { return local; }
+
+		// bytes of elements of first numThreads work-items (load-balanced copies)
+		const size_t bytesOfThreads(size_t numThreads) const { return numThreads / groupThreads * elementsPerThread * elementSize; }
 	};
 
 
@@ -47,6 +47,9 @@ namespace GPGPU_LIB
 			{
 				std::vector<cl::Device> devicesTmp;
 				cl_int op2 = platforms[i].getDevices(typeOfDevice, &devicesTmp);
+				// platform has no device of this type (for example a CPU-only platform when GPUs are queried)
+				if (op2 == CL_DEVICE_NOT_FOUND)
+					continue;
 				if (op2 != CL_SUCCESS)
 				{
 					throw std::invalid_argument(std::string("getDevices error: ") + getErrorString(op2));
@@ -0,0 +1,201 @@
+#include "primitives.h"
+namespace GPGPU
+{
+	Primitives::Primitives(Computer& computerPrm) :computer(computerPrm)
+	{
+
+	}
+
+	std::string Primitives::kernelCode(std::string typeName, std::string minIdentity, std::string maxIdentity)
+	{
+		std::string code = std::string(R"(
+			#define PRIMITIVE_TYPE )") + typeName + R"(
+			#define PRIMITIVE_GROUP_SIZE )" + std::to_string(GROUP_SIZE) + R"(
+			#define PRIMITIVE_ITEMS_PER_THREAD )" + std::to_string(ITEMS_PER_THREAD) + R"(
+			#define PRIMITIVE_CHUNK_SIZE )" + std::to_string(CHUNK_SIZE) + R"(
+
+			// inclusive scan of value of each work-item in tree (Hillis-Steele), tree[l] = sum of values of work-items 0 ... l
+			#define PRIMITIVE_LOCAL_SCAN(SCAN_TYPE, tree, l, value)                          \
+				tree[l] = value;                                                             \
+				barrier(CLK_LOCAL_MEM_FENCE);                                                \
+				for(int stride = 1; stride < PRIMITIVE_GROUP_SIZE; stride *= 2)              \
+				{                                                                            \
+					const SCAN_TYPE left = (l >= stride) ? tree[l - stride] : (SCAN_TYPE)0;  \
+					barrier(CLK_LOCAL_MEM_FENCE);                                            \
+					tree[l] += left;                                                         \
+					barrier(CLK_LOCAL_MEM_FENCE);                                            \
+				}
+		)";
+
+		// work-items read their elements strided by group size (coalesced), work-group reduces them in local memory to 1 partial result
+		auto reduceKernel = [&](std::string kernelName, std::string operation, std::string identity) {
+			return std::string(R"(
+			kernel void )") + kernelName + "_" + typeName + R"((
+				const global PRIMITIVE_TYPE * __restrict__ data,
+				const int n,
+				global PRIMITIVE_TYPE * __restrict__ partials
+			)
+			{
+				const int id = get_global_id(0);
+				const int l = get_local_id(0);
+				const int group = id / PRIMITIVE_GROUP_SIZE;
+				local PRIMITIVE_TYPE tree[PRIMITIVE_GROUP_SIZE];
+				PRIMITIVE_TYPE a = )" + identity + R"(;
+				for(int k = 0; k < PRIMITIVE_ITEMS_PER_THREAD; k++)
+				{
+					const int i = group * PRIMITIVE_CHUNK_SIZE + k * PRIMITIVE_GROUP_SIZE + l;
+					if(i < n)
+					{
+						const PRIMITIVE_TYPE b = data[i];
+						a = )" + operation + R"(;
+					}
+				}
+
+				tree[l] = a;
+				barrier(CLK_LOCAL_MEM_FENCE);
+				for(int half = PRIMITIVE_GROUP_SIZE / 2; half > 0; half /= 2)
+				{
+					if(l < half)
+					{
+						a = tree[l];
+						const PRIMITIVE_TYPE b = tree[l + half];
+						tree[l] = )" + operation + R"(;
+					}
+					barrier(CLK_LOCAL_MEM_FENCE);
+				}
+
+				if(l == 0)
+					partials[group] = tree[0];
+			}
+			)";
+		};
+
+		code += reduceKernel("gpgpuReduceSum", "a + b", "(PRIMITIVE_TYPE)0");
+		code += reduceKernel("gpgpuReduceMin", "(b < a ? b : a)", minIdentity);
+		code += reduceKernel("gpgpuReduceMax", "(a < b ? b : a)", maxIdentity);
+
+		code += std::string(R"(
+			// work-items scan their own consecutive elements after adding offset of group (scanned group sums) and offset of work-item (local scan)
+			kernel void gpgpuExclusiveScan_)") + typeName + R"((
+				const global PRIMITIVE_TYPE * __restrict__ data,
+				const int n,
+				const global PRIMITIVE_TYPE * __restrict__ groupOffsets,
+				global PRIMITIVE_TYPE * __restrict__ result
+			)
+			{
+				const int id = get_global_id(0);
+				const int l = get_local_id(0);
+				const int group = id / PRIMITIVE_GROUP_SIZE;
+				const int first = id * PRIMITIVE_ITEMS_PER_THREAD;
+				local PRIMITIVE_TYPE tree[PRIMITIVE_GROUP_SIZE];
+				PRIMITIVE_TYPE sum = 0;
+				for(int i = first; i < first + PRIMITIVE_ITEMS_PER_THREAD; i++)
+				{
+					if(i < n)
+						sum += data[i];
+				}
+
+				PRIMITIVE_LOCAL_SCAN(PRIMITIVE_TYPE, tree, l, sum)
+				PRIMITIVE_TYPE running = groupOffsets[group] + ((l > 0) ? tree[l - 1] : (PRIMITIVE_TYPE)0);
+				for(int i = first; i < first + PRIMITIVE_ITEMS_PER_THREAD; i++)
+				{
+					if(i < n)
+					{
+						result[i] = running;
+						running += data[i];
+					}
+				}
+			}
+
+			// bins of a work-group are counted with local atomics, then written to bins of group
+			kernel void gpgpuHistogram_)" + typeName + R"((
+				const global PRIMITIVE_TYPE * __restrict__ data,
+				const int n,
+				const int numBins,
+				__local unsigned int * bins,
+				global unsigned int * __restrict__ groupBins
+			)
+			{
+				const int id = get_global_id(0);
+				const int l = get_local_id(0);
+				const int group = id / PRIMITIVE_GROUP_SIZE;
+				for(int bin = l; bin < numBins; bin += PRIMITIVE_GROUP_SIZE)
+					bins[bin] = 0;
+				barrier(CLK_LOCAL_MEM_FENCE);
+
+				for(int k = 0; k < PRIMITIVE_ITEMS_PER_THREAD; k++)
+				{
+					const int i = group * PRIMITIVE_CHUNK_SIZE + k * PRIMITIVE_GROUP_SIZE + l;
+					if(i < n && data[i] >= 0 && data[i] < numBins)
+						atomic_inc(&bins[(int)data[i]]);
+				}
+				barrier(CLK_LOCAL_MEM_FENCE);
+
+				for(int bin = l; bin < numBins; bin += PRIMITIVE_GROUP_SIZE)
+					groupBins[group * numBins + bin] = bins[bin];
+			}
+
+			// work-groups count non-zero elements of their chunk (offsets of groups in compaction result are scanned on host)
+			kernel void gpgpuCountNonZero_)" + typeName + R"((
+				const global PRIMITIVE_TYPE * __restrict__ data,
+				const int n,
+				global unsigned int * __restrict__ groupCounts
+			)
+			{
+				const int id = get_global_id(0);
+				const int l = get_local_id(0);
+				const int group = id / PRIMITIVE_GROUP_SIZE;
+				local unsigned int tree[PRIMITIVE_GROUP_SIZE];
+				unsigned int count = 0;
+				for(int k = 0; k < PRIMITIVE_ITEMS_PER_THREAD; k++)
+				{
+					const int i = group * PRIMITIVE_CHUNK_SIZE + k * PRIMITIVE_GROUP_SIZE + l;
+					if(i < n && data[i] != 0)
+						count++;
+				}
+
+				tree[l] = count;
+				barrier(CLK_LOCAL_MEM_FENCE);
+				for(int half = PRIMITIVE_GROUP_SIZE / 2; half > 0; half /= 2)
+				{
+					if(l < half)
+						tree[l] += tree[l + half];
+					barrier(CLK_LOCAL_MEM_FENCE);
+				}
+
+				if(l == 0)
+					groupCounts[group] = tree[0];
+			}
+
+			// indices of non-zero elements are written to dense result, starting from offset of group (non-zero elements of earlier groups)
+			kernel void gpgpuCompact_)" + typeName + R"((
+				const global PRIMITIVE_TYPE * __restrict__ data,
+				const int n,
+				const global unsigned int * __restrict__ groupOffsets,
+				global unsigned int * __restrict__ indices
+			)
+			{
+				const int id = get_global_id(0);
+				const int l = get_local_id(0);
+				const int group = id / PRIMITIVE_GROUP_SIZE;
+				const int first = id * PRIMITIVE_ITEMS_PER_THREAD;
+				local unsigned int tree[PRIMITIVE_GROUP_SIZE];
+				unsigned int count = 0;
+				for(int i = first; i < first + PRIMITIVE_ITEMS_PER_THREAD; i++)
+				{
+					if(i < n && data[i] != 0)
+						count++;
+				}
+
+				PRIMITIVE_LOCAL_SCAN(unsigned int, tree, l, count)
+				unsigned int slot = groupOffsets[group] + ((l > 0) ? tree[l - 1] : 0);
+				for(int i = first; i < first + PRIMITIVE_ITEMS_PER_THREAD; i++)
+				{
+					if(i < n && data[i] != 0)
+						indices[slot++] = i;
+				}
+			}
+		)";
+		return code;
+	}
+}
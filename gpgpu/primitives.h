@@ -0,0 +1,274 @@
+#pragma once
+#ifndef GPGPU_PRIMITIVES_LIB
+#define GPGPU_PRIMITIVES_LIB
+
+#include "computer.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+namespace GPGPU
+{
+	// OpenCL name of element types that primitives support
+	template<typename T> struct PrimitiveType;
+	template<> struct PrimitiveType<int> { static std::string name() { return "int"; } };
+	template<> struct PrimitiveType<unsigned int> { static std::string name() { return "uint"; } };
+	template<> struct PrimitiveType<float> { static std::string name() { return "float"; } };
+	template<> struct PrimitiveType<unsigned char> { static std::string name() { return "uchar"; } };
+
+	/*
+		reduce (sum, min, max), exclusive scan, histogram and stream compaction of host arrays on all devices of a Computer
+		each work-group computes a chunk of GROUP_SIZE * ITEMS_PER_THREAD elements with a tree in local memory, devices get load-balanced ranges of work-groups
+		per-work-group results (partial sums, bins, counts) are copied to host and combined there, so results do not depend on number of devices
+		compaction scatters indices into a dense array on devices (at offsets of groups scanned on host) and only its filled elements are downloaded
+		kernels of an element type are compiled on first use, parameters are re-created only when a call has more elements than before
+	*/
+	class Primitives
+	{
+	public:
+		const static int GROUP_SIZE = 256;
+		const static int ITEMS_PER_THREAD = 16;
+		const static int CHUNK_SIZE = GROUP_SIZE * ITEMS_PER_THREAD;
+
+		Primitives(Computer& computer);
+
+		// sum of n elements (computed in T, integer sums wrap around)
+		template<typename T>
+		T sum(const T* data, size_t n)
+		{
+			return reduce<T>(data, n, "gpgpuReduceSum", T(0), [](T a, T b) { return a + b; });
+		}
+
+		// smallest of n elements (numeric_limits<T>::max() for n = 0)
+		template<typename T>
+		T min(const T* data, size_t n)
+		{
+			return reduce<T>(data, n, "gpgpuReduceMin", std::numeric_limits<T>::max(), [](T a, T b) { return b < a ? b : a; });
+		}
+
+		// largest of n elements (numeric_limits<T>::lowest() for n = 0)
+		template<typename T>
+		T max(const T* data, size_t n)
+		{
+			return reduce<T>(data, n, "gpgpuReduceMax", std::numeric_limits<T>::lowest(), [](T a, T b) { return a < b ? b : a; });
+		}
+
+		// result[i] = sum of data[0] ... data[i - 1] (result[0] = 0), result has n elements
+		template<typename T>
+		void exclusiveScan(const T* data, T* result, size_t n)
+		{
+			if (n == 0)
+				return;
+
+			// group sums are scanned on host and given back as offsets of groups, both kernels read the same uploaded elements
+			upload<T>(data, n);
+			std::vector<T> offsets = partials<T>(n, "gpgpuReduceSum");
+			T running = T(0);
+			for (auto& offset : offsets)
+			{
+				T groupSum = offset;
+				offset = running;
+				running = running + groupSum;
+			}
+
+			const std::string type = PrimitiveType<T>::name();
+			HostParameter groupOffsets = parameter<T>("gpgpuPrimitiveOffsets_" + type, PARAMETER_INPUT_PER_GROUP, offsets.size());
+			groupOffsets.copyDataFromPtr(offsets.data(), offsets.size());
+			HostParameter scanned = parameter<T>("gpgpuPrimitiveScan_" + type, PARAMETER_OUTPUT, offsets.size() * CHUNK_SIZE, ITEMS_PER_THREAD);
+			run<T>(n, "gpgpuExclusiveScan", { groupOffsets, scanned });
+			scanned.copyDataToPtr(result, n);
+		}
+
+		// number of elements per value for values 0 ... numBins - 1 (such as materials of cells), other values are not counted
+		template<typename T>
+		std::vector<unsigned int> histogram(const T* data, size_t n, size_t numBins)
+		{
+			std::vector<unsigned int> bins(numBins, 0);
+			if (n == 0 || numBins == 0)
+				return bins;
+
+			const size_t numGroups = groupsOf(n);
+			HostParameter numBinsPrm = parameter<int>("gpgpuPrimitiveNumBins", PARAMETER_SCALAR, 1);
+			numBinsPrm = (int)numBins;
+			HostParameter localBins = parameter<unsigned int>("gpgpuPrimitiveLocalBins", PARAMETER_LOCAL, numBins);
+			HostParameter groupBins = parameter<unsigned int>("gpgpuPrimitiveGroupBins", PARAMETER_OUTPUT_PER_GROUP, numGroups * numBins, numBins);
+			upload<T>(data, n);
+			run<T>(n, "gpgpuHistogram", { numBinsPrm, localBins, groupBins });
+			for (size_t group = 0; group < numGroups; group++)
+			{
+				for (size_t bin = 0; bin < numBins; bin++)
+					bins[bin] += groupBins.value<unsigned int>(group * numBins + bin);
+			}
+			return bins;
+		}
+
+		// ascending indices of non-zero elements
+		template<typename T>
+		std::vector<unsigned int> compact(const T* data, size_t n)
+		{
+			std::vector<unsigned int> indices;
+			if (n == 0)
+				return indices;
+
+			// groups count their non-zero elements, counts are scanned on host into offsets of groups in the dense result
+			const size_t numGroups = groupsOf(n);
+			upload<T>(data, n);
+			HostParameter groupCounts = parameter<unsigned int>("gpgpuPrimitiveGroupCounts", PARAMETER_OUTPUT_PER_GROUP, numGroups);
+			run<T>(n, "gpgpuCountNonZero", { groupCounts });
+			std::vector<unsigned int> offsets(numGroups + 1, 0);
+			for (size_t group = 0; group < numGroups; group++)
+				offsets[group + 1] = offsets[group] + groupCounts.value<unsigned int>(group);
+			const size_t total = offsets[numGroups];
+			if (total == 0)
+				return indices;
+
+			HostParameter groupOffsets = parameter<unsigned int>("gpgpuPrimitiveCompactOffsets", PARAMETER_INPUT_PER_GROUP, numGroups);
+			groupOffsets.copyDataFromPtr(offsets.data(), numGroups);
+			HostParameter dense = parameter<unsigned int>("gpgpuPrimitiveIndices", PARAMETER_STATE, total);
+			run<T>(n, "gpgpuCompact", { groupOffsets, dense });
+
+			// a device computed a contiguous range of groups, so it wrote a contiguous range of the dense result and only that range is downloaded
+			std::vector<size_t> threadOffsets, threadRanges;
+			computer.lastThreadRanges(threadOffsets, threadRanges);
+			for (size_t device = 0; device < threadOffsets.size(); device++)
+			{
+				const size_t firstGroup = std::min(threadOffsets[device] / GROUP_SIZE, numGroups);
+				const size_t endGroup = std::min((threadOffsets[device] + threadRanges[device]) / GROUP_SIZE, numGroups);
+				if (offsets[endGroup] > offsets[firstGroup])
+					computer.download(dense, (int)device, offsets[firstGroup], offsets[endGroup] - offsets[firstGroup]);
+			}
+			const unsigned int* result = dense.constPtr<unsigned int>(0);
+			indices.assign(result, result + total);
+			return indices;
+		}
+	private:
+		const static int PARAMETER_SCALAR = 0;
+		const static int PARAMETER_INPUT = 1;
+		const static int PARAMETER_OUTPUT = 2;
+		const static int PARAMETER_INPUT_PER_GROUP = 3;
+		const static int PARAMETER_OUTPUT_PER_GROUP = 4;
+		const static int PARAMETER_LOCAL = 5;
+		const static int PARAMETER_STATE = 6;
+
+		struct Slot
+		{
+			HostParameter prm;
+			size_t numElements;
+			size_t numElementsPerThread;
+		};
+
+		Computer& computer;
+		std::map<std::string, Slot> slots; // created parameters per name
+		std::set<std::string> compiledTypes;
+
+		// kernels of an element type (kernel names have "_" + typeName suffix)
+		static std::string kernelCode(std::string typeName, std::string minIdentity, std::string maxIdentity);
+
+		// OpenCL literal of a value
+		template<typename T>
+		static std::string literalOf(T value)
+		{
+			if (std::numeric_limits<T>::is_integer)
+				return std::string("((") + PrimitiveType<T>::name() + ")" + std::to_string((long long)value) + "L)";
+			return std::to_string(value) + "f";
+		}
+
+		// work-groups of n elements, at least 1 per device because load-balancer gives every device a range (extra groups have no elements)
+		size_t groupsOf(size_t n)
+		{
+			return std::max((n + CHUNK_SIZE - 1) / CHUNK_SIZE, (size_t)computer.getNumDevices());
+		}
+
+		// parameter that has at least numElements elements, it is re-created when it is smaller or has different elements per thread (or per group)
+		template<typename T>
+		HostParameter parameter(std::string name, int kind, size_t numElements, size_t numElementsPerThread = 1)
+		{
+			auto it = slots.find(name);
+			if (it != slots.end() && it->second.numElements >= numElements && it->second.numElementsPerThread == numElementsPerThread)
+				return it->second.prm;
+
+			HostParameter prm;
+			if (kind == PARAMETER_SCALAR)
+				prm = computer.createScalarInput<T>(name);
+			else if (kind == PARAMETER_INPUT)
+				prm = computer.createArrayInput<T>(name, numElements, numElementsPerThread);
+			else if (kind == PARAMETER_OUTPUT)
+				prm = computer.createArrayOutput<T>(name, numElements, numElementsPerThread);
+			else if (kind == PARAMETER_INPUT_PER_GROUP)
+				prm = computer.createArrayInputPerGroup<T>(name, numElements, GROUP_SIZE, numElementsPerThread);
+			else if (kind == PARAMETER_OUTPUT_PER_GROUP)
+				prm = computer.createArrayOutputPerGroup<T>(name, numElements, GROUP_SIZE, numElementsPerThread);
+			else if (kind == PARAMETER_STATE)
+				prm = computer.createArrayState<T>(name, numElements, numElementsPerThread);
+			else
+				prm = computer.createLocalArray<T>(name, numElements);
+			slots[name] = { prm, numElements, numElementsPerThread };
+			return prm;
+		}
+
+		// compiles kernels of T on first use, copies n elements to input of T and sets their count
+		// input has all elements on all devices and only changed bytes are uploaded, so kernels that run on same elements do not upload them again
+		template<typename T>
+		void upload(const T* data, size_t n)
+		{
+			if (n > (size_t)std::numeric_limits<int>::max())
+				throw std::invalid_argument(std::string("error: too many elements for primitives: ") + std::to_string(n));
+
+			const std::string type = PrimitiveType<T>::name();
+			if (compiledTypes.find(type) == compiledTypes.end())
+			{
+				computer.compile(
+					kernelCode(type, literalOf(std::numeric_limits<T>::max()), literalOf(std::numeric_limits<T>::lowest())),
+					{ "gpgpuReduceSum_" + type, "gpgpuReduceMin_" + type, "gpgpuReduceMax_" + type, "gpgpuExclusiveScan_" + type, "gpgpuHistogram_" + type, "gpgpuCountNonZero_" + type, "gpgpuCompact_" + type });
+				compiledTypes.insert(type);
+			}
+
+			HostParameter input = parameter<T>("gpgpuPrimitiveData_" + type, PARAMETER_INPUT, groupsOf(n) * CHUNK_SIZE, ITEMS_PER_THREAD);
+			input.copyDataFromPtr(data, n);
+			HostParameter count = parameter<int>("gpgpuPrimitiveCount", PARAMETER_SCALAR, 1);
+			count = (int)n;
+		}
+
+		// runs kernelName of T on last uploaded n elements with 1 work-group per chunk
+		// kernel arguments are data, count and then the other parameters in given order
+		template<typename T>
+		void run(size_t n, std::string kernelName, std::vector<HostParameter> parameters)
+		{
+			const std::string type = PrimitiveType<T>::name();
+			const size_t numGroups = groupsOf(n);
+			HostParameter chain = parameter<T>("gpgpuPrimitiveData_" + type, PARAMETER_INPUT, numGroups * CHUNK_SIZE, ITEMS_PER_THREAD).next(parameter<int>("gpgpuPrimitiveCount", PARAMETER_SCALAR, 1));
+			for (auto& prm : parameters)
+				chain = chain.next(prm);
+			computer.compute(chain, kernelName + "_" + type, 0, numGroups * GROUP_SIZE, GROUP_SIZE);
+		}
+
+		// 1 result of reduce kernel per group (of last uploaded n elements)
+		template<typename T>
+		std::vector<T> partials(size_t n, std::string kernelName)
+		{
+			HostParameter groupResults = parameter<T>("gpgpuPrimitivePartials_" + PrimitiveType<T>::name(), PARAMETER_OUTPUT_PER_GROUP, groupsOf(n));
+			run<T>(n, kernelName, { groupResults });
+			std::vector<T> result(groupsOf(n));
+			groupResults.copyDataToPtr(result.data(), result.size());
+			return result;
+		}
+
+		template<typename T>
+		T reduce(const T* data, size_t n, std::string kernelName, T identity, std::function<T(T, T)> op)
+		{
+			T result = identity;
+			if (n == 0)
+				return result;
+			upload<T>(data, n);
+			for (T partial : partials<T>(n, kernelName))
+				result = op(result, partial);
+			return result;
+		}
+	};
+}
+
+#endif // !GPGPU_PRIMITIVES_LIB
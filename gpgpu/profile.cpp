@@ -0,0 +1,73 @@
+#include "profile.h"
+#include <algorithm>
+
+namespace GPGPU
+{
+	// running averages become exponential after this many samples
+	const static double PROFILE_AVERAGE_WINDOW = 32;
+
+	CommandStatistics::CommandStatistics() :count(0), totalRunTime(0), lastRunTime(0), averageRunTime(0), averageQueueTime(0), averageWaitTime(0)
+	{
+
+	}
+
+	void CommandStatistics::add(cl_ulong queued, cl_ulong submit, cl_ulong start, cl_ulong end)
+	{
+		count++;
+		const double weight = 1.0 / std::min((double)count, PROFILE_AVERAGE_WINDOW);
+		lastRunTime = (end > start ? (double)(end - start) : 0.0);
+		totalRunTime += lastRunTime;
+		averageRunTime += (lastRunTime - averageRunTime) * weight;
+		averageQueueTime += ((submit > queued ? (double)(submit - queued) : 0.0) - averageQueueTime) * weight;
+		averageWaitTime += ((start > submit ? (double)(start - submit) : 0.0) - averageWaitTime) * weight;
+	}
+
+	void CommandStatistics::merge(const CommandStatistics& statistics)
+	{
+		const size_t total = count + statistics.count;
+		if (total == 0)
+			return;
+
+		const double weight = (double)statistics.count / total;
+		averageRunTime += (statistics.averageRunTime - averageRunTime) * weight;
+		averageQueueTime += (statistics.averageQueueTime - averageQueueTime) * weight;
+		averageWaitTime += (statistics.averageWaitTime - averageWaitTime) * weight;
+		totalRunTime += statistics.totalRunTime;
+		lastRunTime = std::max(lastRunTime, statistics.lastRunTime);
+		count = total;
+	}
+}
+
+namespace GPGPU_LIB
+{
+	void CommandProfile::add(const std::string& name, cl::Event& event)
+	{
+		cl_int op[4];
+		const cl_ulong queued = event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>(&op[0]);
+		const cl_ulong submit = event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>(&op[1]);
+		const cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>(&op[2]);
+		const cl_ulong end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>(&op[3]);
+
+		// a failed command has no times
+		for (int i = 0; i < 4; i++)
+		{
+			if (op[i] != CL_SUCCESS)
+				return;
+		}
+
+		std::lock_guard<std::mutex> lg(lock);
+		statistics[name].add(queued, submit, start, end);
+	}
+
+	std::map<std::string, GPGPU::CommandStatistics> CommandProfile::get()
+	{
+		std::lock_guard<std::mutex> lg(lock);
+		return statistics;
+	}
+
+	void CommandProfile::reset()
+	{
+		std::lock_guard<std::mutex> lg(lock);
+		statistics.clear();
+	}
+}
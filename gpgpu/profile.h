@@ -0,0 +1,54 @@
+#pragma once
+#ifndef GPGPU_PROFILE_LIB
+#define GPGPU_PROFILE_LIB
+
+
+#include "gpgpu_init.hpp"
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace GPGPU
+{
+	// device-side times of a kind of command (a kernel or copies in one direction) from OpenCL profiling events, in nanoseconds
+	// averages are running averages (mean of first samples, then recent samples weigh more)
+	struct CommandStatistics
+	{
+		size_t count; // completed commands
+		double totalRunTime; // sum of end - start
+		double lastRunTime;
+		double averageRunTime; // end - start (device is busy with command)
+		double averageQueueTime; // submit - queued (host queue)
+		double averageWaitTime; // start - submit (waits for dependencies and device)
+
+		CommandStatistics();
+
+		// adds 1 command from its profiling times
+		void add(cl_ulong queued, cl_ulong submit, cl_ulong start, cl_ulong end);
+
+		// adds commands of another device (averages are weighted by counts)
+		void merge(const CommandStatistics& statistics);
+	};
+
+	// keys of copies in statistics of Computer::profile (kernels use their own names)
+	const static std::string PROFILE_UPLOAD = "@upload";
+	const static std::string PROFILE_DOWNLOAD = "@download";
+}
+
+namespace GPGPU_LIB
+{
+	// statistics of a command queue, updated from completion callbacks
+	struct CommandProfile
+	{
+		std::mutex lock;
+		std::map<std::string, GPGPU::CommandStatistics> statistics;
+
+		// adds a completed command
+		void add(const std::string& name, cl::Event& event);
+
+		std::map<std::string, GPGPU::CommandStatistics> get();
+
+		void reset();
+	};
+}
+#endif // !GPGPU_PROFILE_LIB
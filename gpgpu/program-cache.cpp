@@ -0,0 +1,172 @@
+#include "program-cache.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace GPGPU_LIB
+{
+	const static char PROGRAM_CACHE_MAGIC[] = "GPGPU-PROGRAM-CACHE 2\n";
+
+	// 64-bit FNV-1a
+	static uint64_t hashOf(const std::string& str)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : str)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static void writeSize(std::ofstream& file, uint64_t size)
+	{
+		file.write((const char*)&size, sizeof(size));
+	}
+
+	static bool readSize(std::ifstream& file, uint64_t& size)
+	{
+		return (bool)file.read((char*)&size, sizeof(size));
+	}
+
+	ProgramCache::ProgramCache(std::string directoryPrm) :directory(directoryPrm)
+	{
+
+	}
+
+	std::string ProgramCache::key(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options)
+	{
+		cl_int op;
+		std::string driverVersion = con.device.device.getInfo<CL_DRIVER_VERSION>(&op);
+		if (op != CL_SUCCESS)
+			driverVersion = "";
+
+		std::string platformVersion;
+		cl::Platform platform(con.device.device.getInfo<CL_DEVICE_PLATFORM>(&op));
+		if (op == CL_SUCCESS)
+			platformVersion = platform.getInfo<CL_PLATFORM_VERSION>(&op);
+
+		// full code is in key so that a hash collision does not load wrong binary
+		std::string names;
+		for (auto& kernelName : kernelNames)
+			names += kernelName + ' ';
+		return con.device.name + '\n' + driverVersion + '\n' + platformVersion + '\n' + options + '\n' + names + '\n' + kernelCode;
+	}
+
+	std::string ProgramCache::fileName(const std::string& key)
+	{
+		std::stringstream name;
+		name << std::hex << hashOf(key) << ".bin";
+		return (std::filesystem::path(directory) / name.str()).string();
+	}
+
+	bool ProgramCache::load(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options, cl::Program& program, std::vector<std::vector<bool>>& writes)
+	{
+		if (directory == "")
+			return false;
+
+		const std::string programKey = key(con, kernelCode, kernelNames, options);
+		std::ifstream file(fileName(programKey), std::ios::binary);
+		if (!file)
+			return false;
+
+		std::string magic(sizeof(PROGRAM_CACHE_MAGIC) - 1, '\0');
+		uint64_t keySize = 0;
+		if (!file.read(&magic[0], magic.size()) || magic != PROGRAM_CACHE_MAGIC || !readSize(file, keySize) || keySize != programKey.size())
+			return false;
+
+		std::string fileKey(keySize, '\0');
+		if (!file.read(&fileKey[0], keySize) || fileKey != programKey)
+			return false;
+
+		// argument write flags per kernel
+		std::vector<std::vector<char>> argWrites(kernelNames.size());
+		for (auto& kernelWrites : argWrites)
+		{
+			uint64_t numArgs = 0;
+			if (!readSize(file, numArgs))
+				return false;
+			kernelWrites.resize(numArgs);
+			if (numArgs > 0 && !file.read(kernelWrites.data(), numArgs))
+				return false;
+		}
+
+		uint64_t binarySize = 0;
+		if (!readSize(file, binarySize) || binarySize == 0)
+			return false;
+		cl::Program::Binaries binaries(1, std::vector<unsigned char>(binarySize));
+		if (!file.read((char*)binaries[0].data(), binarySize))
+			return false;
+
+		// driver can still reject a binary (for example after an update that does not change version strings)
+		cl_int op = CL_SUCCESS;
+		std::vector<cl_int> binaryStatus;
+		cl::Program binaryProgram(con.context, { con.device.device }, binaries, &binaryStatus, &op);
+		if (op != CL_SUCCESS || binaryStatus.size() != 1 || binaryStatus[0] != CL_SUCCESS)
+			return false;
+
+		if (binaryProgram.build(con.device.device, options.c_str()) != CL_SUCCESS)
+			return false;
+
+		program = binaryProgram;
+		writes.clear();
+		for (auto& kernelWrites : argWrites)
+		{
+			writes.push_back(std::vector<bool>());
+			for (char w : kernelWrites)
+				writes.back().push_back(w != 0);
+		}
+		return true;
+	}
+
+	void ProgramCache::store(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options, cl::Program& program, const std::vector<std::vector<bool>>& writes)
+	{
+		if (directory == "")
+			return;
+
+		cl_int op = CL_SUCCESS;
+		cl::Program::Binaries binaries = program.getInfo<CL_PROGRAM_BINARIES>(&op);
+		if (op != CL_SUCCESS || binaries.size() != 1 || binaries[0].size() == 0)
+			return;
+
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error)
+			return;
+
+		// other devices (or processes) can store same program at the same time, so file is renamed after it is complete
+		const std::string programKey = key(con, kernelCode, kernelNames, options);
+		const std::string name = fileName(programKey);
+		std::stringstream tmpName;
+		tmpName << name << "." << std::this_thread::get_id() << ".tmp";
+		{
+			std::ofstream file(tmpName.str(), std::ios::binary | std::ios::trunc);
+			if (!file)
+				return;
+
+			file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC) - 1);
+			writeSize(file, programKey.size());
+			file.write(programKey.data(), programKey.size());
+			for (auto& kernelWrites : writes)
+			{
+				writeSize(file, kernelWrites.size());
+				for (bool w : kernelWrites)
+					file.put(w ? 1 : 0);
+			}
+			writeSize(file, binaries[0].size());
+			file.write((const char*)binaries[0].data(), binaries[0].size());
+			if (!file)
+			{
+				file.close();
+				std::filesystem::remove(tmpName.str(), error);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmpName.str(), name, error);
+		if (error)
+			std::filesystem::remove(tmpName.str(), error);
+	}
+}
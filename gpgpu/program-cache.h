@@ -0,0 +1,35 @@
+#pragma once
+#ifndef GPGPU_PROGRAM_CACHE_LIB
+#define GPGPU_PROGRAM_CACHE_LIB
+
+
+#include <string>
+#include <vector>
+#include "gpgpu_init.hpp"
+#include "context.h"
+
+namespace GPGPU_LIB
+{
+	// compiled programs on disk (1 file per kernel code, kernel names, build options, device and driver version)
+	// a file that does not match or does not load is ignored and re-written after next build from source
+	struct ProgramCache
+	{
+		std::string directory; // empty = no caching
+
+		ProgramCache(std::string directoryPrm = "");
+
+		// builds program from cached binary, returns false when program has to be built from source
+		// writes: argument write flags per kernel (argument info of drivers is only guaranteed for programs built from source)
+		bool load(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options, cl::Program& program, std::vector<std::vector<bool>>& writes);
+
+		// saves binary of a program built from source (errors are ignored because cache is optional)
+		void store(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options, cl::Program& program, const std::vector<std::vector<bool>>& writes);
+
+	private:
+		// everything that makes a binary invalid for another build
+		std::string key(Context& con, const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::string& options);
+
+		std::string fileName(const std::string& key);
+	};
+}
+#endif // !GPGPU_PROGRAM_CACHE_LIB
@@ -0,0 +1,99 @@
+#include "strips.h"
+#include <algorithm>
+
+namespace GPGPU_LIB
+{
+	StripParameter::StripParameter() :elementsPerRow(0), haloRows(0), planes(1), firstElement(0)
+	{
+
+	}
+
+	StripParameter::StripParameter(size_t elementsPerRowPrm, size_t haloRowsPrm, size_t planesPrm, size_t numRows, int numDevices, size_t firstElementPrm) :
+		elementsPerRow(elementsPerRowPrm),
+		haloRows(haloRowsPrm),
+		planes(planesPrm),
+		firstElement(firstElementPrm),
+		owned(numDevices),
+		valid(numDevices, RowRange(0, numRows))
+	{
+
+	}
+
+	void StripParameter::addTransfers(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, RowRange rows, bool toDevice, std::vector<StripTransfer>& transfers)
+	{
+		for (size_t plane = 0; plane < planes; plane++)
+		{
+			const size_t first = firstElement + (plane * numRows + rows.begin) * elementsPerRow;
+			const size_t last = std::min(firstElement + (plane * numRows + rows.end) * elementsPerRow, numElements);
+			if (first >= last)
+				continue;
+
+			StripTransfer transfer;
+			transfer.parameterId = parameterId;
+			transfer.byteOffset = first * elementSize;
+			transfer.numBytes = (last - first) * elementSize;
+			transfer.toDevice = toDevice;
+			transfers.push_back(transfer);
+		}
+	}
+
+	void StripParameter::exchange(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, const std::vector<RowRange>& strips,
+		std::vector<std::vector<StripTransfer>>& downloads, std::vector<std::vector<StripTransfer>>& uploads)
+	{
+		const int n = strips.size();
+		for (int device = 0; device < n; device++)
+		{
+			RowRange need(strips[device].begin > haloRows ? strips[device].begin - haloRows : 0, std::min(strips[device].end + haloRows, numRows));
+			RowRange& has = valid[device];
+
+			// rows that are not valid on device are on both sides of valid rows (or need all rows)
+			std::vector<RowRange> missing;
+			if (has.empty() || has.end < need.begin || has.begin > need.end)
+			{
+				missing.push_back(need);
+			}
+			else
+			{
+				missing.push_back(RowRange(need.begin, std::min(has.begin, need.end)));
+				missing.push_back(RowRange(std::max(has.end, need.begin), need.end));
+			}
+
+			for (RowRange& rows : missing)
+			{
+				if (rows.empty())
+					continue;
+
+				for (int owner = 0; owner < n; owner++)
+				{
+					RowRange part(std::max(rows.begin, owned[owner].begin), std::min(rows.end, owned[owner].end));
+					if (owner == device || part.empty())
+						continue;
+
+					addTransfers(parameterId, elementSize, numElements, numRows, part, false, downloads[owner]);
+					addTransfers(parameterId, elementSize, numElements, numRows, part, true, uploads[device]);
+				}
+			}
+
+			if (has.empty() || has.end < need.begin || has.begin > need.end)
+				has = need;
+			else
+				has = RowRange(std::min(has.begin, need.begin), std::max(has.end, need.end));
+		}
+	}
+
+	void StripParameter::collect(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, const std::vector<RowRange>& strips,
+		std::vector<std::vector<StripTransfer>>& downloads)
+	{
+		const int n = strips.size();
+		for (int device = 0; device < n; device++)
+		{
+			addTransfers(parameterId, elementSize, numElements, numRows, strips[device], false, downloads[device]);
+		}
+	}
+
+	void StripParameter::written(const std::vector<RowRange>& strips)
+	{
+		owned = strips;
+		valid = strips;
+	}
+}
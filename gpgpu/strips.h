@@ -0,0 +1,61 @@
+#pragma once
+#ifndef GPGPU_STRIPS_LIB
+#define GPGPU_STRIPS_LIB
+
+
+#include "parameter.h"
+#include <vector>
+
+namespace GPGPU_LIB
+{
+	// rows [begin, end) of a 2D grid
+	struct RowRange
+	{
+		size_t begin;
+		size_t end;
+		RowRange(size_t beginPrm = 0, size_t endPrm = 0) :begin(beginPrm), end(endPrm) { }
+		const bool empty() const { return end <= begin; }
+	};
+
+	// copy of a byte range of a parameter between device and RAM
+	struct StripTransfer
+	{
+		GPGPU::ParamId parameterId;
+		size_t byteOffset;
+		size_t numBytes;
+		bool toDevice; // RAM to device (false = device to RAM)
+	};
+
+	// rows of a parameter that are held by devices when a grid is split into horizontal strips (1 strip per device)
+	// parameter is planes grids one after another, each with numRows rows of elementsPerRow elements
+	struct StripParameter
+	{
+		size_t elementsPerRow; // 0 = parameter is not split into strips
+		size_t haloRows; // rows above and below a strip that kernels read
+		size_t planes;
+		size_t firstElement; // element of first row (elements before it, such as a border row, are not split)
+		std::vector<RowRange> owned; // per device: rows that device wrote last time (values of other devices are copies)
+		std::vector<RowRange> valid; // per device: rows that are up to date on device
+
+		StripParameter();
+
+		// all devices start with same values
+		StripParameter(size_t elementsPerRowPrm, size_t haloRowsPrm, size_t planesPrm, size_t numRows, int numDevices, size_t firstElementPrm = 0);
+
+		// adds transfers that bring missing halo rows to devices from their owners (downloads then uploads per device) and marks them valid
+		void exchange(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, const std::vector<RowRange>& strips,
+			std::vector<std::vector<StripTransfer>>& downloads, std::vector<std::vector<StripTransfer>>& uploads);
+
+		// adds transfers that copy own rows of strips to RAM
+		void collect(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, const std::vector<RowRange>& strips,
+			std::vector<std::vector<StripTransfer>>& downloads);
+
+		// devices own (only) their strips after a kernel wrote the parameter
+		void written(const std::vector<RowRange>& strips);
+
+	private:
+		// adds 1 transfer per plane for rows
+		void addTransfers(GPGPU::ParamId parameterId, size_t elementSize, size_t numElements, size_t numRows, RowRange rows, bool toDevice, std::vector<StripTransfer>& transfers);
+	};
+}
+#endif // !GPGPU_STRIPS_LIB
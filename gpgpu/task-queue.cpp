@@ -7,23 +7,94 @@ namespace GPGPU_LIB
 
 
 	GPGPUTask::GPGPUTask() :
-			kernelCode(""),
-			kernelName(""),
-			parameterName(""),
+			kernelCode(nullptr),
+			kernelNames(nullptr),
+			kernelCacheDirectory(nullptr),
+			kernelIds(nullptr),
+			kernelParameterIds(nullptr),
 			parameterPosition(0),
 			offset(0),
 			globalSize(0),
 			localSize(0),
+			globalOffset(0),
 			hostParPtr(nullptr),
 			comQuePtr(nullptr),
-			taskType(0),
-			conPtr(nullptr),
-			mutexPtr(nullptr),
 			sharedTaskQueue(nullptr),
-			globalOffset(0)
+			launchPlan(nullptr),
+			launchBegin(0),
+			launchEnd(0),
+			strips(false),
+			transfers(nullptr),
+			conPtr(nullptr),
+			taskType(0)
 		{}
 
 
+		GPGPUCounter::GPGPUCounter() :count(0), parked(false)
+		{
+
+		}
+
+		void GPGPUCounter::increment()
+		{
+			// seq_cst pairs with the waiter's store to parked then load of count, so either waiter sees new count or this sees parked
+			count.fetch_add(1);
+			if (parked.load())
+			{
+				std::lock_guard<std::mutex> lock(parkSync);
+				parkCondition.notify_all();
+			}
+		}
+
+		void GPGPUCounter::waitFor(uint64_t target)
+		{
+			for (int i = 0; i < SPIN_COUNT; i++)
+			{
+				if (count.load(std::memory_order_acquire) >= target)
+					return;
+			}
+
+			for (int i = 0; i < YIELD_COUNT; i++)
+			{
+				if (count.load(std::memory_order_acquire) >= target)
+					return;
+				std::this_thread::yield();
+			}
+
+			std::unique_lock<std::mutex> lock(parkSync);
+			parked.store(true);
+			while (count.load() < target)
+			{
+				parkCondition.wait(lock);
+			}
+			parked.store(false);
+		}
+
+		GPGPUTaskRing::GPGPUTaskRing() :head(0), tail(0)
+		{
+
+		}
+
+		void GPGPUTaskRing::push(const GPGPUTask& task)
+		{
+			if (tail >= CAPACITY)
+			{
+				popped.waitFor(tail - CAPACITY + 1);
+			}
+			tasks[tail % CAPACITY] = task;
+			tail++;
+			pushed.increment();
+		}
+
+		GPGPUTask GPGPUTaskRing::pop()
+		{
+			pushed.waitFor(head + 1);
+			GPGPUTask task = tasks[head % CAPACITY];
+			head++;
+			popped.increment();
+			return task;
+		}
+
 		GPGPUTaskQueue::GPGPUTaskQueue()
 		{
 
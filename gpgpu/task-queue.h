@@ -10,9 +10,16 @@
 #include "parameter.h"
 #include "command-queue.h"
 #include "context.h"
+#include "launch-plan.h"
+#include "strips.h"
+#include <atomic>
+#include <type_traits>
 namespace GPGPU_LIB
 {
 	struct GPGPUTaskQueue;
+
+	// compact task descriptor (trivially copyable) for the worker task ring
+	// pointed data is owned by the caller and has to stay alive until worker completes the task (Worker::waitAllTasks)
 	struct GPGPUTask
 	{
 		const static int GPGPU_TASK_NULL = 0;
@@ -24,20 +31,31 @@ namespace GPGPU_LIB
 		const static int GPGPU_TASK_RETURN_NANO_BENCH = 6;
 		const static int GPGPU_TASK_COMPUTE_ALL = 7;
 		const static int GPGPU_TASK_COMPUTE_MULTIPLE = 8;
-		std::string kernelCode;
-		std::string kernelName;
-		std::vector<std::string> kernelNames;
-		std::string parameterName;
+		const static int GPGPU_TASK_CREATE_LAUNCH_PLAN = 9;
+		const static int GPGPU_TASK_RUN_LAUNCH_PLAN = 10;
+		const static int GPGPU_TASK_TRANSFER = 11;
+		const std::string* kernelCode;
+		const std::vector<std::string>* kernelNames;
+		const std::string* kernelCacheDirectory;
+		GPGPU::KernelId kernelId;
+		const std::vector<GPGPU::KernelId>* kernelIds;
+		const std::vector<std::vector<GPGPU::ParamId>>* kernelParameterIds; // optional per-launch re-binding of kernelIds' parameters (empty = no re-binding)
+		GPGPU::ParamId parameterId;
 		int parameterPosition;
 		size_t offset;
 		size_t globalSize;
 		size_t localSize;
 		size_t globalOffset;
+		LaunchRows rows; // 2D launch of compute task (rowThreads = 0: 1D)
 		GPGPU::HostParameter* hostParPtr;
 		CommandQueue* comQuePtr;
-		std::shared_ptr<GPGPUTaskQueue> sharedTaskQueue;
+		GPGPUTaskQueue* sharedTaskQueue;
+		WorkerLaunchPlan* launchPlan;
+		size_t launchBegin; // launches [launchBegin, launchEnd) of launchPlan are replayed
+		size_t launchEnd;
+		bool strips; // thread range is a strip of rows (outputs with all elements are copied per strip by Computer)
+		const std::vector<StripTransfer>* transfers;
 		Context* conPtr;
-		std::mutex* mutexPtr;
 
 		// no task = 0
 		// compile a kernel = 1
@@ -46,13 +64,59 @@ namespace GPGPU_LIB
 		// compute a kernel (copy input + run kernel + copy output) = 4
 		// stop working = 5
 		// benchmark execution = 6 (for load-balancing)
+		// compute all tasks of a shared queue = 7
+		// compute a list of kernels = 8
+		// resolve kernels and parameters of a launch plan = 9
+		// replay a launch plan = 10
+		// copy byte ranges of parameters between device and RAM (halo rows of strips) = 11
 		int taskType;
 
 
 		GPGPUTask();
 
 	};
+	static_assert(std::is_trivially_copyable<GPGPUTask>::value, "GPGPUTask is copied into ring slots by value");
+
+	// counter that is waited by spinning for a short time then by sleeping (spin-then-park)
+	// any number of threads can increment it, only 1 thread can wait on it at a time
+	struct GPGPUCounter
+	{
+		const static int SPIN_COUNT = 2000;
+		const static int YIELD_COUNT = 50;
+
+		alignas(64) std::atomic<uint64_t> count;
+		std::atomic<bool> parked;
+		std::mutex parkSync;
+		std::condition_variable parkCondition;
+
+		GPGPUCounter();
+
+		// increments count and wakes waiter if it is parked
+		void increment();
+
+		// blocks until count >= target
+		void waitFor(uint64_t target);
+	};
+
+	// lock-free single-producer single-consumer ring of tasks with fixed capacity (producer waits when ring is full)
+	struct GPGPUTaskRing
+	{
+		const static int CAPACITY = 64;
+
+		GPGPUTask tasks[CAPACITY];
+		GPGPUCounter pushed; // number of tasks pushed, waited by consumer
+		GPGPUCounter popped; // number of tasks popped, waited by producer when ring is full
+		alignas(64) uint64_t head; // accessed only by consumer
+		alignas(64) uint64_t tail; // accessed only by producer
+
+		GPGPUTaskRing();
+
+		void push(const GPGPUTask& task);
+
+		GPGPUTask pop();
+	};
 
+	// multi-producer multi-consumer queue (for sharing chunks of work between workers)
 	struct GPGPUTaskQueue
 	{
 		std::mutex syncPoint;
@@ -0,0 +1,90 @@
+#include "tuning-profile.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace GPGPU_LIB
+{
+	// tabs and line breaks are field separators of file
+	static std::string fieldOf(std::string str)
+	{
+		for (auto& c : str)
+		{
+			if (c == '\t' || c == '\n' || c == '\r')
+				c = ' ';
+		}
+		return str;
+	}
+
+	TuningProfile::TuningProfile(std::string fileNamePrm) :fileName(fileNamePrm)
+	{
+
+	}
+
+	std::map<std::pair<std::string, std::string>, size_t> TuningProfile::read()
+	{
+		std::map<std::pair<std::string, std::string>, size_t> values;
+		if (fileName == "")
+			return values;
+
+		std::ifstream file(fileName);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			const size_t tab1 = line.find('\t');
+			const size_t tab2 = (tab1 == std::string::npos ? std::string::npos : line.find('\t', tab1 + 1));
+			if (tab2 == std::string::npos)
+				continue;
+
+			std::stringstream valueStream(line.substr(tab2 + 1));
+			size_t value = 0;
+			if (!(valueStream >> value))
+				continue;
+			values[{ line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1) }] = value;
+		}
+		return values;
+	}
+
+	bool TuningProfile::get(const std::string& device, const std::string& key, size_t& value)
+	{
+		auto values = read();
+		auto found = values.find({ fieldOf(device), fieldOf(key) });
+		if (found == values.end())
+			return false;
+		value = found->second;
+		return true;
+	}
+
+	void TuningProfile::set(const std::string& device, const std::string& key, size_t value)
+	{
+		if (fileName == "")
+			return;
+
+		auto values = read();
+		values[{ fieldOf(device), fieldOf(key) }] = value;
+
+		// file is renamed after it is complete so that a reader never sees half of it
+		std::stringstream tmpName;
+		tmpName << fileName << "." << std::this_thread::get_id() << ".tmp";
+		std::error_code error;
+		{
+			std::ofstream file(tmpName.str(), std::ios::trunc);
+			if (!file)
+				return;
+
+			for (auto& entry : values)
+				file << entry.first.first << '\t' << entry.first.second << '\t' << entry.second << '\n';
+			if (!file)
+			{
+				file.close();
+				std::filesystem::remove(tmpName.str(), error);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmpName.str(), fileName, error);
+		if (error)
+			std::filesystem::remove(tmpName.str(), error);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef GPGPU_TUNING_PROFILE_LIB
+#define GPGPU_TUNING_PROFILE_LIB
+
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace GPGPU_LIB
+{
+	// tuned values per device name and key, saved in a text file (1 line per value: device name, key and value separated by tabs)
+	// a missing or broken file is treated as empty
+	struct TuningProfile
+	{
+		std::string fileName; // empty = values are not saved
+
+		TuningProfile(std::string fileNamePrm = "");
+
+		// returns false when there is no value for device and key
+		bool get(const std::string& device, const std::string& key, size_t& value);
+
+		// adds or replaces a value and re-writes the file (errors are ignored because profile is optional)
+		void set(const std::string& device, const std::string& key, size_t value);
+
+	private:
+		std::map<std::pair<std::string, std::string>, size_t> read();
+	};
+}
+#endif // !GPGPU_TUNING_PROFILE_LIB
@@ -3,11 +3,11 @@
 namespace GPGPU_LIB
 {
 
-	Worker::Worker(Device dev) :working(true)
+	Worker::Worker(Device dev, bool outOfOrderQueue, bool profiling) :submittedTasks(0), working(true)
 	{
 
 		context = Context(dev);
-		queue = CommandQueue(context);
+		queue = CommandQueue(context, outOfOrderQueue, profiling);
 
 
 		if (dev.id >= 0)
@@ -28,135 +28,304 @@ namespace GPGPU_LIB
 
 
 
+	void Worker::recordBenchmark(cl::Event& lastEvent, GPGPU::KernelId kernelId, std::chrono::nanoseconds start, size_t work)
+	{
+		queue.onComplete(lastEvent, [this, kernelId, start, work]() {
+			std::chrono::nanoseconds end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+			std::unique_lock<std::mutex> lock(commonSync);
+			benchmarks[kernelId.index] = (double)(end.count() - start.count());
+			works[kernelId.index] = work;
+		});
+	}
+
+	void Worker::recordBenchmark(cl::Event& lastEvent, std::vector<GPGPU::KernelId> kernelIds, std::chrono::nanoseconds start)
+	{
+		queue.onComplete(lastEvent, [this, kernelIds, start]() {
+			std::chrono::nanoseconds end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+			std::unique_lock<std::mutex> lock(commonSync);
+			listBenchmarks[kernelIds] = (double)(end.count() - start.count());
+		});
+	}
+
+	void Worker::recordBenchmark(cl::Event& lastEvent, std::shared_ptr<WorkerLaunchPlan> launchPlan, std::chrono::nanoseconds start, size_t work, bool accumulate)
+	{
+		queue.onComplete(lastEvent, [this, launchPlan, start, work, accumulate]() {
+			std::chrono::nanoseconds end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+			std::unique_lock<std::mutex> lock(commonSync);
+			launchPlan->benchmark = (accumulate ? launchPlan->benchmark : 0) + (double)(end.count() - start.count());
+			launchPlan->work = (accumulate ? launchPlan->work : 0) + work;
+		});
+	}
+
 	void Worker::work()
 	{
 		bool isWorking = true;
-		size_t nanoLastCommand = 0;
-		size_t workLastCommand = 0;
 		while (isWorking)
 		{
 
 
-			GPGPUTask task = taskQueue.pop();
+			GPGPUTask task = taskRing.pop();
 
 			switch (task.taskType)
 			{
 			case (GPGPUTask::GPGPU_TASK_COMPILE):
 			{
-				std::lock_guard<std::mutex> lg(*task.mutexPtr);
-				mapKernelNameToKernel[task.kernelName] = Kernel(*task.conPtr, task.kernelCode, task.kernelName);
+				std::vector<Kernel> compiled = Kernel::compile(*task.conPtr, *task.kernelCode, *task.kernelNames, *task.kernelCacheDirectory);
+				const std::vector<GPGPU::KernelId>& kernelIds = *task.kernelIds;
+				for (size_t i = 0; i < kernelIds.size(); i++)
+				{
+					if ((size_t)kernelIds[i].index >= kernels.size())
+						kernels.resize(kernelIds[i].index + 1);
+					kernels[kernelIds[i].index] = compiled[i];
+				}
 				break;
 			}
 
 			case (GPGPUTask::GPGPU_TASK_MIRROR):
 			{
 
-				mapParameterNameToParameter[task.hostParPtr->getName()] = Parameter(*task.conPtr, *task.hostParPtr);
+				const int index = task.hostParPtr->getId().index;
+				if ((size_t)index >= parameters.size())
+					parameters.resize(index + 1);
+				parameters[index] = Parameter(*task.conPtr, *task.hostParPtr);
 				break;
 			}
 
 			case (GPGPUTask::GPGPU_TASK_STOP):
 			{
-
+				// completion callbacks access this object
+				queue.sync();
 				isWorking = false;
 				break;
 			}
 
 
+			// host waits only for copies that access RAM (inputs can be changed and outputs can be read after task)
+			// kernels that only use device-side buffers keep running while next task is being enqueued
+			// benchmark (for load-balancing) is recorded when last command completes
 			case (GPGPUTask::GPGPU_TASK_COMPUTE):
 			{
-				workLastCommand = 0;
-				{
-					GPGPU::Bench bench(&nanoLastCommand);
-					Kernel& kernel = mapKernelNameToKernel[task.kernelName];
-					task.comQuePtr->copyInputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
-					task.comQuePtr->run(kernel, task.globalOffset, task.globalSize, task.localSize, task.offset);
-					task.comQuePtr->copyOutputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
-					workLastCommand += task.globalSize;
-
-					task.comQuePtr->sync();
-				}
-
+				const std::chrono::nanoseconds start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+				Kernel& kernel = kernels[task.kernelId.index];
+				std::vector<cl::Event> hostEvents = task.comQuePtr->copyInputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
+				cl::Event lastEvent = task.comQuePtr->run(kernel, task.globalOffset, task.globalSize, task.localSize, task.offset, task.rows);
+				std::vector<cl::Event> outputEvents = task.comQuePtr->copyOutputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize, task.strips);
+				hostEvents.insert(hostEvents.end(), outputEvents.begin(), outputEvents.end());
+				if (outputEvents.size() > 0)
+					lastEvent = outputEvents.back();
+
+				recordBenchmark(lastEvent, task.kernelId, start, task.globalSize);
+				task.comQuePtr->flush();
+				task.comQuePtr->wait(hostEvents);
 				break;
 			}
 
 
 			case (GPGPUTask::GPGPU_TASK_COMPUTE_MULTIPLE):
 			{
-				workLastCommand = 0;
 				{
-					GPGPU::Bench bench(&nanoLastCommand);
-					const int nK = task.kernelNames.size();
+					const std::chrono::nanoseconds start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+					std::vector<cl::Event> hostEvents;
+					cl::Event lastEvent;
+					size_t work = 0;
+					const std::vector<GPGPU::KernelId>& kernelIds = *task.kernelIds;
+					const int nK = kernelIds.size();
+					const bool rebind = task.kernelParameterIds->size() > 0;
 					for (int i = 0; i < nK; i++)
 					{
-						Kernel& kernel = mapKernelNameToKernel[task.kernelNames[i]];
-						task.comQuePtr->copyInputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
-						task.comQuePtr->run(kernel, task.globalOffset, task.globalSize, task.localSize, task.offset);
-						task.comQuePtr->copyOutputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
-						workLastCommand += task.globalSize;
+						Kernel& kernel = kernels[kernelIds[i].index];
+
+						// arguments are captured at enqueue time so re-binding between launches is safe
+						if (rebind)
+						{
+							const std::vector<GPGPU::ParamId>& chain = (*task.kernelParameterIds)[i];
+							const int nP = chain.size();
+							for (int j = 0; j < nP; j++)
+							{
+								task.comQuePtr->setPrm(kernel, parameters[chain[j].index], j);
+							}
+						}
+						std::vector<cl::Event> inputEvents = task.comQuePtr->copyInputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
+						lastEvent = task.comQuePtr->run(kernel, task.globalOffset, task.globalSize, task.localSize, task.offset);
+						std::vector<cl::Event> outputEvents = task.comQuePtr->copyOutputsOfKernel(kernel, task.globalOffset, task.offset, task.globalSize);
+						hostEvents.insert(hostEvents.end(), inputEvents.begin(), inputEvents.end());
+						hostEvents.insert(hostEvents.end(), outputEvents.begin(), outputEvents.end());
+						if (outputEvents.size() > 0)
+							lastEvent = outputEvents.back();
+						work += task.globalSize;
 					}
-					task.comQuePtr->sync();
+
+					// load-balancer looks up benchmark by kernel list
+					if (nK > 0)
+						recordBenchmark(lastEvent, kernelIds, start);
+					task.comQuePtr->flush();
+					task.comQuePtr->wait(hostEvents);
 				}
 
 				break;
 			}
 
+			// chunks are taken from shared queue while previous chunk is still computed (2 chunks in flight)
+			// so that transfers and kernels of consecutive chunks overlap but faster devices still get more chunks
 			case (GPGPUTask::GPGPU_TASK_COMPUTE_ALL):
 			{
-				workLastCommand = 0;
 				{
-					GPGPU::Bench bench(&nanoLastCommand);
+					const std::chrono::nanoseconds start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+					std::vector<cl::Event> hostEvents;
+					std::vector<cl::Event> previousChunk;
+					cl::Event lastEvent;
+					size_t work = 0;
 					GPGPUTask taskNew;
 					while ((taskNew = task.sharedTaskQueue->pop()).taskType != GPGPUTask::GPGPU_TASK_NULL)
 					{
-						Kernel& kernel = mapKernelNameToKernel[taskNew.kernelName];
-						task.comQuePtr->copyInputsOfKernel(kernel, taskNew.globalOffset, taskNew.offset, taskNew.globalSize);
-						task.comQuePtr->run(kernel, taskNew.globalOffset, taskNew.globalSize, taskNew.localSize, taskNew.offset);
-						task.comQuePtr->copyOutputsOfKernel(kernel, taskNew.globalOffset, taskNew.offset, taskNew.globalSize);
-						workLastCommand += taskNew.globalSize;
-						task.comQuePtr->sync();
-
+						Kernel& kernel = kernels[taskNew.kernelId.index];
+						std::vector<cl::Event> inputEvents = task.comQuePtr->copyInputsOfKernel(kernel, taskNew.globalOffset, taskNew.offset, taskNew.globalSize);
+						lastEvent = task.comQuePtr->run(kernel, taskNew.globalOffset, taskNew.globalSize, taskNew.localSize, taskNew.offset);
+						std::vector<cl::Event> outputEvents = task.comQuePtr->copyOutputsOfKernel(kernel, taskNew.globalOffset, taskNew.offset, taskNew.globalSize);
+						hostEvents.insert(hostEvents.end(), inputEvents.begin(), inputEvents.end());
+						hostEvents.insert(hostEvents.end(), outputEvents.begin(), outputEvents.end());
+						if (outputEvents.size() > 0)
+							lastEvent = outputEvents.back();
+						work += taskNew.globalSize;
+						task.comQuePtr->flush();
+
+						task.comQuePtr->wait(previousChunk);
+						previousChunk = { lastEvent };
 					}
 
+					if (work > 0)
+						recordBenchmark(lastEvent, task.kernelId, start, work);
+					task.comQuePtr->flush();
+					task.comQuePtr->wait(hostEvents);
 				}
 
 				break;
 			}
 
-			case (GPGPUTask::GPGPU_TASK_ARG):
+			// deque elements are not moved by later compilations/mirrors so pointers stay valid
+			case (GPGPUTask::GPGPU_TASK_CREATE_LAUNCH_PLAN):
 			{
+				WorkerLaunchPlan& plan = *task.launchPlan;
+				std::map<Kernel*, std::vector<Parameter*>> lastChain;
+				const std::vector<GPGPU::KernelId>& kernelIds = *task.kernelIds;
+				const int nK = kernelIds.size();
+				for (int i = 0; i < nK; i++)
+				{
+					if (!kernelIds[i].valid() || (size_t)kernelIds[i].index >= kernels.size())
+					{
+						throw std::invalid_argument(std::string("error: launch plan has a kernel that is not compiled. kernel id = ") + std::to_string(kernelIds[i].index));
+					}
 
-				Kernel& kernel = mapKernelNameToKernel[task.kernelName];
-				Parameter& parameter = mapParameterNameToParameter[task.parameterName];
-				task.comQuePtr->setPrm(kernel, parameter, task.parameterPosition);
-				break;
-			}
+					PlannedLaunch launch;
+					launch.kernel = &kernels[kernelIds[i].index];
+					for (auto& parameterId : (*task.kernelParameterIds)[i])
+					{
+						if (!parameterId.valid() || (size_t)parameterId.index >= parameters.size())
+						{
+							throw std::invalid_argument(std::string("error: launch plan has a parameter that is not created. parameter id = ") + std::to_string(parameterId.index));
+						}
+
+						Parameter* prm = &parameters[parameterId.index];
+						launch.parameters.push_back(prm);
+
+						// same buffer can be bound to multiple positions
+						if (!prm->isScalar() && !prm->isLocal() && std::find(launch.buffers.begin(), launch.buffers.end(), prm) == launch.buffers.end())
+							launch.buffers.push_back(prm);
+						// scalars are passed by value (their buffers are never read)
+						if (prm->readOp && !prm->isScalar() && !prm->isLocal() && std::find(launch.inputs.begin(), launch.inputs.end(), prm) == launch.inputs.end())
+							launch.inputs.push_back(prm);
+						if (prm->writeOp && std::find(launch.outputs.begin(), launch.outputs.end(), prm) == launch.outputs.end())
+							launch.outputs.push_back(prm);
+					}
 
-			default: break;
+					auto chainIt = lastChain.find(launch.kernel);
+					if (chainIt == lastChain.end())
+					{
+						plan.kernels.push_back(launch.kernel);
+						lastChain.emplace(launch.kernel, launch.parameters);
+						launch.rebind = true;
+					}
+					else if (chainIt->second != launch.parameters)
+					{
+						chainIt->second = launch.parameters;
+						launch.rebind = true;
+					}
+					plan.launches.push_back(launch);
+				}
+				break;
 			}
 
-			if (task.taskType != 0 || isWorking)
+			// same as GPGPU_TASK_COMPUTE_MULTIPLE without any lookups by name
+			// kernels get their own bindings back after replay so compute() calls on same kernels are not affected
+			// a strip replay is given 1 launch at a time (halo rows are exchanged between launches)
+			case (GPGPUTask::GPGPU_TASK_RUN_LAUNCH_PLAN):
 			{
-
-				std::unique_lock<std::mutex> lock(commonSync);
-				if (task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE || task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE_ALL)
+				const std::chrono::nanoseconds start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+				WorkerLaunchPlan& plan = *task.launchPlan;
+				std::vector<cl::Event> hostEvents;
+				cl::Event lastEvent;
+				size_t work = 0;
+				const size_t launchEnd = std::min(task.launchEnd, plan.launches.size());
+				for (size_t i = task.launchBegin; i < launchEnd; i++)
 				{
-					benchmarks[task.kernelName] = nanoLastCommand;
-					works[task.kernelName] = workLastCommand;
+					PlannedLaunch& launch = plan.launches[i];
+					if (launch.rebind)
+						task.comQuePtr->setArgs(*launch.kernel, launch.parameters);
+					for (auto& scalarOffset : launch.scalarOffsets)
+						task.comQuePtr->setArgWithOffset(*launch.kernel, *launch.parameters[scalarOffset.first], scalarOffset.first, scalarOffset.second);
+
+					std::vector<cl::Event> inputEvents = task.comQuePtr->copyInputs(launch.inputs, task.globalOffset, task.offset, task.globalSize);
+					lastEvent = task.comQuePtr->run(launch.kernel->kernel, launch.buffers, task.globalOffset, task.globalSize, task.localSize, task.offset, plan.rows);
+					std::vector<cl::Event> outputEvents = task.comQuePtr->copyOutputs(launch.outputs, task.globalOffset, task.offset, task.globalSize, task.strips);
+					hostEvents.insert(hostEvents.end(), inputEvents.begin(), inputEvents.end());
+					hostEvents.insert(hostEvents.end(), outputEvents.begin(), outputEvents.end());
+					if (outputEvents.size() > 0)
+						lastEvent = outputEvents.back();
+					work += task.globalSize;
 				}
 
+				if (launchEnd == plan.launches.size())
+				{
+					for (Kernel* kernel : plan.kernels)
+					{
+						task.comQuePtr->restoreArgs(*kernel);
+					}
+				}
 
-				isWorking = working;
+				if (launchEnd > task.launchBegin)
+					recordBenchmark(lastEvent, plan.shared_from_this(), start, work, task.launchBegin > 0);
+				task.comQuePtr->flush();
+				task.comQuePtr->wait(hostEvents);
+				break;
 			}
 
-			retireQueue.push(GPGPU_LIB::GPGPUTask());
-			cond.notify_all();
+			// host waits for copies because RAM is read/written by other devices after this task
+			case (GPGPUTask::GPGPU_TASK_TRANSFER):
+			{
+				std::vector<cl::Event> hostEvents;
+				for (const StripTransfer& transfer : *task.transfers)
+				{
+					hostEvents.push_back(task.comQuePtr->copyRange(parameters[transfer.parameterId.index], transfer.byteOffset, transfer.numBytes, transfer.toDevice));
+				}
+				task.comQuePtr->flush();
+				task.comQuePtr->wait(hostEvents);
+				break;
+			}
 
-			if (!isWorking)
+			case (GPGPUTask::GPGPU_TASK_ARG):
 			{
 
+				Kernel& kernel = kernels[task.kernelId.index];
+				Parameter& parameter = parameters[task.parameterId.index];
+				task.comQuePtr->setPrm(kernel, parameter, task.parameterPosition);
 				break;
 			}
+
+			default: break;
+			}
+
+			// only the stop task ends the loop so that every submitted task is retired
+			retiredTasks.increment();
 		}
 
 	}
@@ -174,36 +343,44 @@ namespace GPGPU_LIB
 		{
 			GPGPUTask task;
 			task.taskType = GPGPUTask::GPGPU_TASK_STOP;
-			taskQueue.push(task);
+			submit(task);
 			waitAllTasks();
 			workerThread.join();
 		}
 	}
 
-	void Worker::runTasks(std::shared_ptr<GPGPUTaskQueue> taskQueueShared, std::string kernelName)
+	void Worker::runTasks(GPGPUTaskQueue* taskQueueShared, GPGPU::KernelId kernelId)
 	{
 		GPGPUTask task;
 		task.taskType = GPGPUTask::GPGPU_TASK_COMPUTE_ALL;
 		task.sharedTaskQueue = taskQueueShared;
 		task.comQuePtr = &queue;
-		task.kernelName = kernelName;
-		taskQueue.push(task);
+		task.kernelId = kernelId;
+		submit(task);
 	}
 
-	void Worker::compile(std::string kernel, std::string kernelName, std::mutex* compileLock)
+	void Worker::compile(const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::vector<GPGPU::KernelId>& kernelIds, const std::string& cacheDirectory)
 	{
 		{
 			std::unique_lock<std::mutex> lock(commonSync);
-			benchmarks[kernelName] = 1;
+			for (auto& kernelId : kernelIds)
+			{
+				if ((size_t)kernelId.index >= benchmarks.size())
+				{
+					benchmarks.resize(kernelId.index + 1);
+					works.resize(kernelId.index + 1);
+				}
+				benchmarks[kernelId.index] = 1;
+			}
 		}
 		GPGPUTask task;
 		task.taskType = GPGPUTask::GPGPU_TASK_COMPILE;
-		task.kernelCode = kernel;
-		task.kernelName = kernelName;
+		task.kernelCode = &kernelCode;
+		task.kernelNames = &kernelNames;
+		task.kernelIds = &kernelIds;
+		task.kernelCacheDirectory = &cacheDirectory;
 		task.conPtr = &context;
-		task.mutexPtr = compileLock;
-		taskQueue.push(task);
-		waitAllTasks();
+		submit(task);
 	}
 
 	void Worker::mirror(GPGPU::HostParameter* hostParameter)
@@ -212,34 +389,41 @@ namespace GPGPU_LIB
 		task.taskType = GPGPUTask::GPGPU_TASK_MIRROR;
 		task.hostParPtr = hostParameter;
 		task.conPtr = &context;
-		taskQueue.push(task);
+		submit(task);
 		waitAllTasks();
 	}
 
-	void Worker::setArg(std::string kernelName, std::string parameterName, int parameterIndex)
+	void Worker::setArg(GPGPU::KernelId kernelId, GPGPU::ParamId parameterId, int parameterIndex)
 	{
 		GPGPUTask task;
 		task.taskType = GPGPUTask::GPGPU_TASK_ARG;
-		task.kernelName = kernelName;
-		task.parameterName = parameterName;
+		task.kernelId = kernelId;
+		task.parameterId = parameterId;
 		task.parameterPosition = parameterIndex;
 		task.comQuePtr = &queue;
-		taskQueue.push(task);
+		submit(task);
 		waitAllTasks();
 	}
 
+	void Worker::submit(const GPGPUTask& task)
+	{
+		submittedTasks++;
+		taskRing.push(task);
+	}
+
 	void Worker::waitAllTasks()
 	{
-		retireQueue.pop();
+		retiredTasks.waitFor(submittedTasks);
 	}
 
-	void Worker::run(std::string kernelName, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, bool multipleKernels, std::vector<std::string> kernelNames)
+	void Worker::run(GPGPU::KernelId kernelId, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, bool multipleKernels, const std::vector<GPGPU::KernelId>* kernelIds, const std::vector<std::vector<GPGPU::ParamId>>* kernelParameterIds, LaunchRows rows)
 	{
 		GPGPUTask task;
 		if (multipleKernels)
 		{
 			task.taskType = GPGPUTask::GPGPU_TASK_COMPUTE_MULTIPLE;
-			task.kernelNames = kernelNames;
+			task.kernelIds = kernelIds;
+			task.kernelParameterIds = kernelParameterIds;
 			task.offset = offset;
 			task.globalSize = numGlobal;
 			task.localSize = numLocal;
@@ -249,14 +433,83 @@ namespace GPGPU_LIB
 		else
 		{
 			task.taskType = GPGPUTask::GPGPU_TASK_COMPUTE;
-			task.kernelName = kernelName;
+			task.kernelId = kernelId;
 			task.offset = offset;
 			task.globalSize = numGlobal;
 			task.localSize = numLocal;
 			task.globalOffset = globalOffset;
+			task.rows = rows;
 			task.comQuePtr = &queue;
 		}
-		taskQueue.push(task);
+		submit(task);
+	}
+
+	void Worker::runStrip(GPGPU::KernelId kernelId, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, LaunchRows rows)
+	{
+		GPGPUTask task;
+		task.taskType = GPGPUTask::GPGPU_TASK_COMPUTE;
+		task.kernelId = kernelId;
+		task.offset = offset;
+		task.globalSize = numGlobal;
+		task.localSize = numLocal;
+		task.globalOffset = globalOffset;
+		task.rows = rows;
+		task.strips = true;
+		task.comQuePtr = &queue;
+		submit(task);
+	}
+
+	void Worker::transfer(const std::vector<StripTransfer>* transfers)
+	{
+		GPGPUTask task;
+		task.taskType = GPGPUTask::GPGPU_TASK_TRANSFER;
+		task.transfers = transfers;
+		task.comQuePtr = &queue;
+		submit(task);
+	}
+
+	std::shared_ptr<WorkerLaunchPlan> Worker::createLaunchPlan(std::vector<GPGPU::KernelId> kernelIds, std::vector<std::vector<GPGPU::ParamId>> kernelParameterIds)
+	{
+		GPGPUTask task;
+		task.taskType = GPGPUTask::GPGPU_TASK_CREATE_LAUNCH_PLAN;
+		std::shared_ptr<WorkerLaunchPlan> launchPlan = std::make_shared<WorkerLaunchPlan>();
+		task.kernelIds = &kernelIds;
+		task.kernelParameterIds = &kernelParameterIds;
+		task.launchPlan = launchPlan.get();
+		submit(task);
+		waitAllTasks();
+		return launchPlan;
+	}
+
+	void Worker::run(WorkerLaunchPlan* launchPlan, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal)
+	{
+		GPGPUTask task;
+		task.taskType = GPGPUTask::GPGPU_TASK_RUN_LAUNCH_PLAN;
+		task.launchPlan = launchPlan;
+		task.launchBegin = 0;
+		task.launchEnd = launchPlan->launches.size();
+		task.offset = offset;
+		task.globalSize = numGlobal;
+		task.localSize = numLocal;
+		task.globalOffset = globalOffset;
+		task.comQuePtr = &queue;
+		submit(task);
+	}
+
+	void Worker::runStrip(WorkerLaunchPlan* launchPlan, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, size_t launchBegin, size_t launchEnd)
+	{
+		GPGPUTask task;
+		task.taskType = GPGPUTask::GPGPU_TASK_RUN_LAUNCH_PLAN;
+		task.launchPlan = launchPlan;
+		task.launchBegin = launchBegin;
+		task.launchEnd = launchEnd;
+		task.strips = true;
+		task.offset = offset;
+		task.globalSize = numGlobal;
+		task.localSize = numLocal;
+		task.globalOffset = globalOffset;
+		task.comQuePtr = &queue;
+		submit(task);
 	}
 
 	std::string Worker::deviceName()
@@ -267,6 +520,10 @@ namespace GPGPU_LIB
 	{
 		return context.device.simpleName;
 	}
+	size_t Worker::deviceLocalMemorySize()
+	{
+		return context.device.localMemorySize;
+	}
 	Worker::~Worker()
 	{
 		stop();
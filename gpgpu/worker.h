@@ -10,45 +10,90 @@
 #include "command-queue.h"
 #include "task-queue.h"
 #include <map>
+#include <deque>
 namespace GPGPU_LIB
 {
 
 	struct Worker
 	{
 		std::mutex commonSync;
-		std::condition_variable cond;
 		Context context;
 		CommandQueue queue;
-		std::map<std::string, Kernel> mapKernelNameToKernel;
-		std::map<std::string, Parameter> mapParameterNameToParameter;
-		GPGPUTaskQueue taskQueue;
-		GPGPUTaskQueue retireQueue;
+		// indexed by KernelId/ParamId (deque does not move elements when it grows so kernels and launch plans can point to them)
+		std::deque<Kernel> kernels;
+		std::deque<Parameter> parameters;
+		// tasks are pushed only by the thread that owns Computer and popped by worker thread
+		GPGPUTaskRing taskRing;
+		uint64_t submittedTasks; // accessed only by the pushing thread
+		GPGPUCounter retiredTasks;
 		bool working;
 
 
-		std::map<std::string, double> benchmarks;
-		std::map<std::string, size_t> works;
+		// per KernelId
+		std::vector<double> benchmarks;
+		std::vector<size_t> works;
+		// per kernel list of runMultiple
+		std::map<std::vector<GPGPU::KernelId>, double> listBenchmarks;
 		std::thread workerThread;
-		Worker(Device dev);
+		// outOfOrderQueue = true: commands are run in any order that respects their buffer dependencies (if device supports it)
+		// profiling = true: device times of commands are collected in queue.profile
+		Worker(Device dev, bool outOfOrderQueue = false, bool profiling = false);
+
+		// writes time from start to completion of lastEvent into benchmarks (called when lastEvent completes)
+		void recordBenchmark(cl::Event& lastEvent, GPGPU::KernelId kernelId, std::chrono::nanoseconds start, size_t work);
+
+		// same as recordBenchmark but for a kernel list
+		void recordBenchmark(cl::Event& lastEvent, std::vector<GPGPU::KernelId> kernelIds, std::chrono::nanoseconds start);
+
+		// same as recordBenchmark but for a launch plan (accumulate = adds to benchmark of earlier launches of same replay)
+		void recordBenchmark(cl::Event& lastEvent, std::shared_ptr<WorkerLaunchPlan> launchPlan, std::chrono::nanoseconds start, size_t work, bool accumulate);
 
 		void work();
 
+		// pushes task to worker thread
+		void submit(const GPGPUTask& task);
+
 		void stop();
 
-		void runTasks(std::shared_ptr<GPGPUTaskQueue> taskQueueShared, std::string kernelName);
+		// taskQueueShared has to stay alive until waitAllTasks
+		void runTasks(GPGPUTaskQueue* taskQueueShared, GPGPU::KernelId kernelId);
 
-		void compile(std::string kernel, std::string kernelName, std::mutex* compileLock);
+		// compiles all kernels of kernel code as 1 program into kernelIds' slots (replaces older kernels of same ids)
+		// cacheDirectory: directory of compiled binaries (empty = no caching)
+		// does not wait, so devices compile at the same time: arguments have to stay alive until waitAllTasks
+		void compile(const std::string& kernelCode, const std::vector<std::string>& kernelNames, const std::vector<GPGPU::KernelId>& kernelIds, const std::string& cacheDirectory);
 
+		// allocates device buffer into id's slot of host parameter
 		void mirror(GPGPU::HostParameter* hostParameter);
 
-		void setArg(std::string kernelName, std::string parameterName, int parameterIndex);
+		void setArg(GPGPU::KernelId kernelId, GPGPU::ParamId parameterId, int parameterIndex);
 
+		// blocks until all submitted tasks are completed
 		void waitAllTasks();
 
-		void run(std::string kernelName, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, bool multipleKernels = false, std::vector<std::string> kernelNames = std::vector<std::string>());
+		// kernelIds and kernelParameterIds have to stay alive until waitAllTasks
+		// rows: 2D launch of a single kernel
+		void run(GPGPU::KernelId kernelId, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, bool multipleKernels = false, const std::vector<GPGPU::KernelId>* kernelIds = nullptr, const std::vector<std::vector<GPGPU::ParamId>>* kernelParameterIds = nullptr, LaunchRows rows = LaunchRows());
+
+		// same as run for a single kernel but thread range is a strip of rows (outputs with all elements are not copied)
+		void runStrip(GPGPU::KernelId kernelId, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, LaunchRows rows = LaunchRows());
+
+		// copies byte ranges of parameters between device and RAM (without waiting), transfers have to stay alive until waitAllTasks
+		void transfer(const std::vector<StripTransfer>* transfers);
+
+		// resolves kernels and parameter chains (1 chain per launch) of a kernel list on this device
+		std::shared_ptr<WorkerLaunchPlan> createLaunchPlan(std::vector<GPGPU::KernelId> kernelIds, std::vector<std::vector<GPGPU::ParamId>> kernelParameterIds);
+
+		// replays a launch plan (without waiting), launchPlan has to stay alive until waitAllTasks
+		void run(WorkerLaunchPlan* launchPlan, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal);
+
+		// replays launches [launchBegin, launchEnd) of a launch plan as a strip of rows (outputs with all elements are not copied)
+		// launches of a replay have to be given in order, kernels get their own bindings back after the last launch
+		void runStrip(WorkerLaunchPlan* launchPlan, size_t globalOffset, size_t offset, size_t numGlobal, size_t numLocal, size_t launchBegin, size_t launchEnd);
 
 		std::string deviceName();
 		std::string deviceNameSimple();
+		size_t deviceLocalMemorySize();
 		~Worker();
 	};
 }